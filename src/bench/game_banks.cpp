@@ -0,0 +1,90 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <bench/bench.h>
+#include <bench/game_world.h>
+
+#include <game/common.h>
+#include <game/tiles.h>
+#include <uint256.h>
+
+#include <set>
+#include <vector>
+
+/* Number of banks that are kept and re-created per block.  This roughly
+   corresponds to the dynamic banks in the game.  */
+static const unsigned KEPT_BANKS = 70;
+static const unsigned NEW_BANKS = 5;
+
+static std::set<Coord>
+KeptBanks ()
+{
+  const std::vector<Coord>& tiles = game_bench::WalkableTiles ();
+  RandomGenerator rng(uint256S ("01"));
+
+  std::set<Coord> res;
+  while (res.size () < KEPT_BANKS)
+    res.insert (tiles[rng.GetIntRnd (tiles.size ())]);
+
+  return res;
+}
+
+/* The way UpdateBanks used to select new banks:  Copy the tiles into
+   a set, remove the existing banks, and then erase selected tiles from
+   a vector copy of the set.  */
+static void
+GameBanksLegacy (benchmark::State& state)
+{
+  const std::vector<Coord>& tiles = game_bench::WalkableTiles ();
+  const std::set<Coord> kept = KeptBanks ();
+
+  while (state.KeepRunning ())
+    {
+      RandomGenerator rng(uint256S ("02"));
+
+      std::set<Coord> optionsSet(tiles.begin (), tiles.end ());
+      for (const auto& c : kept)
+        optionsSet.erase (c);
+
+      std::vector<Coord> options(optionsSet.begin (), optionsSet.end ());
+      for (unsigned i = 0; i < NEW_BANKS; ++i)
+        {
+          const int ind = rng.GetIntRnd (options.size ());
+          options.erase (options.begin () + ind);
+        }
+    }
+}
+
+static void
+GameBanksAvailableTiles (benchmark::State& state)
+{
+  const std::vector<Coord>& tiles = game_bench::WalkableTiles ();
+  const std::set<Coord> kept = KeptBanks ();
+
+  while (state.KeepRunning ())
+    {
+      RandomGenerator rng(uint256S ("02"));
+
+      AvailableTiles options(tiles);
+      for (const auto& c : kept)
+        options.Exclude (c);
+
+      for (unsigned i = 0; i < NEW_BANKS; ++i)
+        options.Take (rng.GetIntRnd (options.size ()));
+    }
+}
+
+BENCHMARK(GameBanksLegacy, 100);
+BENCHMARK(GameBanksAvailableTiles, 20 * 1000);
@@ -0,0 +1,67 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <bench/bench.h>
+
+#include <game/common.h>
+#include <game/move.h>
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+/* Typical move values as they are found in name updates.  Addresses are
+   not included, since they need the global chain parameters.  */
+static const std::vector<std::string> MOVE_VALUES = {
+  R"({"color":2})",
+  R"({"0":{"wp":[10,20,11,21,12,22,13,23,14,24,15,25]}})",
+  R"({"0":{"wp":[100,200]},"1":{"wp":[101,201,102,202]},)"
+  R"("2":{"wp":[103,203,104,204,105,205,106,206]}})",
+  R"({"0":{"destruct":true},"1":{"destruct":true}})",
+  R"({"msg":"Hello world!","0":{"wp":[50,60]}})",
+};
+
+static void
+GameMoveParse (benchmark::State& state)
+{
+  const PlayerID name("domob");
+
+  size_t i = 0;
+  while (state.KeepRunning ())
+    {
+      Move m;
+      const bool ok = m.Parse (name, MOVE_VALUES[i++ % MOVE_VALUES.size ()]);
+      assert (ok);
+    }
+}
+
+/* The same with the UniValue-based parser, for comparison.  */
+static void
+GameMoveParseUniValue (benchmark::State& state)
+{
+  const PlayerID name("domob");
+
+  size_t i = 0;
+  while (state.KeepRunning ())
+    {
+      Move m;
+      const bool ok
+          = m.ParseWithUniValue (name, MOVE_VALUES[i++ % MOVE_VALUES.size ()]);
+      assert (ok);
+    }
+}
+
+BENCHMARK(GameMoveParse, 200 * 1000);
+BENCHMARK(GameMoveParseUniValue, 200 * 1000);
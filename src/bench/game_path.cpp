@@ -0,0 +1,97 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <bench/bench.h>
+#include <bench/game_world.h>
+
+#include <game/common.h>
+#include <game/movecreator.h>
+#include <game/state.h>
+#include <uint256.h>
+
+#include <utility>
+#include <vector>
+
+/* Number of start / goal pairs that are cycled through.  */
+static const unsigned PATH_PAIRS = 16;
+
+/**
+ * Construct deterministic pairs of walkable tiles.  If maxDist is non-zero,
+ * the goals are at most that far away from the starts.
+ */
+static std::vector<std::pair<Coord, Coord>>
+PathPairs (const int maxDist)
+{
+  const std::vector<Coord>& tiles = game_bench::WalkableTiles ();
+  RandomGenerator rng(uint256S ("01"));
+
+  std::vector<std::pair<Coord, Coord>> res;
+  while (res.size () < PATH_PAIRS)
+    {
+      const Coord& a = tiles[rng.GetIntRnd (tiles.size ())];
+      const Coord& b = tiles[rng.GetIntRnd (tiles.size ())];
+      if (maxDist > 0 && static_cast<int> (distLInf (a, b)) > maxDist)
+        continue;
+      res.push_back (std::make_pair (a, b));
+    }
+
+  return res;
+}
+
+static void
+RunFindPath (benchmark::State& state, const int maxDist)
+{
+  const auto pairs = PathPairs (maxDist);
+
+  size_t i = 0;
+  while (state.KeepRunning ())
+    {
+      const auto& p = pairs[i++ % pairs.size ()];
+      FindPath (p.first, p.second);
+    }
+}
+
+static void
+GameFindPathShort (benchmark::State& state)
+{
+  RunFindPath (state, 50);
+}
+
+static void
+GameFindPathLong (benchmark::State& state)
+{
+  RunFindPath (state, 0);
+}
+
+/* All short pairs as a single batch with ProcessPathQueries.  */
+static void
+GameFindPathBatch (benchmark::State& state)
+{
+  std::vector<PathQuery> queries;
+  for (const auto& p : PathPairs (50))
+    {
+      PathQuery q;
+      q.from = p.first;
+      q.to = p.second;
+      queries.push_back (q);
+    }
+
+  while (state.KeepRunning ())
+    ProcessPathQueries (queries);
+}
+
+BENCHMARK(GameFindPathShort, 10 * 1000);
+BENCHMARK(GameFindPathLong, 300);
+BENCHMARK(GameFindPathBatch, 200);
@@ -0,0 +1,41 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <bench/bench.h>
+
+#include <game/common.h>
+#include <game/map.h>
+#include <uint256.h>
+
+/* Draw random numbers as done for spawns and dropped hearts, including
+   the occasional re-seeding when the state is exhausted.  */
+static void
+GameRandomGenerator (benchmark::State& state)
+{
+  RandomGenerator rnd(uint256S ("01"));
+  uint64_t sum = 0;
+
+  while (state.KeepRunning ())
+    for (int i = 0; i < 1000; ++i)
+      {
+        sum += rnd.GetIntRnd (MAP_WIDTH);
+        sum += rnd.GetIntRnd (MAP_HEIGHT);
+      }
+
+  /* Make sure the calls are not optimised away.  */
+  assert (sum > 0);
+}
+
+BENCHMARK(GameRandomGenerator, 5 * 1000);
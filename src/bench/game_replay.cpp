@@ -0,0 +1,106 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <bench/bench.h>
+#include <bench/game_world.h>
+
+#include <arith_uint256.h>
+#include <game/delta.h>
+#include <game/move.h>
+#include <game/state.h>
+#include <uint256.h>
+
+#include <cassert>
+#include <vector>
+
+/* Number of consecutive steps that are replayed.  */
+static const unsigned REPLAY_STEPS = 20;
+
+/**
+ * A recorded sequence of steps on a synthetic world:  The initial state,
+ * the moves of each step and the resulting deltas.  This corresponds to
+ * what CGameDB needs when it reconstructs a state from the last snapshot.
+ */
+struct RecordedSteps
+{
+
+  GameState initial;
+  std::vector<std::vector<Move>> moves;
+  std::vector<GameStateDelta> deltas;
+  uint256 finalHash;
+
+  RecordedSteps ()
+    : initial(game_bench::ConsensusParams ())
+  {
+    game_bench::BuildWorld (game_bench::WorldOptions (10000, 1000, 0,
+                                                      uint256S ("01")),
+                            initial);
+
+    GameState cur = initial;
+    for (unsigned i = 0; i < REPLAY_STEPS; ++i)
+      {
+        std::vector<Move> stepMoves;
+        const uint256 seed = ArithToUint256 (arith_uint256 (i + 100));
+        game_bench::BuildMoves (cur, seed, 100, 10, stepMoves);
+
+        GameState next(game_bench::ConsensusParams ());
+        game_bench::Step (cur, stepMoves, next);
+
+        moves.push_back (stepMoves);
+        deltas.push_back (GameStateDelta (cur, next));
+        cur = next;
+      }
+
+    finalHash = cur.hashBlock;
+  }
+
+};
+
+/* Replay by running the game engine for each step.  */
+static void
+GameReplaySteps (benchmark::State& state)
+{
+  const RecordedSteps rec;
+
+  while (state.KeepRunning ())
+    {
+      GameState cur = rec.initial;
+      for (const auto& m : rec.moves)
+        {
+          GameState next(game_bench::ConsensusParams ());
+          game_bench::Step (cur, m, next);
+          cur = next;
+        }
+      assert (cur.hashBlock == rec.finalHash);
+    }
+}
+
+/* Replay by applying the stored deltas.  */
+static void
+GameReplayDeltas (benchmark::State& state)
+{
+  const RecordedSteps rec;
+
+  while (state.KeepRunning ())
+    {
+      GameState cur = rec.initial;
+      for (const auto& d : rec.deltas)
+        d.Apply (cur);
+      assert (cur.hashBlock == rec.finalHash);
+    }
+}
+
+BENCHMARK(GameReplaySteps, 2);
+BENCHMARK(GameReplayDeltas, 20);
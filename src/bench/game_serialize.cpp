@@ -0,0 +1,83 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <bench/bench.h>
+#include <bench/game_world.h>
+
+#include <clientversion.h>
+#include <game/jsonwriter.h>
+#include <game/state.h>
+#include <streams.h>
+#include <uint256.h>
+
+/* Number of players in the world that is serialised.  */
+static const unsigned SERIALIZE_PLAYERS = 10000;
+
+static void
+GameStateSerialize (benchmark::State& state)
+{
+  GameState world(game_bench::ConsensusParams ());
+  game_bench::BuildWorld (game_bench::WorldOptions (SERIALIZE_PLAYERS, 1000,
+                                                    0, uint256S ("01")),
+                          world);
+
+  while (state.KeepRunning ())
+    {
+      CDataStream stream(SER_DISK, CLIENT_VERSION);
+      stream << world;
+    }
+}
+
+static void
+GameStateDeserialize (benchmark::State& state)
+{
+  GameState world(game_bench::ConsensusParams ());
+  game_bench::BuildWorld (game_bench::WorldOptions (SERIALIZE_PLAYERS, 1000,
+                                                    0, uint256S ("01")),
+                          world);
+
+  CDataStream stream(SER_DISK, CLIENT_VERSION);
+  stream << world;
+  const size_t size = stream.size ();
+  char a = '\0';
+  stream.write (&a, 1); // Prevent compaction
+
+  while (state.KeepRunning ())
+    {
+      GameState out(game_bench::ConsensusParams ());
+      stream >> out;
+      assert (stream.Rewind (size));
+    }
+}
+
+static void
+GameStateWriteJson (benchmark::State& state)
+{
+  GameState world(game_bench::ConsensusParams ());
+  game_bench::BuildWorld (game_bench::WorldOptions (SERIALIZE_PLAYERS, 1000,
+                                                    0, uint256S ("01")),
+                          world);
+
+  while (state.KeepRunning ())
+    {
+      std::string json;
+      JsonWriter writer(json);
+      world.WriteJson (writer);
+    }
+}
+
+BENCHMARK(GameStateSerialize, 130);
+BENCHMARK(GameStateDeserialize, 100);
+BENCHMARK(GameStateWriteJson, 50);
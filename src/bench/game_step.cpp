@@ -0,0 +1,91 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <bench/bench.h>
+#include <bench/game_world.h>
+
+#include <game/move.h>
+#include <game/state.h>
+#include <uint256.h>
+
+#include <vector>
+
+/* Run PerformStep repeatedly on the same world and moves.  */
+static void
+RunSteps (benchmark::State& state, const game_bench::WorldOptions& opt,
+          const unsigned permilleMoving, const unsigned permilleDestruct)
+{
+  GameState world(game_bench::ConsensusParams ());
+  game_bench::BuildWorld (opt, world);
+
+  std::vector<Move> moves;
+  game_bench::BuildMoves (world, uint256S ("02"), permilleMoving,
+                          permilleDestruct, moves);
+
+  while (state.KeepRunning ())
+    {
+      GameState out(game_bench::ConsensusParams ());
+      game_bench::Step (world, moves, out);
+    }
+}
+
+/* Worlds with spread-out characters, where a tenth of the players move
+   and a few destruct.  */
+
+static void
+GameStep1k (benchmark::State& state)
+{
+  RunSteps (state, game_bench::WorldOptions (1000, 100, 0, uint256S ("01")),
+            100, 10);
+}
+
+static void
+GameStep10k (benchmark::State& state)
+{
+  RunSteps (state, game_bench::WorldOptions (10000, 1000, 0, uint256S ("01")),
+            100, 10);
+}
+
+static void
+GameStep50k (benchmark::State& state)
+{
+  RunSteps (state, game_bench::WorldOptions (50000, 5000, 0, uint256S ("01")),
+            100, 10);
+}
+
+/* Crowded world in which a fifth of the players destruct, so that most
+   characters are attacked.  */
+static void
+GameStepHeavyDestruct (benchmark::State& state)
+{
+  RunSteps (state, game_bench::WorldOptions (10000, 0, 40, uint256S ("01")),
+            0, 200);
+}
+
+/* Crowded world covered with loot, so that most characters pick up loot
+   while some of them move.  */
+static void
+GameStepHeavyLoot (benchmark::State& state)
+{
+  RunSteps (state,
+            game_bench::WorldOptions (10000, 20000, 60, uint256S ("01")),
+            100, 0);
+}
+
+BENCHMARK(GameStep1k, 500);
+BENCHMARK(GameStep10k, 30);
+BENCHMARK(GameStep50k, 4);
+BENCHMARK(GameStepHeavyDestruct, 5);
+BENCHMARK(GameStepHeavyLoot, 20);
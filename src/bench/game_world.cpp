@@ -0,0 +1,191 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <bench/game_world.h>
+
+#include <amount.h>
+#include <chainparams.h>
+#include <game/map.h>
+#include <hash.h>
+#include <tinyformat.h>
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+
+namespace game_bench
+{
+
+const Consensus::Params&
+ConsensusParams ()
+{
+  static const std::unique_ptr<CChainParams> chainParams
+    = CreateChainParams (CBaseChainParams::MAIN);
+  return chainParams->GetConsensus ();
+}
+
+const std::vector<Coord>&
+WalkableTiles ()
+{
+  static std::vector<Coord> tiles;
+  if (tiles.empty ())
+    {
+      for (int x = 0; x < MAP_WIDTH; ++x)
+        for (int y = 0; y < MAP_HEIGHT; ++y)
+          if (IsWalkable (x, y))
+            tiles.push_back (Coord (x, y));
+      std::sort (tiles.begin (), tiles.end ());
+    }
+
+  return tiles;
+}
+
+namespace
+{
+
+/* Mainnet heights right before the forks that (re-)create the banks.  */
+const int HEIGHT_BEFORE_LIFESTEAL = 794999;
+const int HEIGHT_BEFORE_TIMESAVE = 1521499;
+
+/* Number of team colours in the game.  */
+const int NUM_COLORS = 4;
+
+/* Lock amount of the synthetic players.  */
+const CAmount PLAYER_COINS = 100 * COIN;
+
+/**
+ * Perform an empty step on the state, starting from the given height.
+ */
+void
+EmptyStep (GameState& state, int nHeight)
+{
+  state.nHeight = nHeight;
+  GameState out(*state.param);
+  Step (state, std::vector<Move> (), out);
+  state = out;
+}
+
+} // anonymous namespace
+
+void
+BuildWorld (const WorldOptions& opt, GameState& state)
+{
+  state = GameState (ConsensusParams ());
+
+  /* Run the steps that create banks (at the life-steal fork) and then
+     replace them by the ones from the time-save fork.  This gives us the
+     full set of dynamic banks.  */
+  EmptyStep (state, HEIGHT_BEFORE_LIFESTEAL);
+  EmptyStep (state, HEIGHT_BEFORE_TIMESAVE);
+  assert (!state.banks.empty ());
+
+  const Coord centre(MAP_WIDTH / 2, MAP_HEIGHT / 2);
+  std::vector<Coord> tiles;
+  for (const auto& c : WalkableTiles ())
+    {
+      if (opt.clusterRadius > 0
+            && static_cast<int> (distLInf (c, centre)) > opt.clusterRadius)
+        continue;
+      if (state.IsBank (c) || (SpawnMap[c.y][c.x] & SPAWNMAPFLAG_PLAYER))
+        continue;
+      tiles.push_back (c);
+    }
+  assert (!tiles.empty ());
+
+  RandomGenerator rng(opt.seed);
+  for (unsigned i = 0; i < opt.players; ++i)
+    {
+      PlayerState pl;
+      pl.color = i % NUM_COLORS;
+      pl.lockedCoins = PLAYER_COINS;
+      pl.value = PLAYER_COINS;
+      pl.next_character_index = 1;
+
+      CharacterState& ch = pl.characters[0];
+      ch.coord = tiles[rng.GetIntRnd (tiles.size ())];
+      ch.from = ch.coord;
+      ch.stay_in_spawn_area = CHARACTER_MODE_NORMAL;
+
+      const PlayerID name(strprintf ("player %d", i));
+      state.players.insert (std::make_pair (name, CowPtr<PlayerState> (pl)));
+    }
+
+  for (unsigned i = 0; i < opt.lootTiles; ++i)
+    state.AddLoot (tiles[rng.GetIntRnd (tiles.size ())], COIN);
+
+  state.RecomputeCoinTotals ();
+}
+
+void
+BuildMoves (const GameState& state, const uint256& seed,
+            const unsigned permilleMoving, const unsigned permilleDestruct,
+            std::vector<Move>& moves)
+{
+  /* Maximum distance of the random waypoints from the character.  */
+  const int maxDist = 10;
+
+  moves.clear ();
+  RandomGenerator rng(seed);
+  for (const auto& p : state.players)
+    {
+      const int r = rng.GetIntRnd (1000);
+      const bool moving = (r < static_cast<int> (permilleMoving));
+      const bool destructing
+          = (!moving && r < static_cast<int> (permilleMoving
+                                              + permilleDestruct));
+      if (!moving && !destructing)
+        continue;
+
+      const auto mi = p.second->characters.find (0);
+      if (mi == p.second->characters.end ())
+        continue;
+
+      Move m;
+      m.player = p.first;
+      m.newLocked = p.second->lockedCoins;
+
+      if (moving)
+        {
+          const Coord& c = mi->second.coord;
+          const int x = c.x + rng.GetIntRnd (2 * maxDist + 1) - maxDist;
+          const int y = c.y + rng.GetIntRnd (2 * maxDist + 1) - maxDist;
+          WaypointVector wp;
+          wp.push_back (Coord (std::max (0, std::min (x, MAP_WIDTH - 1)),
+                               std::max (0, std::min (y, MAP_HEIGHT - 1))));
+          m.waypoints[0] = wp;
+        }
+      else
+        {
+          m.destruct.insert (0);
+          m.newLocked += COIN;
+        }
+
+      moves.push_back (m);
+    }
+}
+
+void
+Step (const GameState& in, const std::vector<Move>& moves, GameState& out)
+{
+  StepData step(in);
+  step.vMoves = moves;
+  step.newHash = Hash (in.hashBlock.begin (), in.hashBlock.end ());
+
+  StepResult res;
+  const bool ok = PerformStep (in, step, out, res);
+  assert (ok);
+}
+
+} // namespace game_bench
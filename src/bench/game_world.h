@@ -0,0 +1,90 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BENCH_GAME_WORLD_H
+#define BENCH_GAME_WORLD_H
+
+/* Helpers to construct deterministic, synthetic game worlds and moves
+   for the game engine benchmarks.  */
+
+#include <game/common.h>
+#include <game/move.h>
+#include <game/state.h>
+#include <uint256.h>
+
+#include <vector>
+
+namespace Consensus
+{
+struct Params;
+}
+
+namespace game_bench
+{
+
+/** Mainnet consensus parameters, which the synthetic worlds use.  */
+const Consensus::Params& ConsensusParams ();
+
+/** All walkable tiles of the map, sorted.  */
+const std::vector<Coord>& WalkableTiles ();
+
+/** Description of a synthetic world.  */
+struct WorldOptions
+{
+
+  /** Number of players, each with a single character.  */
+  unsigned players;
+
+  /** Number of loot tiles placed onto the map.  */
+  unsigned lootTiles;
+
+  /**
+   * If non-zero, restrict characters (and loot) to tiles within this
+   * L-infinity distance from the map centre.  This produces crowded worlds
+   * where destructs hit many characters.
+   */
+  int clusterRadius;
+
+  /** Seed for the random placement.  */
+  uint256 seed;
+
+  WorldOptions (unsigned p, unsigned l, int r, const uint256& s)
+    : players(p), lootTiles(l), clusterRadius(r), seed(s)
+  {}
+
+};
+
+/**
+ * Construct a world according to the options.  The state is at a height
+ * after all forks and has the full set of banks.  Characters are placed
+ * on random walkable tiles that are neither banks nor spawn tiles.
+ */
+void BuildWorld (const WorldOptions& opt, GameState& state);
+
+/**
+ * Construct moves for the next step on the given state.  The given
+ * fractions (in per mille) of players set short waypoints resp. destruct.
+ */
+void BuildMoves (const GameState& state, const uint256& seed,
+                 unsigned permilleMoving, unsigned permilleDestruct,
+                 std::vector<Move>& moves);
+
+/** Perform a step with the given moves, asserting that it succeeds.  */
+void Step (const GameState& in, const std::vector<Move>& moves,
+           GameState& out);
+
+} // namespace game_bench
+
+#endif // BENCH_GAME_WORLD_H
@@ -5,8 +5,61 @@
 
 #include <chain.h>
 
+#include <sync.h>
 #include <validation.h>
 
+#include <list>
+#include <unordered_map>
+
+namespace {
+
+/**
+ * Least-recently-used cache of auxpow block headers.  Peers syncing the
+ * chain request the same ranges of headers, and constructing an auxpow
+ * header needs a database or disk read.
+ */
+class AuxpowHeaderCache
+{
+private:
+    typedef std::list<std::pair<uint256, CBlockHeader>> EntryList;
+
+    CCriticalSection cs;
+    EntryList entries;
+    std::unordered_map<uint256, EntryList::iterator, BlockHasher> index;
+
+public:
+    /** Maximum number of headers in the cache.  */
+    static const size_t MAX_ENTRIES = 10000;
+
+    bool Get(const uint256& hash, CBlockHeader& header)
+    {
+        LOCK(cs);
+        const auto mi = index.find(hash);
+        if (mi == index.end())
+            return false;
+        entries.splice(entries.begin(), entries, mi->second);
+        header = mi->second->second;
+        return true;
+    }
+
+    void Put(const uint256& hash, const CBlockHeader& header)
+    {
+        LOCK(cs);
+        if (index.count(hash) > 0)
+            return;
+        entries.emplace_front(hash, header);
+        index.emplace(hash, entries.begin());
+        if (entries.size() > MAX_ENTRIES) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+};
+
+AuxpowHeaderCache auxpowHeaderCache;
+
+} // anonymous namespace
+
 /* Moved here from the header, because we need auxpow and the logic
    becomes more involved.  */
 CBlockHeader CBlockIndex::GetBlockHeader(const Consensus::Params& consensusParams) const
@@ -14,22 +67,29 @@ CBlockHeader CBlockIndex::GetBlockHeader(const Consensus::Params& consensusParam
     CBlockHeader block;
 
     block.nVersion       = nVersion;
-
-    /* The CBlockIndex object's block header is missing the auxpow.
-       So if this is an auxpow block, read it from disk instead.  We only
-       have to read the actual *header*, not the full block.  */
-    if (block.IsAuxpow())
-    {
-        ReadBlockHeaderFromDisk(block, this, consensusParams);
-        return block;
-    }
-
     if (pprev)
         block.hashPrevBlock = pprev->GetBlockHash();
     block.hashMerkleRoot = hashMerkleRoot;
     block.nTime          = nTime;
     block.nBits          = nBits;
     block.nNonce         = nNonce;
+
+    if (!block.IsAuxpow())
+        return block;
+
+    /* The CBlockIndex object's block header is missing the auxpow.  Take it
+       from the cache or the auxpow index if possible, and only read the
+       header from the block file otherwise.  */
+    const uint256 hash = GetBlockHash();
+    if (auxpowHeaderCache.Get(hash, block))
+        return block;
+
+    if (fAuxpowIndex)
+        block.auxpow = LookupIndexedAuxpow(hash);
+    if (!block.auxpow && !ReadBlockHeaderFromDisk(block, this, consensusParams))
+        return block;
+
+    auxpowHeaderCache.Put(hash, block);
     return block;
 }
 
@@ -357,6 +357,10 @@ public:
     {
         return CPureBlockHeader::GetAlgo(nVersion);
     }
+    inline bool IsAuxpow() const
+    {
+        return CPureBlockHeader::IsAuxpow(nVersion);
+    }
 
 };
 
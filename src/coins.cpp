@@ -11,8 +11,11 @@ bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return f
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
 bool CCoinsView::GetName(const valtype &name, CNameData &data) const { return false; }
-bool CCoinsView::GetNameHistory(const valtype &name, CNameHistory &data) const { return false; }
+unsigned CCoinsView::GetNameHistorySize(const valtype &name) const { return 0; }
+bool CCoinsView::GetNameHistory(const valtype &name, unsigned start, unsigned count, std::vector<CNameData> &entries) const { entries.clear(); return true; }
 CNameIterator* CCoinsView::IterateNames() const { assert (false); }
+CNameIterator* CCoinsView::IterateNamesSnapshot() const { assert (false); }
+CNameIterator* CCoinsView::IterateRecentNames(unsigned minHeight) const { assert (false); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
 bool CCoinsView::ValidateNameDB(CGameDB& gameDb) const { return false; }
@@ -29,8 +32,11 @@ bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 bool CCoinsViewBacked::GetName(const valtype &name, CNameData &data) const { return base->GetName(name, data); }
-bool CCoinsViewBacked::GetNameHistory(const valtype &name, CNameHistory &data) const { return base->GetNameHistory(name, data); }
+unsigned CCoinsViewBacked::GetNameHistorySize(const valtype &name) const { return base->GetNameHistorySize(name); }
+bool CCoinsViewBacked::GetNameHistory(const valtype &name, unsigned start, unsigned count, std::vector<CNameData> &entries) const { return base->GetNameHistory(name, start, count, entries); }
 CNameIterator* CCoinsViewBacked::IterateNames() const { return base->IterateNames(); }
+CNameIterator* CCoinsViewBacked::IterateNamesSnapshot() const { return base->IterateNamesSnapshot(); }
+CNameIterator* CCoinsViewBacked::IterateRecentNames(unsigned minHeight) const { return base->IterateRecentNames(minHeight); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) { return base->BatchWrite(mapCoins, hashBlock, names); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
@@ -163,20 +169,48 @@ bool CCoinsViewCache::GetName(const valtype &name, CNameData& data) const {
     return base->GetName(name, data);
 }
 
-bool CCoinsViewCache::GetNameHistory(const valtype &name, CNameHistory& data) const {
-    if (cacheNames.getHistory(name, data))
-        return true;
+unsigned CCoinsViewCache::GetNameHistorySize(const valtype &name) const {
+    const CNameHistory* history = cacheNames.getHistory(name);
+    if (history)
+        return history->size();
 
     /* Note: This does not attempt to cache backend queries.  The cache
        only keeps track of changes!  */
 
-    return base->GetNameHistory(name, data);
+    return base->GetNameHistorySize(name);
+}
+
+bool CCoinsViewCache::GetNameHistory(const valtype &name, unsigned start, unsigned count, std::vector<CNameData> &entries) const {
+    const CNameHistory* history = cacheNames.getHistory(name);
+    if (!history)
+        return base->GetNameHistory(name, start, count, entries);
+
+    /* Read the entries that are still in the base view from there, and
+       add the ones pushed in this cache.  */
+    entries.clear();
+    const unsigned kept = history->getKeptBase();
+    if (start < kept && !base->GetNameHistory(name, start, std::min(count, kept - start), entries))
+        return false;
+
+    const std::vector<CNameData>& pushed = history->getPushed();
+    for (unsigned i = std::max(start, kept) - kept; i < pushed.size() && entries.size() < count; ++i)
+        entries.push_back(pushed[i]);
+
+    return true;
 }
 
 CNameIterator* CCoinsViewCache::IterateNames() const {
     return cacheNames.iterateNames(base->IterateNames());
 }
 
+CNameIterator* CCoinsViewCache::IterateNamesSnapshot() const {
+    return cacheNames.iterateNamesSnapshot(base->IterateNamesSnapshot());
+}
+
+CNameIterator* CCoinsViewCache::IterateRecentNames(unsigned minHeight) const {
+    return cacheNames.iterateRecentNames(base->IterateRecentNames(minHeight), minHeight);
+}
+
 /* undo is set if the change is due to disconnecting blocks / going back in
    time.  The ordinary case (!undo) means that we update the name normally,
    going forward in time.  This is important for keeping track of the
@@ -193,20 +227,25 @@ void CCoinsViewCache::SetName(const valtype &name, const CNameData& data, bool u
            for the name history.  */
         if (fNameHistory)
         {
-            CNameHistory history;
-            if (!GetNameHistory(name, history))
-            {
-                /* Ensure that the history stack is indeed (still) empty
-                   and was not modified by the failing GetNameHistory call.  */
-                assert(history.empty());
-            }
+            const unsigned baseSize = cacheNames.getHistory(name) ? 0 : base->GetNameHistorySize(name);
+            CNameHistory& history = cacheNames.modifyHistory(name, baseSize);
 
             if (undo)
+            {
+                /* If the top entry comes from the base view, check it
+                   there (popping from this cache's entries checks
+                   them itself).  */
+                if (history.getPushed().empty())
+                {
+                    std::vector<CNameData> top;
+                    assert(history.size() > 0);
+                    if (!base->GetNameHistory(name, history.size() - 1, 1, top))
+                        throw std::runtime_error("failed to read name history");
+                    assert(top.size() == 1 && top.front() == data);
+                }
                 history.pop(data);
-            else
+            } else
                 history.push(oldData);
-
-            cacheNames.setHistory(name, history);
         }
     } else
         assert (!undo);
@@ -218,8 +257,7 @@ void CCoinsViewCache::DeleteName(const valtype &name) {
     if (fNameHistory)
     {
         /* When deleting a name, the history should already be clean.  */
-        CNameHistory history;
-        assert (!GetNameHistory(name, history) || history.empty());
+        assert (GetNameHistorySize(name) == 0);
     }
 
     cacheNames.remove(name);
@@ -177,12 +177,26 @@ public:
     // Get a name (if it exists)
     virtual bool GetName(const valtype& name, CNameData& data) const;
 
-    // Get a name's history (if it exists)
-    virtual bool GetNameHistory(const valtype& name, CNameHistory& data) const;
+    // Get the number of entries in a name's history
+    virtual unsigned GetNameHistorySize(const valtype& name) const;
+
+    // Get up to count entries of a name's history, starting at index start
+    // (the oldest entry has index zero).  Returns false on errors.
+    virtual bool GetNameHistory(const valtype& name, unsigned start, unsigned count, std::vector<CNameData>& entries) const;
 
     // Get a name iterator.
     virtual CNameIterator* IterateNames() const;
 
+    // Get a name iterator over a snapshot of the current state.  It does
+    // not depend on this view afterwards, so it can be used without
+    // holding cs_main.
+    virtual CNameIterator* IterateNamesSnapshot() const;
+
+    // Get an iterator over a snapshot (as above) of the names that were
+    // last updated at or after the given height.  The names are returned
+    // in no particular order.  This requires -nameheightindex.
+    virtual CNameIterator* IterateRecentNames(unsigned minHeight) const;
+
     //! Do a bulk modification (multiple Coin changes + BestBlock change).
     //! The passed mapCoins can be modified.
     virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names);
@@ -214,8 +228,11 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool GetName(const valtype& name, CNameData& data) const override;
-    bool GetNameHistory(const valtype& name, CNameHistory& data) const override;
+    unsigned GetNameHistorySize(const valtype& name) const override;
+    bool GetNameHistory(const valtype& name, unsigned start, unsigned count, std::vector<CNameData>& entries) const override;
     CNameIterator* IterateNames() const override;
+    CNameIterator* IterateNamesSnapshot() const override;
+    CNameIterator* IterateRecentNames(unsigned minHeight) const override;
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) override;
     CCoinsViewCursor *Cursor() const override;
@@ -256,8 +273,11 @@ public:
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
     bool GetName(const valtype &name, CNameData &data) const override;
-    bool GetNameHistory(const valtype &name, CNameHistory &data) const override;
+    unsigned GetNameHistorySize(const valtype &name) const override;
+    bool GetNameHistory(const valtype &name, unsigned start, unsigned count, std::vector<CNameData> &entries) const override;
     CNameIterator* IterateNames() const override;
+    CNameIterator* IterateNamesSnapshot() const override;
+    CNameIterator* IterateRecentNames(unsigned minHeight) const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names);
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
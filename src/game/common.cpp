@@ -15,52 +15,260 @@
 
 #include <game/common.h>
 
+#include <crypto/common.h>
 #include <hash.h>
 #include <names/common.h>
 #include <tinyformat.h>
 
+#include <cstring>
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+
+/**
+ * One shard of the table of interned player names.  The table is split
+ * into shards with their own locks, so that threads converting names
+ * (block validation, prefetching, RPC) rarely contend.
+ */
+template<typename Entry>
+  struct InternShard
+{
+
+  std::mutex mut;
+  std::unordered_map<std::string, Entry*> entries;
+
+};
+
+/** Number of shards of the intern table.  */
+const size_t INTERN_SHARDS = 16;
+
+template<typename Entry>
+  InternShard<Entry>*
+GetInternShards ()
+{
+  /* The table is intentionally leaked, so that it outlives all static
+     objects holding names.  */
+  static InternShard<Entry>* shards = new InternShard<Entry>[INTERN_SHARDS];
+  return shards;
+}
+
+template<typename Entry>
+  InternShard<Entry>&
+GetInternShard (const std::string& str)
+{
+  const size_t ind = std::hash<std::string> () (str) % INTERN_SHARDS;
+  return GetInternShards<Entry> ()[ind];
+}
+
+/**
+ * Increment the reference count of an entry, unless it already dropped
+ * to zero.  Such an entry is being released and must not be revived.
+ */
+template<typename Entry>
+  bool
+AcquireEntry (Entry& e)
+{
+  unsigned refs = e.refs.load (std::memory_order_relaxed);
+  while (refs > 0)
+    if (e.refs.compare_exchange_weak (refs, refs + 1,
+                                      std::memory_order_relaxed))
+      return true;
+
+  return false;
+}
+
+} // anonymous namespace
+
+PlayerID::Entry*
+PlayerID::Intern (const std::string& str)
+{
+  auto& shard = GetInternShard<Entry> (str);
+  std::lock_guard<std::mutex> lock(shard.mut);
+
+  /* If the name is there but being released, a fresh entry replaces it.
+     Release only removes the table entry if it still points to the
+     released object.  */
+  Entry*& slot = shard.entries[str];
+  if (slot != nullptr && AcquireEntry (*slot))
+    return slot;
+
+  slot = new Entry (str);
+  return slot;
+}
+
+PlayerID::Entry*
+PlayerID::EmptyName ()
+{
+  /* The static handle keeps the entry alive forever.  */
+  static const PlayerID empty(Intern (""));
+  empty.entry->refs.fetch_add (1, std::memory_order_relaxed);
+  return empty.entry;
+}
+
+void
+PlayerID::Release (Entry* e)
+{
+  {
+    auto& shard = GetInternShard<Entry> (e->name);
+    std::lock_guard<std::mutex> lock(shard.mut);
+    const auto mi = shard.entries.find (e->name);
+    if (mi != shard.entries.end () && mi->second == e)
+      shard.entries.erase (mi);
+  }
+
+  delete e;
+}
+
+bool
+PlayerID::Lookup (const std::string& str, PlayerID& res)
+{
+  Entry* found;
+  {
+    auto& shard = GetInternShard<Entry> (str);
+    std::lock_guard<std::mutex> lock(shard.mut);
+
+    const auto mi = shard.entries.find (str);
+    if (mi == shard.entries.end () || !AcquireEntry (*mi->second))
+      return false;
+    found = mi->second;
+  }
+
+  /* Assign only after unlocking, since this may release the entry
+     previously held by res.  */
+  res = PlayerID (found);
+  return true;
+}
+
+size_t
+PlayerID::NumInterned ()
+{
+  auto* shards = GetInternShards<Entry> ();
+
+  size_t res = 0;
+  for (size_t i = 0; i < INTERN_SHARDS; ++i)
+    {
+      std::lock_guard<std::mutex> lock(shards[i].mut);
+      res += shards[i].entries.size ();
+    }
+
+  return res;
+}
+
+std::ostream&
+operator<< (std::ostream& out, const PlayerID& p)
+{
+  return out << p.str ();
+}
+
 std::string CharacterID::ToString() const
 {
     if (!index)
-        return player;
-    return player + strprintf(".%d", int(index));
+        return player.str();
+    return player.str() + strprintf(".%d", int(index));
 }
 
 RandomGenerator::RandomGenerator (const uint256& hashBlock)
   : state0(SerializeHash (hashBlock, SER_GETHASH, 0))
 {
-    state = UintToArith256 (state0);
+    LoadState ();
+}
+
+void
+RandomGenerator::LoadState ()
+{
+  for (int i = 0; i < STATE_LIMBS; ++i)
+    state[i] = ReadLE32 (state0.begin () + 4 * i);
+}
+
+bool
+RandomGenerator::IsStateExhausted () const
+{
+  static const uint256 minBytes = ArithToUint256 (MIN_STATE);
+
+  for (int i = STATE_LIMBS - 1; i >= 0; --i)
+    {
+      const uint32_t minLimb = ReadLE32 (minBytes.begin () + 4 * i);
+      if (state[i] != minLimb)
+        return state[i] < minLimb;
+    }
+
+  return false;
 }
 
 int
 RandomGenerator::GetIntRnd (int modulo)
 {
   // Advance generator state, if most bits of the current state were used
-  if (state < MIN_STATE)
+  if (IsStateExhausted ())
     {
       /* The original "legacy" implementation based on CBigNum serialised
          the value based on valtype and with leading zeros removed.  For
-         compatibility with the old consensus behaviour, we replicate this.  */
+         compatibility with the old consensus behaviour, we replicate this.
+
+         The legacy representation uses the highest bit as sign bit.  Thus
+         we have to add a zero at the end if the highest bit is set.
 
-      valtype data(state0.begin (), state0.end ());
-      while (data.back () == 0)
-        data.pop_back ();
+         The data is hashed in the same way as SerializeHash of a valtype
+         would, but without allocating the vector.  */
 
-      /* The legacy representation uses the highest bit as sign bit.  Thus
-         we have to add a zero at the end if the highest bit is set.  */
-      if (data.back () & 128)
-        data.push_back (0);
+      unsigned char data[sizeof (state0) + 1];
+      size_t len = state0.size ();
+      memcpy (data, state0.begin (), len);
+      while (len > 0 && data[len - 1] == 0)
+        --len;
+      assert (len > 0);
+      if (data[len - 1] & 128)
+        data[len++] = 0;
 
-      state0 = SerializeHash (data, SER_GETHASH, 0);
-      state = UintToArith256 (state0);
+      CHashWriter hasher(SER_GETHASH, 0);
+      WriteCompactSize (hasher, len);
+      hasher.write (reinterpret_cast<const char*> (data), len);
+      state0 = hasher.GetHash ();
+      LoadState ();
     }
 
-  arith_uint256 res = state;
-  state /= modulo;
-  res -= state * modulo;
+  /* The moduli used by the game are always positive.  Handle anything
+     else with the generic arithmetic, so that we match the legacy
+     behaviour exactly (including division by zero).  */
+  if (modulo <= 0)
+    {
+      arith_uint256 num;
+      for (int i = STATE_LIMBS - 1; i >= 0; --i)
+        {
+          num <<= 32;
+          num |= arith_uint256 (state[i]);
+        }
+
+      arith_uint256 res = num;
+      num /= modulo;
+      res -= num * modulo;
+
+      const uint256 bytes = ArithToUint256 (num);
+      for (int i = 0; i < STATE_LIMBS; ++i)
+        state[i] = ReadLE32 (bytes.begin () + 4 * i);
+
+      assert (res.bits () < 64);
+      return res.GetLow64 ();
+    }
+
+  /* Schoolbook division of the state by the 32-bit modulus, one limb
+     at a time from the most significant one.  The remainder is the
+     random number.  */
+  const uint64_t divisor = modulo;
+  uint64_t rem = 0;
+  for (int i = STATE_LIMBS - 1; i >= 0; --i)
+    {
+      const uint64_t cur = (rem << 32) | state[i];
+      state[i] = cur / divisor;
+      rem = cur % divisor;
+    }
 
-  assert (res.bits () < 64);
-  return res.GetLow64 ();
+  assert (rem < divisor);
+  return rem;
 }
 
 const arith_uint256 RandomGenerator::MIN_STATE
@@ -17,25 +17,434 @@
 #define GAME_COMMON_H
 
 #include <arith_uint256.h>
+#include <memusage.h>
+#include <prevector.h>
 #include <serialize.h>
 #include <uint256.h>
 
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <ostream>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 class uint256;
 class KilledByInfo;
 class PlayerState;
 
-// Unique player name
-typedef std::string PlayerID;
+/**
+ * Reference-counted, copy-on-write holder for a value.  Copying it only
+ * shares the underlying object; a private copy is made when Modify() is
+ * called on a shared instance.  This is used for the per-player data in
+ * GameState, so that copying the state (as done for every game step and
+ * in the game-state cache) does not deep-copy all characters and waypoints
+ * of players that are not changed.
+ *
+ * Serialisation is transparent, i. e., the same as for the wrapped value.
+ */
+template<typename T>
+  class CowPtr
+{
+
+private:
+
+  std::shared_ptr<T> ptr;
+
+public:
+
+  CowPtr ()
+    : ptr(std::make_shared<T> ())
+  {}
+
+  explicit CowPtr (const T& val)
+    : ptr(std::make_shared<T> (val))
+  {}
+
+  inline const T&
+  operator* () const
+  {
+    return *ptr;
+  }
+
+  inline const T*
+  operator-> () const
+  {
+    return ptr.get ();
+  }
+
+  /**
+   * Get a modifiable reference to the value.  If it is currently shared
+   * with other instances, it is copied first.  References obtained from
+   * earlier calls remain valid as long as this instance is not copied.
+   */
+  inline T&
+  Modify ()
+  {
+    if (ptr.use_count () != 1)
+      ptr = std::make_shared<T> (*ptr);
+    return *ptr;
+  }
+
+  /** Check whether both instances share the same underlying object.  */
+  inline bool
+  SharesWith (const CowPtr<T>& other) const
+  {
+    return ptr == other.ptr;
+  }
+
+  /**
+   * Heap memory of the shared allocation holding the value.  This does not
+   * include memory the value itself refers to.
+   */
+  inline size_t
+  DynamicUsage () const
+  {
+    return memusage::DynamicUsage (ptr);
+  }
+
+  template<typename Stream>
+    inline void Serialize (Stream& s) const
+  {
+    ::Serialize (s, *ptr);
+  }
+
+  template<typename Stream>
+    inline void Unserialize (Stream& s)
+  {
+    ptr = std::make_shared<T> ();
+    ::Unserialize (s, *ptr);
+  }
+
+};
+
+/**
+ * Map stored as sorted vector of key/value pairs.  It implements the part
+ * of the std::map interface that is needed for the characters of a player,
+ * and is serialised in exactly the same format as a std::map.  Since players
+ * have only a few characters, this saves a heap node per entry and keeps
+ * the entries contiguous in memory.
+ *
+ * Unlike with std::map, inserting or erasing entries invalidates iterators
+ * and references to other entries.
+ */
+template<typename K, typename V>
+  class FlatMap
+{
+
+public:
+
+  typedef std::pair<K, V> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+private:
+
+  std::vector<value_type> entries;
+
+  static inline bool
+  KeyLess (const value_type& entry, const K& key)
+  {
+    return entry.first < key;
+  }
+
+  inline iterator
+  LowerBound (const K& key)
+  {
+    return std::lower_bound (entries.begin (), entries.end (), key, &KeyLess);
+  }
+
+  inline const_iterator
+  LowerBound (const K& key) const
+  {
+    return std::lower_bound (entries.begin (), entries.end (), key, &KeyLess);
+  }
+
+public:
+
+  FlatMap ()
+    : entries()
+  {}
+
+  inline iterator begin () { return entries.begin (); }
+  inline iterator end () { return entries.end (); }
+  inline const_iterator begin () const { return entries.begin (); }
+  inline const_iterator end () const { return entries.end (); }
+
+  inline size_t size () const { return entries.size (); }
+  inline bool empty () const { return entries.empty (); }
+  inline void clear () { entries.clear (); }
+
+  /** Heap memory of the entries (not including what they refer to).  */
+  inline size_t
+  DynamicUsage () const
+  {
+    return memusage::DynamicUsage (entries);
+  }
+
+  inline iterator
+  find (const K& key)
+  {
+    const iterator it = LowerBound (key);
+    if (it != entries.end () && it->first == key)
+      return it;
+    return entries.end ();
+  }
+
+  inline const_iterator
+  find (const K& key) const
+  {
+    const const_iterator it = LowerBound (key);
+    if (it != entries.end () && it->first == key)
+      return it;
+    return entries.end ();
+  }
+
+  inline size_t
+  count (const K& key) const
+  {
+    return find (key) == entries.end () ? 0 : 1;
+  }
+
+  std::pair<iterator, bool>
+  insert (const value_type& val)
+  {
+    /* Appending is the common case, since new characters get
+       increasing indices.  */
+    if (entries.empty () || entries.back ().first < val.first)
+      {
+        entries.push_back (val);
+        return std::make_pair (entries.end () - 1, true);
+      }
+
+    const iterator it = LowerBound (val.first);
+    if (it != entries.end () && it->first == val.first)
+      return std::make_pair (it, false);
+
+    return std::make_pair (entries.insert (it, val), true);
+  }
+
+  inline V&
+  operator[] (const K& key)
+  {
+    const iterator it = find (key);
+    if (it != entries.end ())
+      return it->second;
+
+    return insert (value_type (key, V ())).first->second;
+  }
+
+  inline size_t
+  erase (const K& key)
+  {
+    const iterator it = find (key);
+    if (it == entries.end ())
+      return 0;
+
+    entries.erase (it);
+    return 1;
+  }
+
+  template<typename Stream>
+    void Serialize (Stream& s) const
+  {
+    WriteCompactSize (s, entries.size ());
+    for (const auto& entry : entries)
+      ::Serialize (s, entry);
+  }
+
+  template<typename Stream>
+    void Unserialize (Stream& s)
+  {
+    entries.clear ();
+    const unsigned nSize = ReadCompactSize (s);
+    entries.reserve (nSize);
+    for (unsigned i = 0; i < nSize; ++i)
+      {
+        value_type entry;
+        ::Unserialize (s, entry);
+        insert (entry);
+      }
+  }
+
+};
+
+/**
+ * Unique player name.  Names are interned in a global table, so that each
+ * distinct name is stored only once (no matter in how many game states
+ * it appears) and comparing names for equality only compares the handles.
+ * Ordering is still that of the name strings, since it matters for
+ * consensus (e. g., the order in which players are processed).
+ *
+ * Entries of the table are reference counted and removed when the last
+ * handle referring to them goes away.  Lookups of names that are not
+ * known to be valid (e. g., from RPC) should use Lookup, which does not
+ * add entries at all.
+ *
+ * The string form is only needed for serialisation and JSON output.
+ * Serialisation is the same as for a plain string.
+ */
+class PlayerID
+{
+
+private:
+
+  /** Entry of the intern table.  */
+  struct Entry
+  {
+
+    /** The name itself.  */
+    const std::string name;
+
+    /** Number of PlayerID handles referring to this entry.  */
+    std::atomic<unsigned> refs;
+
+    explicit inline Entry (const std::string& n)
+      : name(n), refs(1)
+    {}
+
+    Entry (const Entry&) = delete;
+    void operator= (const Entry&) = delete;
+
+  };
+
+  /** The interned name.  Never null, also the empty name is interned.  */
+  Entry* entry;
+
+  /**
+   * Construct the handle from an entry whose reference count has already
+   * been incremented for it.
+   */
+  explicit inline PlayerID (Entry* e)
+    : entry(e)
+  {}
+
+  /**
+   * Look up the given name in the table of interned names, and add it
+   * if it is not there yet.  The reference count of the returned entry
+   * is incremented.
+   */
+  static Entry* Intern (const std::string& str);
+
+  /** Return the (referenced) entry of the empty name.  */
+  static Entry* EmptyName ();
+
+  /** Remove an entry whose reference count dropped to zero.  */
+  static void Release (Entry* e);
+
+public:
+
+  inline PlayerID ()
+    : entry(EmptyName ())
+  {}
+
+  /* Conversions from strings are implicit on purpose, so that names
+     can be used wherever a PlayerID is expected.  */
+
+  inline PlayerID (const std::string& str)
+    : entry(Intern (str))
+  {}
+
+  inline PlayerID (const char* str)
+    : entry(Intern (str))
+  {}
+
+  inline PlayerID (const PlayerID& o)
+    : entry(o.entry)
+  {
+    entry->refs.fetch_add (1, std::memory_order_relaxed);
+  }
+
+  inline ~PlayerID ()
+  {
+    if (entry->refs.fetch_sub (1, std::memory_order_acq_rel) == 1)
+      Release (entry);
+  }
+
+  inline PlayerID&
+  operator= (const PlayerID& o)
+  {
+    PlayerID tmp(o);
+    std::swap (entry, tmp.entry);
+    return *this;
+  }
+
+  /**
+   * Find the handle of a name without interning it.  Returns false if the
+   * name is not in the table, in which case no game state can contain it.
+   */
+  static bool Lookup (const std::string& str, PlayerID& res);
+
+  /** Return the number of names in the intern table.  For testing.  */
+  static size_t NumInterned ();
+
+  inline const std::string&
+  str () const
+  {
+    return entry->name;
+  }
+
+  inline operator const std::string& () const
+  {
+    return entry->name;
+  }
+
+  inline const char*
+  c_str () const
+  {
+    return entry->name.c_str ();
+  }
+
+  inline bool
+  empty () const
+  {
+    return entry->name.empty ();
+  }
+
+  friend inline bool
+  operator== (const PlayerID& a, const PlayerID& b)
+  {
+    return a.entry == b.entry;
+  }
+
+  friend inline bool
+  operator!= (const PlayerID& a, const PlayerID& b)
+  {
+    return a.entry != b.entry;
+  }
+
+  friend inline bool
+  operator< (const PlayerID& a, const PlayerID& b)
+  {
+    return a.entry != b.entry && a.entry->name < b.entry->name;
+  }
+
+  friend std::ostream& operator<< (std::ostream& out, const PlayerID& p);
+
+  template<typename Stream>
+    inline void Serialize (Stream& s) const
+  {
+    ::Serialize (s, entry->name);
+  }
+
+  template<typename Stream>
+    inline void Unserialize (Stream& s)
+  {
+    std::string str;
+    ::Unserialize (s, str);
+    *this = PlayerID (str);
+  }
+
+};
 //
 // Define STL types used for killed player identification later on.
 typedef std::set<PlayerID> PlayerSet;
 typedef std::multimap<PlayerID, KilledByInfo> KilledByMap;
-typedef std::map<PlayerID, PlayerState> PlayerStateMap;
+typedef std::map<PlayerID, CowPtr<PlayerState> > PlayerStateMap;
 
 // Player name + character index
 struct CharacterID
@@ -66,7 +475,10 @@ struct Coord
 {
     int x, y;
 
-    Coord() : x(0), y(0) { }
+    /* The default constructor is trivial, so that WaypointVector (a
+       prevector) can clear and resize its storage with memset.  Use
+       value-initialisation (Coord()) to get the origin.  */
+    Coord() = default;
     Coord(int x_, int y_) : x(x_), y(y_) { }
 
     ADD_SERIALIZE_METHODS;
@@ -87,7 +499,9 @@ struct Coord
     bool operator>=(const Coord &that) const { return !(*this < that); }
 };
 
-typedef std::vector<Coord> WaypointVector;
+/* Most characters have no or only a few waypoints, so store up to two
+   of them inline without a heap allocation.  */
+typedef prevector<2, Coord> WaypointVector;
 
 // Random generator seeded with block hash
 class RandomGenerator
@@ -109,9 +523,27 @@ public:
     }
 
 private:
+
+    /** Number of 32-bit limbs in the state.  */
+    static constexpr int STATE_LIMBS = 8;
+
     uint256 state0;
-    arith_uint256 state;
+
+    /**
+     * The current state as 256-bit number, stored as 32-bit limbs with
+     * the least significant first (as in arith_uint256).  Keeping the limbs
+     * directly allows dividing by the (32-bit) modulus without going through
+     * the generic 256-bit division.
+     */
+    uint32_t state[STATE_LIMBS];
+
     static const arith_uint256 MIN_STATE;
+
+    /** Set the state from state0.  */
+    void LoadState ();
+
+    /** Check whether the state is below MIN_STATE.  */
+    bool IsStateExhausted () const;
 };
 
 #endif
@@ -18,11 +18,15 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <consensus/validation.h>
+#include <game/delta.h>
 #include <game/move.h>
+#include <game/prefetch.h>
 #include <game/state.h>
+#include <memusage.h>
 #include <util.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <vector>
 #include <memory>
 
@@ -32,22 +36,22 @@
    need them so we can tell game states apart from the obfuscation key that
    is also in the database.  */
 static const char DB_GAMESTATE = 'g';
+static const char DB_GAMESTATE_DELTA = 'd';
 
-/* Define some configuration parameters.  */
-/* TODO: Make them CLI options.  */
-static const unsigned KEEP_EVERY_NTH = 2000;
+/* Number of recent main-chain states that are never evicted from memory.  */
 static const unsigned MIN_IN_MEMORY = 10;
-static const unsigned MAX_IN_MEMORY = 100;
-static const unsigned DB_CACHE_SIZE = (25 << 20);
 
-CGameDB::CGameDB (bool fMemory, bool fWipe)
-  : keepEveryNth(KEEP_EVERY_NTH),
-    minInMemory(MIN_IN_MEMORY), maxInMemory(MAX_IN_MEMORY),
+CGameDB::CGameDB (size_t nDbCache, size_t nStateCache,
+                  unsigned snapshotInterval, unsigned nDeltaDepth,
+                  bool fMemory, bool fWipe)
+  : keepEveryNth(snapshotInterval), deltaDepth(nDeltaDepth),
+    minInMemory(MIN_IN_MEMORY), maxCacheUsage(nStateCache),
     keepEverything(false),
-    db(GetDataDir() / "gamestates", DB_CACHE_SIZE, fMemory, fWipe, true),
-    cache(), cs_cache()
+    db(GetDataDir() / "gamestates", nDbCache, fMemory, fWipe, true),
+    cache(), useCounter(0), playerRefs(), stateUsage(0), expiredDeltas(),
+    cs_cache(), tip(), pending(), cs_pending(), cvPending()
 {
-  // Nothing else to do.
+  assert (keepEveryNth > 0 && deltaDepth > 0);
 }
 
 CGameDB::~CGameDB ()
@@ -57,109 +61,405 @@ CGameDB::~CGameDB ()
   assert (cache.empty ());
 }
 
-bool
-CGameDB::getFromCache (const uint256& hash, GameState& state) const
+GameStateRef
+CGameDB::getFromCache (const uint256& hash) const
 {
+  /* The tip state is the one most often requested, and we can return it
+     without any locking.  */
+  GameStateRef res = getTip ();
+  if (res && res->hashBlock == hash)
+    return res;
+
   {
     LOCK (cs_cache);
-    const GameStateMap::const_iterator mi = cache.find (hash);
+    const GameStateMap::iterator mi = cache.find (hash);
     if (mi != cache.end ())
       {
-        state = *mi->second;
-        assert (hash == state.hashBlock);
-        return true;
+        assert (hash == mi->second.state->hashBlock);
+        mi->second.lastUse = ++useCounter;
+        return mi->second.state;
       }
   }
 
-  if (!db.Read (std::make_pair (DB_GAMESTATE, hash), state))
-    return false;
+  std::shared_ptr<GameState> state
+    = std::make_shared<GameState> (Params ().GetConsensus ());
+  if (!db.Read (std::make_pair (DB_GAMESTATE, hash), *state))
+    return nullptr;
 
-  assert (hash == state.hashBlock);
-  return true;
+  assert (hash == state->hashBlock);
+  return state;
 }
 
+/**
+ * The data about a block that is needed to replay it.  This is copied
+ * from the block index while holding cs_main, so that the actual
+ * replay can be done without it.
+ */
+struct CGameDB::ReplayBlock
+{
+
+  uint256 hash;
+  int height;
+  CDiskBlockPos pos;
+  /** Whether the block's delta is within the retention window.  */
+  bool keepDelta;
+
+  ReplayBlock (const CBlockIndex& index, const int tipHeight,
+               const unsigned deltaDepth)
+    : hash(index.GetBlockHash ()), height(index.nHeight),
+      pos(index.GetBlockPos ()),
+      keepDelta(chainActive.Contains (&index)
+                  && index.nHeight + static_cast<int> (deltaDepth) > tipHeight)
+  {}
+
+};
+
 bool
 CGameDB::get (const uint256& hash, GameState& state)
 {
-  if (!getFromCache (hash, state))
+  const GameStateRef res = getSnapshot (hash);
+  if (!res)
+    return false;
+
+  state = *res;
+  return true;
+}
+
+GameStateRef
+CGameDB::getSnapshot (const uint256& hash)
+{
+  GameStateRef res = getFromCache (hash);
+  if (res)
+    return res;
+
+  const CChainParams& chainparams = Params ();
+  GameState stateIn(chainparams.GetConsensus ());
+  std::vector<ReplayBlock> needed;
+  if (!findReplayBase (hash, stateIn, needed))
+    return nullptr;
+
+  /* If another thread is already computing the state, wait for it
+     and use its result.  Otherwise register our own computation, so that
+     concurrent requests for the same state can share it.
+
+     After registering, we must not lock cs_main (except recursively if
+     the caller already holds it).  Otherwise we could deadlock with
+     a thread that holds cs_main and waits for our result.  */
+  std::shared_ptr<PendingReplay> job;
+  {
+    WaitableLock lock(cs_pending);
+    const PendingMap::const_iterator mi = pending.find (hash);
+    if (mi != pending.end ())
+      {
+        const std::shared_ptr<PendingReplay> other = mi->second;
+        while (!other->done)
+          cvPending.wait (lock);
+
+        if (!other->result)
+          {
+            error ("%s: concurrent computation of game state failed",
+                   __func__);
+            return nullptr;
+          }
+        return other->result;
+      }
+
+    job = std::make_shared<PendingReplay> ();
+    pending.insert (std::make_pair (hash, job));
+  }
+
+  const bool ok = replayBlocks (stateIn, needed);
+  if (ok)
+    res = std::make_shared<GameState> (std::move (stateIn));
+  {
+    WaitableLock lock(cs_pending);
+    if (ok)
+      {
+        LOCK (cs_cache);
+        insertIntoCache (hash, res);
+        job->result = res;
+      }
+    job->done = true;
+    pending.erase (hash);
+  }
+  cvPending.notify_all ();
+
+  if (!ok)
+    return nullptr;
+
+  /* Flushing needs cs_main.  Lock it before cs_cache to keep the same
+     lock order as ConnectBlock, which calls us while holding cs_main.  */
+  bool needFlush;
+  {
+    LOCK (cs_cache);
+    needFlush = needsFlush ();
+  }
+  if (needFlush)
     {
-      /* Look up the latest previous block for which the game
-         state is known in the cache somewhere.  If it goes back
-         to the genesis block, use a default-constructed game state
-         instead as the input.  It corresponds to the block "before"
-         the genesis block.
+      LOCK2 (cs_main, cs_cache);
+      attemptFlush ();
+    }
 
-         We keep all CBlockIndex pointers in a vector, so that
-         we can then go back up the chain without relying on chainActive.  */
+  assert (hash == res->hashBlock);
+  return res;
+}
 
-      LOCK (cs_main);
-      const CChainParams& chainparams = Params ();
-      GameState stateIn(chainparams.GetConsensus ());
-
-      std::vector<const CBlockIndex*> needed;
-      const BlockMap::const_iterator mi = mapBlockIndex.find (hash);
-      if (mi == mapBlockIndex.end ())
-        return error ("%s: block hash not found", __func__);
-      needed.push_back (mi->second);
-      while (needed.back ()->pprev)
-        {
-          const CBlockIndex* pprev = needed.back ()->pprev;
-          if (getFromCache (*pprev->phashBlock, stateIn))
-            break;
-          needed.push_back (pprev);
-        }
+bool
+CGameDB::findReplayBase (const uint256& hash, GameState& stateIn,
+                         std::vector<ReplayBlock>& needed) const
+{
+  /* Look up the latest previous block for which the game
+     state is known in the cache somewhere.  If it goes back
+     to the genesis block, use a default-constructed game state
+     instead as the input.  It corresponds to the block "before"
+     the genesis block.
+
+     The block index entries are copied in batches (up to the next
+     height at which states are kept on disk) while holding cs_main.
+     Looking up the states themselves is done without holding the lock.  */
+
+  needed.clear ();
+  const CBlockIndex* pnext;
+  {
+    LOCK (cs_main);
+    const BlockMap::const_iterator mi = mapBlockIndex.find (hash);
+    if (mi == mapBlockIndex.end ())
+      return error ("%s: block hash not found", __func__);
+    pnext = mi->second;
+  }
 
-      LogPrint (BCLog::GAME,
-                "Integrating game state from height %d to height %d.\n",
-                stateIn.nHeight, needed.front ()->nHeight);
+  while (true)
+    {
+      const size_t first = needed.size ();
+      {
+        LOCK (cs_main);
+        while (pnext)
+          {
+            needed.push_back (ReplayBlock (*pnext, chainActive.Height (),
+                                           deltaDepth));
+            pnext = pnext->pprev;
+            if (needed.back ().height % keepEveryNth == 0)
+              break;
+          }
+      }
 
-      while (!needed.empty ())
+      /* The first entry is the requested state itself, which we know
+         is not available.  For the others, check if we have their state
+         and can start from there.  */
+      for (size_t i = std::max<size_t> (first, 1); i < needed.size (); ++i)
         {
-          const CBlockIndex* pindex = needed.back ();
-          needed.pop_back ();
-          assert (stateIn.nHeight + 1 == pindex->nHeight);
+          const GameStateRef base = getFromCache (needed[i].hash);
+          if (base)
+            {
+              stateIn = *base;
+              needed.erase (needed.begin () + i, needed.end ());
+              return true;
+            }
+        }
 
-          CBlock block;
-          if (!ReadBlockFromDisk (block, pindex, chainparams.GetConsensus ()))
-            return error ("%s: failed to read block from disk", __func__);
+      if (!pnext)
+        return true;
+    }
+}
 
-          CValidationState valid;
-          StepResult res;
-          if (!PerformStep (block, stateIn, NULL, valid, res, state))
-            return error ("%s: failed to perform game step", __func__);
+bool
+CGameDB::replayBlocks (GameState& state, std::vector<ReplayBlock>& needed)
+{
+  const CChainParams& chainparams = Params ();
+
+  LogPrint (BCLog::GAME,
+            "Integrating game state from height %d to height %d.\n",
+            state.nHeight, needed.front ().height);
+
+  /* Apply the stored deltas where possible.  Blocks for which we
+     have no delta (e. g., connected by an older client) are replayed
+     instead, and their delta is stored for future use if it is within
+     the retention window.
+
+     The blocks that need to be replayed are read and their moves parsed
+     on worker threads ahead of time, so that only the game steps
+     themselves are done sequentially here.  */
+  std::vector<bool> haveDelta(needed.size ());
+  std::vector<BlockPrefetcher::Entry> toRead;
+  for (size_t i = needed.size (); i > 0; --i)
+    {
+      const ReplayBlock& cur = needed[i - 1];
+      haveDelta[i - 1]
+        = db.Exists (std::make_pair (DB_GAMESTATE_DELTA, cur.hash));
+      if (!haveDelta[i - 1])
+        toRead.push_back (BlockPrefetcher::Entry (cur.hash, cur.pos));
+    }
+  BlockPrefetcher prefetcher(chainparams.GetConsensus (), toRead, true);
 
-          assert (state.hashBlock == *pindex->phashBlock);
-          stateIn = state;
-        }
+  unsigned applied = 0, replayed = 0;
+  GameState stateOut(chainparams.GetConsensus ());
+  while (!needed.empty ())
+    {
+      const ReplayBlock cur = needed.back ();
+      const bool prefetched = !haveDelta[needed.size () - 1];
+      needed.pop_back ();
+      assert (state.nHeight + 1 == cur.height);
 
-      store (hash, state);
+      std::unique_ptr<ParsedBlock> block;
+      if (prefetched)
+        {
+          block = prefetcher.Next ();
+          if (!block)
+            return error ("%s: failed to read block from disk", __func__);
+        }
+      else
+        {
+          GameStateDelta delta;
+          if (db.Read (std::make_pair (DB_GAMESTATE_DELTA, cur.hash), delta)
+                && delta.GetPrevHash () == state.hashBlock)
+            {
+              delta.Apply (state);
+              assert (state.hashBlock == cur.hash);
+              ++applied;
+              continue;
+            }
+
+          /* The delta is unusable.  This should not happen, but we can
+             still replay the block (without prefetching it).  */
+          block.reset (new ParsedBlock ());
+          if (!ReadBlockFromDisk (block->block, cur.pos,
+                                  chainparams.GetConsensus ()))
+            return error ("%s: failed to read block from disk", __func__);
+          block->Parse ();
+          if (block->hash != cur.hash)
+            return error ("%s: block on disk does not match index", __func__);
+        }
+      assert (block->hash == cur.hash);
+
+      CValidationState valid;
+      StepResult res;
+      if (!PerformStep (*block, state, NULL, valid, res, stateOut))
+        return error ("%s: failed to perform game step", __func__);
+
+      assert (stateOut.hashBlock == cur.hash);
+      if (cur.keepDelta)
+        storeDelta (GameStateDelta (state, stateOut));
+      state = stateOut;
+      ++replayed;
     }
+  LogPrint (BCLog::GAME, "  applied %u deltas, replayed %u blocks\n",
+            applied, replayed);
 
-  assert (hash == state.hashBlock);
   return true;
 }
 
 void
-CGameDB::store (const uint256& hash, const GameState& state)
+CGameDB::store (const uint256& hash, const GameStateRef& state)
 {
-  assert (hash == state.hashBlock);
   LOCK (cs_cache);
+  insertIntoCache (hash, state);
+  attemptFlush ();
+}
 
-  const GameStateMap::iterator mi = cache.find (hash);
-  if (mi != cache.end ())
+void
+CGameDB::publishTip (const uint256& hash)
+{
+  GameStateRef state;
+  if (!hash.IsNull ())
     {
-      delete mi->second;
-      mi->second = new GameState (Params ().GetConsensus ());
-      *mi->second = state;
+      LOCK (cs_cache);
+      const GameStateMap::const_iterator mi = cache.find (hash);
+      if (mi != cache.end ())
+        state = mi->second.state;
     }
-  else
+
+  std::atomic_store (&tip, state);
+}
+
+void
+CGameDB::insertIntoCache (const uint256& hash, const GameStateRef& state)
+{
+  assert (state && hash == state->hashBlock);
+  AssertLockHeld (cs_cache);
+
+  /* Snapshots that were handed out before remain valid, since we only
+     drop our reference to them.  */
+  const GameStateMap::iterator mi = cache.find (hash);
+  if (mi != cache.end ())
+    eraseFromCache (mi);
+
+  CacheEntry entry;
+  entry.state = state;
+  entry.usage = RecursiveDynamicUsage (*state, false);
+  entry.lastUse = ++useCounter;
+  stateUsage += entry.usage;
+
+  for (const auto& p : state->players)
+    if (++playerRefs[&*p.second] == 1)
+      stateUsage += p.second.DynamicUsage ()
+                      + RecursiveDynamicUsage (*p.second);
+
+  cache.insert (std::make_pair (hash, entry));
+}
+
+void
+CGameDB::eraseFromCache (const GameStateMap::iterator mi)
+{
+  AssertLockHeld (cs_cache);
+
+  const CacheEntry& entry = mi->second;
+  stateUsage -= entry.usage;
+
+  for (const auto& p : entry.state->players)
     {
-      std::unique_ptr<GameState> s(new GameState (Params ().GetConsensus ()));
-      *s = state;
-      cache.insert (std::make_pair (hash, s.release ()));
+      const PlayerRefMap::iterator ri = playerRefs.find (&*p.second);
+      assert (ri != playerRefs.end () && ri->second > 0);
+      if (--ri->second == 0)
+        {
+          stateUsage -= p.second.DynamicUsage ()
+                          + RecursiveDynamicUsage (*p.second);
+          playerRefs.erase (ri);
+        }
     }
 
-  attemptFlush ();
+  cache.erase (mi);
+}
+
+size_t
+CGameDB::cacheUsage () const
+{
+  AssertLockHeld (cs_cache);
+  return stateUsage + memusage::DynamicUsage (cache)
+          + memusage::DynamicUsage (playerRefs);
+}
+
+void
+CGameDB::storeDelta (const GameStateDelta& delta)
+{
+  LOCK (cs_cache);
+  expiredDeltas.erase (delta.GetHash ());
+  if (!db.Write (std::make_pair (DB_GAMESTATE_DELTA, delta.GetHash ()), delta))
+    error ("%s: failed to write game state delta", __func__);
+}
+
+void
+CGameDB::expireDelta (const uint256& hash)
+{
+  LOCK (cs_cache);
+  expiredDeltas.insert (hash);
+}
+
+void
+CGameDB::expireOldDelta (const CBlockIndex& index)
+{
+  const int height = index.nHeight - static_cast<int> (deltaDepth);
+  if (height < 0)
+    return;
+
+  const CBlockIndex* pold = index.GetAncestor (height);
+  assert (pold);
+  expireDelta (pold->GetBlockHash ());
+}
+
+bool
+CGameDB::getDelta (const uint256& hash, GameStateDelta& delta) const
+{
+  return db.Read (std::make_pair (DB_GAMESTATE_DELTA, hash), delta);
 }
 
 void
@@ -181,25 +481,33 @@ CGameDB::flush (bool saveAll)
       keepInMemory.insert (*pindex->phashBlock);
   }
 
-  /* Go through everything and delete or store to disk.  */
-  std::set<uint256> toErase;
+  /* Evict the least recently used states first.  */
+  std::vector<std::pair<uint64_t, uint256>> candidates;
+  for (const auto& entry : cache)
+    if (saveAll || keepInMemory.count (entry.first) == 0)
+      candidates.push_back (std::make_pair (entry.second.lastUse,
+                                            entry.first));
+  std::sort (candidates.begin (), candidates.end ());
+
   CDBBatch batch(db);
   unsigned written = 0, discarded = 0;
-  for (GameStateMap::iterator mi = cache.begin (); mi != cache.end (); ++mi)
+  for (const auto& c : candidates)
     {
-      bool keepThis = (keepInMemory.count (mi->first) > 0);
-      if (!saveAll && keepThis)
-        continue;
+      if (!saveAll && cacheUsage () <= maxCacheUsage)
+        break;
+
+      const GameStateMap::iterator mi = cache.find (c.second);
+      assert (mi != cache.end ());
 
       LOCK (cs_main);
-      bool write = keepThis;
+      bool write = (keepInMemory.count (mi->first) > 0);
 
       /* It can happen that cache contains blocks that are not in mapBlockIndex.
          This is the case if they were added to the cache through ConnectBlock
          called from TestBlockValidity and mining (or testing).  If this is
          not the case and the block is part of mapBlockIndex, we can look
          at the block's height and keep it if the height is divisible
-         by KEEP_EVERY_NTH.  */
+         by keepEveryNth.  */
       const BlockMap::const_iterator bmi = mapBlockIndex.find (mi->first);
       if (!write && bmi != mapBlockIndex.end ())
         {
@@ -210,63 +518,102 @@ CGameDB::flush (bool saveAll)
 
       if (write)
         {
-          batch.Write (std::make_pair (DB_GAMESTATE, mi->first), *mi->second);
+          batch.Write (std::make_pair (DB_GAMESTATE, mi->first),
+                       *mi->second.state);
           ++written;
         }
       else
         ++discarded;
 
-      delete mi->second;
-      toErase.insert (mi->first);
+      eraseFromCache (mi);
     }
-  for (std::set<uint256>::const_iterator i = toErase.begin ();
-       i != toErase.end (); ++i)
-    cache.erase (*i);
   assert (!saveAll || cache.empty ());
   LogPrint (BCLog::GAME, "  wrote %u game states, discarded %u\n",
             written, discarded);
+  LogPrint (BCLog::GAME, "  %u game states in memory, using %.1f MiB\n",
+            cache.size (), cacheUsage () * (1.0 / 1024 / 1024));
+
+  for (const auto& hash : expiredDeltas)
+    batch.Erase (std::make_pair (DB_GAMESTATE_DELTA, hash));
+  LogPrint (BCLog::GAME, "  erasing %u expired deltas\n",
+            expiredDeltas.size ());
+  expiredDeltas.clear ();
 
   /* Purge unwanted elements from the database on disk.  They may have been
      stored due to the last shutdown and now be unwanted due to advancing
-     the chain since then.  */
-  /* TODO: Possibly not do this always.  We could do it for saveAll only,
-     or with an explicit call.  Depends on how long this usually takes.  */
-  discarded = 0;
-  std::unique_ptr<CDBIterator> pcursor(db.NewIterator ());
-  for (pcursor->Seek (DB_GAMESTATE); pcursor->Valid (); pcursor->Next ())
+     the chain since then, or due to a changed -gamesnapshotinterval.  This
+     walks all states on disk, so do it only when shutting down rather than
+     whenever states are evicted.  */
+  if (saveAll)
     {
-      boost::this_thread::interruption_point();
-      char chType;
-      if (!pcursor->GetKey(chType) || chType != DB_GAMESTATE)
-        break;
-
-      std::pair<char, uint256> key;
-      if (!pcursor->GetKey (key) || key.first != DB_GAMESTATE)
+      discarded = 0;
+      std::unique_ptr<CDBIterator> pcursor(db.NewIterator ());
+      for (pcursor->Seek (DB_GAMESTATE); pcursor->Valid (); pcursor->Next ())
         {
-          error ("%s: failed to read game state key", __func__);
-          break;
-        }
-
-      /* Check first if this is in our keep-in-memory list.  If it is
-         and we want to "save all", keep it.  */
-      const bool keepThis = (keepInMemory.count (key.second) > 0);
-      if (saveAll && keepThis)
-        continue;
+          boost::this_thread::interruption_point();
+          char chType;
+          if (!pcursor->GetKey(chType) || chType != DB_GAMESTATE)
+            break;
 
-      /* Otherwise, check for block height condition and delete if
-         this is not a state we want to keep.  */
-      LOCK (cs_main);
-      const BlockMap::const_iterator bmi = mapBlockIndex.find (key.second);
-      assert (bmi != mapBlockIndex.end ());
-      const CBlockIndex* pindex = bmi->second;
-      assert (pindex);
-      if (pindex->nHeight % keepEveryNth != 0)
+          std::pair<char, uint256> key;
+          if (!pcursor->GetKey (key) || key.first != DB_GAMESTATE)
+            {
+              error ("%s: failed to read game state key", __func__);
+              break;
+            }
+
+          /* Check first if this is in our keep-in-memory list.  If it is,
+             keep it.  */
+          if (keepInMemory.count (key.second) > 0)
+            continue;
+
+          /* Otherwise, check for block height condition and delete if
+             this is not a state we want to keep.  */
+          LOCK (cs_main);
+          const BlockMap::const_iterator bmi
+            = mapBlockIndex.find (key.second);
+          assert (bmi != mapBlockIndex.end ());
+          const CBlockIndex* pindex = bmi->second;
+          assert (pindex);
+          if (pindex->nHeight % keepEveryNth != 0)
+            {
+              ++discarded;
+              batch.Erase (key);
+            }
+        }
+      LogPrint (BCLog::GAME, "  pruning %u game states from disk\n",
+                discarded);
+
+      /* Deltas are expired as blocks are disconnected or leave the window,
+         but some may be left over (e. g., from an unclean shutdown or a
+         changed -gamedeltadepth).  Remove those that are not of main-chain
+         blocks within the window whose data we still have.  */
+      discarded = 0;
+      for (pcursor->Seek (DB_GAMESTATE_DELTA); pcursor->Valid ();
+           pcursor->Next ())
         {
-          ++discarded;
-          batch.Erase (key);
+          boost::this_thread::interruption_point();
+          std::pair<char, uint256> key;
+          if (!pcursor->GetKey (key) || key.first != DB_GAMESTATE_DELTA)
+            break;
+
+          LOCK (cs_main);
+          const BlockMap::const_iterator bmi
+            = mapBlockIndex.find (key.second);
+          const CBlockIndex* pindex
+            = (bmi == mapBlockIndex.end () ? nullptr : bmi->second);
+          if (pindex == nullptr || !chainActive.Contains (pindex)
+                || !(pindex->nStatus & BLOCK_HAVE_DATA)
+                || pindex->nHeight + static_cast<int> (deltaDepth)
+                    <= chainActive.Height ())
+            {
+              ++discarded;
+              batch.Erase (key);
+            }
         }
+      LogPrint (BCLog::GAME, "  pruning %u game state deltas from disk\n",
+                discarded);
     }
-  LogPrint (BCLog::GAME, "  pruning %u game states from disk\n", discarded);
 
   /* Finalise by writing the database batch.  */
   const bool ok = db.WriteBatch (batch);
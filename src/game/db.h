@@ -21,8 +21,30 @@
 #include <uint256.h>
 
 #include <map>
+#include <memory>
+#include <set>
+#include <vector>
 
+class CBlockIndex;
 class GameState;
+class GameStateDelta;
+struct PlayerState;
+
+/** Default for -gamestatecache (memory for cached game states in MiB).  */
+static const int64_t DEFAULT_GAME_STATE_CACHE = 100;
+/** Default for -gamedbcache (LevelDB cache of the game database in MiB).  */
+static const int64_t DEFAULT_GAME_DB_CACHE = 25;
+/** Default for -gamesnapshotinterval.  */
+static const int DEFAULT_GAME_SNAPSHOT_INTERVAL = 2000;
+/** Default for -gamedeltadepth.  */
+static const int DEFAULT_GAME_DELTA_DEPTH = 10000;
+
+/**
+ * Immutable game state shared between the game database and its readers.
+ * Since game states never change once computed, snapshots can be handed
+ * out to any number of threads without copying them.
+ */
+typedef std::shared_ptr<const GameState> GameStateRef;
 
 /**
  * Database for caching game states.  Note that each block hash corresponds
@@ -32,16 +54,36 @@ class GameState;
  * UTXO database, which is modified while connecting/disconnecting blocks.
  * Thus it is in its own class and directory, not using the chainstate.
  *
- * The database (on disk) stores the states to every Nth block.  Intermediate
- * steps can be recomputed, but that is costly.  The last few states are kept
- * in memory, so that reorgs can be done efficiently.
+ * The database (on disk) stores the states to every Nth block.  In addition,
+ * the delta to its parent state is stored for the main-chain blocks of the
+ * last -gamedeltadepth heights.  Deltas of blocks that are disconnected,
+ * whose data is pruned or that drop out of that window are erased, so that
+ * their number stays bounded by the window size.  Intermediate states are
+ * reconstructed by applying the deltas to the last full state, or
+ * recomputed (which is costly) if no deltas are available.
+ * Recently used states are kept in memory up to a configured size, so that
+ * reorgs and queries can be done efficiently.  The states of the last few
+ * main-chain blocks are never evicted.
+ *
+ * States are handed out as shared, immutable snapshots.  In addition, the
+ * state of the current chain tip is published whenever the tip changes,
+ * so that readers can get it without locking anything.
  */
 class CGameDB
 {
 
 public:
 
-    explicit CGameDB (bool fMemory, bool fWipe);
+    /**
+     * Open the game database.
+     * @param nDbCache Size of the LevelDB cache in bytes.
+     * @param nStateCache Memory for game states kept in memory in bytes.
+     * @param snapshotInterval Keep the state of every Nth block on disk.
+     * @param nDeltaDepth Keep deltas of the main-chain blocks this many
+     *                    heights below the tip.
+     */
+    CGameDB (size_t nDbCache, size_t nStateCache, unsigned snapshotInterval,
+             unsigned nDeltaDepth, bool fMemory, bool fWipe);
     ~CGameDB ();
 
     /**
@@ -70,7 +112,25 @@ public:
     /**
      * Query for a game state by corresponding block hash.  The block
      * must be present in mapBlockIndex already.  If the game state is not
-     * directly available, it is recomputed as necessary.
+     * directly available, it is recomputed as necessary.  The recomputation
+     * does not hold cs_main (except for copying block index data), and
+     * concurrent requests for the same state share a single computation.
+     * @param hash The block hash to look up.
+     * @return The game state, or null if it could not be found.
+     */
+    GameStateRef getSnapshot (const uint256& hash);
+
+    /**
+     * Get a game state without recomputation, i.e. only if it is held in
+     * memory or stored as full state on disk.  Returns null if the state is
+     * not readily available.  This is meant for callers that must not
+     * block on a replay, like the notification thread.
+     */
+    GameStateRef getFromCache (const uint256& hash) const;
+
+    /**
+     * Query for a game state like getSnapshot, but copy it into the given
+     * object.  This is meant for callers that need a mutable state.
      * @param hash The block hash to look up.
      * @param state Put the game state here.
      * @return True iff successful.
@@ -83,19 +143,79 @@ public:
      * nevertheless, when connecting blocks.  This avoids a duplicate
      * computation.
      */
-    void store (const uint256& hash, const GameState& state);
+    void store (const uint256& hash, const GameStateRef& state);
+
+    /**
+     * Publish the state of the new chain tip.  This is called (with cs_main
+     * held) whenever the tip changes.  Only states in the in-memory cache
+     * are published, so that this never triggers a recomputation.  If the
+     * state is not available, the published tip is cleared instead.
+     * @param hash The new tip's block hash, or null to clear the tip.
+     */
+    void publishTip (const uint256& hash);
+
+    /**
+     * Return the published state of the current chain tip.  This does not
+     * lock cs_main nor the cache.  The result may be null if no state is
+     * published, in which case the caller has to look up the tip's hash
+     * and use getSnapshot instead.
+     */
+    GameStateRef getTip () const
+    {
+      return std::atomic_load (&tip);
+    }
+
+    /**
+     * Store the delta of a game state to its parent permanently.  This is
+     * done when connecting blocks (but not when just checking them), so
+     * that the state can be reconstructed cheaply later on.
+     */
+    void storeDelta (const GameStateDelta& delta);
+
+    /**
+     * Mark the stored delta of a block as no longer needed.  This is done
+     * for disconnected blocks and blocks whose data is pruned.  The delta is
+     * only erased with the next flush, so that notifications about the block
+     * that are still queued can read it.  Storing the delta again (if the
+     * block is reconnected) cancels this.
+     */
+    void expireDelta (const uint256& hash);
+
+    /**
+     * Expire the delta of the block that drops out of the retention window
+     * when the given block is connected.
+     */
+    void expireOldDelta (const CBlockIndex& index);
+
+    /**
+     * Read the stored delta from the parent of the given block to the
+     * block's game state.  Returns false if no delta is stored for it.
+     */
+    bool getDelta (const uint256& hash, GameStateDelta& delta) const;
+
+    /**
+     * Return the estimated memory used by the in-memory game states.
+     * Player states shared between cached game states are counted once.
+     */
+    size_t DynamicMemoryUsage () const
+    {
+      LOCK (cs_cache);
+      return cacheUsage ();
+    }
 
 private:
 
     /** Keep every Nth game state permanently on disk.  */
     unsigned keepEveryNth;
+    /** Keep deltas for this many main-chain blocks below the tip.  */
+    unsigned deltaDepth;
     /** Minimum number of states to keep in memory (the last ones).  */
     unsigned minInMemory;
     /**
-     * Maximum number of states to keep in memory.  If this is reached,
-     * the cache will be flushed back to disk.
+     * Maximum memory (in bytes) used by the states in memory.  If this is
+     * exceeded, the least recently used states are flushed back to disk.
      */
-    unsigned maxInMemory;
+    size_t maxCacheUsage;
 
     /** Temporarily disable flushing at all and keep everything.  */
     bool keepEverything;
@@ -103,17 +223,110 @@ private:
     /** The backing LevelDB.  */
     CDBWrapper db;
 
-    typedef std::map<uint256, GameState*> GameStateMap;
-    /** In-memory store of the last few block states.  */
-    GameStateMap cache;
+    /** A game state held in memory.  */
+    struct CacheEntry
+    {
+      GameStateRef state;
+      /** Memory used by the state, excluding its player states.  */
+      size_t usage;
+      /** Value of useCounter when the state was last requested.  */
+      uint64_t lastUse;
+    };
+
+    typedef std::map<uint256, CacheEntry> GameStateMap;
+    /** In-memory store of recently used block states.  */
+    mutable GameStateMap cache;
+    /** Counter used to order the cache entries by their last use.  */
+    mutable uint64_t useCounter;
+
+    /**
+     * Number of cached states referring to each player state.  Player states
+     * are shared between game states, so this is used to count their memory
+     * only once.
+     */
+    typedef std::map<const PlayerState*, unsigned> PlayerRefMap;
+    PlayerRefMap playerRefs;
+    /** Memory used by cached states and the player states they refer to.  */
+    size_t stateUsage;
+    /** Deltas to be erased from disk with the next flush.  */
+    std::set<uint256> expiredDeltas;
     /** Lock to protect the cache datastructure.  */
     mutable CCriticalSection cs_cache;
 
     /**
-     * Get without recomputation.  Returns false if the state is not
-     * readily available.
+     * The published state of the chain tip.  It is only accessed through
+     * std::atomic_load and std::atomic_store.
+     */
+    GameStateRef tip;
+
+    /** Result of a state computation that is currently in progress.  */
+    struct PendingReplay
+    {
+      /** Set when the computation is finished.  */
+      bool done;
+      /** The computed state, or null if the computation failed.  */
+      GameStateRef result;
+
+      PendingReplay ()
+        : done(false), result()
+      {}
+    };
+
+    typedef std::map<uint256, std::shared_ptr<PendingReplay>> PendingMap;
+    /** Computations currently in progress, by block hash.  */
+    PendingMap pending;
+    /** Lock protecting the pending map and the jobs in it.  */
+    CWaitableCriticalSection cs_pending;
+    /** Signalled when a pending computation is finished.  */
+    CConditionVariable cvPending;
+
+    struct ReplayBlock;
+
+    /**
+     * Find the latest available state on the way to a requested block,
+     * and the blocks that have to be applied to it.  This copies the
+     * necessary data from the block index (holding cs_main only while
+     * doing so).
+     * @param hash The requested block hash.
+     * @param stateIn Set to the available state to start from.
+     * @param needed Set to the blocks to apply (the last one first).
+     * @return False if the block is not known.
      */
-    bool getFromCache (const uint256& hash, GameState& state) const;
+    bool findReplayBase (const uint256& hash, GameState& stateIn,
+                         std::vector<ReplayBlock>& needed) const;
+
+    /**
+     * Advance a game state through the given blocks by applying the stored
+     * deltas or replaying the blocks.  This does not lock cs_main.
+     * @param state The state to start from, updated to the final state.
+     * @param needed The blocks to apply (the last one first).  It is
+     *               emptied in the process.
+     * @return True iff successful.
+     */
+    bool replayBlocks (GameState& state, std::vector<ReplayBlock>& needed);
+
+    /**
+     * Insert a state into the in-memory cache without flushing.
+     */
+    void insertIntoCache (const uint256& hash, const GameStateRef& state);
+
+    /**
+     * Remove an entry from the in-memory cache and update the memory
+     * accounting accordingly.
+     */
+    void eraseFromCache (GameStateMap::iterator mi);
+
+    /** Total memory used by the in-memory cache.  */
+    size_t cacheUsage () const;
+
+    /**
+     * Check whether the in-memory cache is overly full.
+     */
+    bool needsFlush () const
+    {
+      AssertLockHeld (cs_cache);
+      return !keepEverything && cacheUsage () > maxCacheUsage;
+    }
 
     /**
      * Attempt to flush, which flushes if the cache is overly full.
@@ -121,17 +334,20 @@ private:
     void attemptFlush ()
     {
       AssertLockHeld (cs_cache);
-      if (!keepEverything && cache.size () > maxInMemory)
+      if (needsFlush ())
         flush (false);
     }
 
     /**
-     * Flush the in-memory cache to disk.  The minimum in-memory blocks
-     * are kept in memory, and the others are written to disk or discarded
-     * (depending on the keep-every-nth policy).  This also goes through
-     * the on-disk states and removes ones that do not fit the policy.
+     * Flush the in-memory cache to disk.  The least recently used states
+     * (apart from the minimum in-memory blocks) are removed from memory
+     * until the cache fits its size limit again.  They are written to disk
+     * or discarded, depending on the keep-every-nth policy.
+     * Expired deltas are erased in the same batch.
      * @param saveAll Store all in-memory cache to disk.  This is done
-     *                when shutting down the node.
+     *                when shutting down the node.  In this case, the states
+     *                and deltas on disk that do not fit the policy are
+     *                removed as well.
      */
     void flush (bool saveAll);
 
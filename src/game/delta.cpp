@@ -0,0 +1,219 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <game/delta.h>
+
+#include <streams.h>
+#include <version.h>
+
+namespace
+{
+
+/**
+ * Check whether two player states are equal.  If they are shared (which
+ * is the usual case for unchanged players after a game step), this is
+ * trivial.  Otherwise, compare their serialised forms.
+ */
+bool
+SamePlayer (const CowPtr<PlayerState>& a, const CowPtr<PlayerState>& b)
+{
+  if (a.SharesWith (b))
+    return true;
+
+  CDataStream sa(SER_DISK, PROTOCOL_VERSION);
+  CDataStream sb(SER_DISK, PROTOCOL_VERSION);
+  sa << *a;
+  sb << *b;
+
+  return sa.str () == sb.str ();
+}
+
+inline bool
+SameLoot (const LootInfo& a, const LootInfo& b)
+{
+  return a.nAmount == b.nAmount
+          && a.firstBlock == b.firstBlock && a.lastBlock == b.lastBlock;
+}
+
+} // anonymous namespace
+
+GameStateDelta::GameStateDelta (const GameState& from, const GameState& to)
+  : hashPrev(from.hashBlock),
+    dead_players_chat(to.dead_players_chat), banks(to.banks),
+    crownPos(to.crownPos), crownHolder(to.crownHolder),
+    gameFund(to.gameFund), nHeight(to.nHeight),
+    nDisasterHeight(to.nDisasterHeight), hashBlock(to.hashBlock)
+{
+  /* Both player maps are ordered by name, so we can walk them in
+     lockstep to find the differences.  */
+  PlayerStateMap::const_iterator a = from.players.begin ();
+  PlayerStateMap::const_iterator b = to.players.begin ();
+  while (a != from.players.end () || b != to.players.end ())
+    {
+      if (b == to.players.end ()
+            || (a != from.players.end () && a->first < b->first))
+        {
+          playersRemoved.insert (a->first);
+          ++a;
+          continue;
+        }
+
+      if (a == from.players.end () || b->first < a->first)
+        {
+          playersChanged.insert (std::make_pair (b->first, *b->second));
+          ++b;
+          continue;
+        }
+
+      assert (a->first == b->first);
+      if (!SamePlayer (a->second, b->second))
+        playersChanged.insert (std::make_pair (b->first, *b->second));
+      ++a;
+      ++b;
+    }
+
+  for (const auto& l : from.loot)
+    if (to.loot.count (l.first) == 0)
+      lootRemoved.insert (l.first);
+  for (const auto& l : to.loot)
+    {
+      const std::map<Coord, LootInfo>::const_iterator mi
+        = from.loot.find (l.first);
+      if (mi == from.loot.end () || !SameLoot (mi->second, l.second))
+        lootChanged.insert (l);
+    }
+
+  for (const auto& h : from.hearts)
+    if (to.hearts.count (h) == 0)
+      heartsRemoved.insert (h);
+  for (const auto& h : to.hearts)
+    if (from.hearts.count (h) == 0)
+      heartsAdded.insert (h);
+}
+
+void
+GameStateDelta::Apply (GameState& state) const
+{
+  assert (state.hashBlock == hashPrev);
+
+  /* The coin totals are updated along the way.  */
+  CoinTotals& totals = state.coinTotals;
+
+  for (const auto& p : playersRemoved)
+    {
+      const PlayerStateMap::iterator mi = state.players.find (p);
+      assert (mi != state.players.end ());
+      totals.AddPlayer (*mi->second, -1);
+      state.players.erase (mi);
+    }
+  for (const auto& p : playersChanged)
+    {
+      const PlayerStateMap::iterator mi = state.players.find (p.first);
+      if (mi != state.players.end ())
+        {
+          totals.AddPlayer (*mi->second, -1);
+          mi->second = CowPtr<PlayerState> (p.second);
+        }
+      else
+        state.players.emplace (p.first, CowPtr<PlayerState> (p.second));
+      totals.AddPlayer (p.second);
+    }
+
+  for (const auto& c : lootRemoved)
+    {
+      const std::map<Coord, LootInfo>::iterator mi = state.loot.find (c);
+      assert (mi != state.loot.end ());
+      totals.lootOnMap -= mi->second.nAmount;
+      state.loot.erase (mi);
+    }
+  for (const auto& l : lootChanged)
+    {
+      LootInfo& entry = state.loot[l.first];
+      totals.lootOnMap += l.second.nAmount - entry.nAmount;
+      entry = l.second;
+    }
+
+  for (const auto& c : heartsRemoved)
+    {
+      assert (state.hearts.count (c) > 0);
+      state.hearts.erase (c);
+    }
+  state.hearts.insert (heartsAdded.begin (), heartsAdded.end ());
+
+  state.dead_players_chat = dead_players_chat;
+  state.banks = banks;
+  state.crownPos = crownPos;
+  state.crownHolder = crownHolder;
+  state.gameFund = gameFund;
+  state.nHeight = nHeight;
+  state.nDisasterHeight = nDisasterHeight;
+  state.hashBlock = hashBlock;
+}
+
+GameStateDelta
+GameStateDelta::Invert (const GameState& prev) const
+{
+  assert (prev.hashBlock == hashPrev);
+
+  GameStateDelta res;
+  res.hashPrev = hashBlock;
+
+  /* Players changed by this delta are restored to their old state if they
+     existed before, and removed otherwise.  Removed players come back.  */
+  for (const auto& p : playersChanged)
+    {
+      const PlayerStateMap::const_iterator mi = prev.players.find (p.first);
+      if (mi != prev.players.end ())
+        res.playersChanged.insert (std::make_pair (p.first, *mi->second));
+      else
+        res.playersRemoved.insert (p.first);
+    }
+  for (const auto& p : playersRemoved)
+    {
+      const PlayerStateMap::const_iterator mi = prev.players.find (p);
+      assert (mi != prev.players.end ());
+      res.playersChanged.insert (std::make_pair (p, *mi->second));
+    }
+
+  for (const auto& l : lootChanged)
+    {
+      const std::map<Coord, LootInfo>::const_iterator mi
+        = prev.loot.find (l.first);
+      if (mi != prev.loot.end ())
+        res.lootChanged.insert (*mi);
+      else
+        res.lootRemoved.insert (l.first);
+    }
+  for (const auto& c : lootRemoved)
+    {
+      const std::map<Coord, LootInfo>::const_iterator mi = prev.loot.find (c);
+      assert (mi != prev.loot.end ());
+      res.lootChanged.insert (*mi);
+    }
+
+  res.heartsAdded = heartsRemoved;
+  res.heartsRemoved = heartsAdded;
+
+  res.dead_players_chat = prev.dead_players_chat;
+  res.banks = prev.banks;
+  res.crownPos = prev.crownPos;
+  res.crownHolder = prev.crownHolder;
+  res.gameFund = prev.gameFund;
+  res.nHeight = prev.nHeight;
+  res.nDisasterHeight = prev.nDisasterHeight;
+  res.hashBlock = prev.hashBlock;
+
+  return res;
+}
@@ -0,0 +1,140 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GAME_DELTA_H
+#define GAME_DELTA_H
+
+#include <amount.h>
+#include <game/common.h>
+#include <game/state.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <map>
+#include <set>
+
+/**
+ * The difference between the game states of a block and its parent.
+ * It stores the full new state of all players that were added or changed
+ * in the step, the names of removed players, and the changes to the loot
+ * and hearts on the map.  The remaining (small) parts of the state are
+ * stored in full.
+ *
+ * Deltas are stored in the game DB for every connected block, so that
+ * game states that are not kept as full snapshots can be reconstructed
+ * by applying deltas to the last snapshot instead of re-running the
+ * game steps.
+ */
+class GameStateDelta
+{
+
+private:
+
+  /** Block hash of the game state this delta is based on.  */
+  uint256 hashPrev;
+
+  /** New states of players that were spawned or changed.  */
+  std::map<PlayerID, PlayerState> playersChanged;
+  /** Players no longer in the state.  */
+  std::set<PlayerID> playersRemoved;
+
+  /** Loot tiles that were added or changed.  */
+  std::map<Coord, LootInfo> lootChanged;
+  /** Loot tiles that were emptied.  */
+  std::set<Coord> lootRemoved;
+
+  /** Hearts dropped onto the map.  */
+  std::set<Coord> heartsAdded;
+  /** Hearts collected or removed.  */
+  std::set<Coord> heartsRemoved;
+
+  /* The remaining parts of the state are stored in full.  */
+  std::map<PlayerID, PlayerState> dead_players_chat;
+  std::map<Coord, unsigned> banks;
+  Coord crownPos;
+  CharacterID crownHolder;
+  CAmount gameFund;
+  int nHeight;
+  int nDisasterHeight;
+  uint256 hashBlock;
+
+public:
+
+  GameStateDelta ()
+    : crownPos(), gameFund(0), nHeight(-1), nDisasterHeight(-1)
+  {}
+
+  /**
+   * Construct the delta from one game state to the next.
+   * @param from The parent state.
+   * @param to The new state.
+   */
+  GameStateDelta (const GameState& from, const GameState& to);
+
+  ADD_SERIALIZE_METHODS;
+
+  template<typename Stream, typename Operation>
+    inline void SerializationOp (Stream& s, Operation ser_action)
+  {
+    READWRITE (hashPrev);
+    READWRITE (playersChanged);
+    READWRITE (playersRemoved);
+    READWRITE (lootChanged);
+    READWRITE (lootRemoved);
+    READWRITE (heartsAdded);
+    READWRITE (heartsRemoved);
+    READWRITE (dead_players_chat);
+    READWRITE (banks);
+    READWRITE (crownPos);
+    READWRITE (crownHolder.player);
+    if (!crownHolder.player.empty ())
+      READWRITE (crownHolder.index);
+    READWRITE (gameFund);
+    READWRITE (nHeight);
+    READWRITE (nDisasterHeight);
+    READWRITE (hashBlock);
+  }
+
+  inline const uint256&
+  GetPrevHash () const
+  {
+    return hashPrev;
+  }
+
+  inline const uint256&
+  GetHash () const
+  {
+    return hashBlock;
+  }
+
+  /**
+   * Apply the delta to the given state, which must be the state the
+   * delta is based on.  Afterwards, it is the new state.
+   * @param state The state to update.
+   */
+  void Apply (GameState& state) const;
+
+  /**
+   * Construct the delta that undoes this one, i.e. leads from the delta's
+   * new state back to the state it is based on.  Only the entries touched
+   * by this delta are looked up in the old state, so this is cheap.
+   * @param prev The state this delta is based on.
+   * @return The inverse delta.
+   */
+  GameStateDelta Invert (const GameState& prev) const;
+
+};
+
+#endif // GAME_DELTA_H
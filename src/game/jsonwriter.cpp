@@ -0,0 +1,160 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <game/jsonwriter.h>
+
+#include <cassert>
+#include <cinttypes>
+#include <cstdio>
+
+void
+JsonWriter::BeginValue ()
+{
+  if (afterKey)
+    {
+      afterKey = false;
+      return;
+    }
+
+  if (nonEmpty.empty ())
+    return;
+
+  if (nonEmpty.back ())
+    out += ',';
+  nonEmpty.back () = true;
+}
+
+void
+JsonWriter::WriteEscaped (const std::string& str)
+{
+  out += '"';
+  for (const char c : str)
+    {
+      const unsigned char ch = c;
+      switch (ch)
+        {
+        case '"':
+          out += "\\\"";
+          break;
+        case '\\':
+          out += "\\\\";
+          break;
+        case '\b':
+          out += "\\b";
+          break;
+        case '\f':
+          out += "\\f";
+          break;
+        case '\n':
+          out += "\\n";
+          break;
+        case '\r':
+          out += "\\r";
+          break;
+        case '\t':
+          out += "\\t";
+          break;
+        default:
+          if (ch < 0x20 || ch == 0x7f)
+            {
+              char buf[8];
+              snprintf (buf, sizeof (buf), "\\u%04x", ch);
+              out += buf;
+            }
+          else
+            out += c;
+          break;
+        }
+    }
+  out += '"';
+}
+
+void
+JsonWriter::BeginObject ()
+{
+  BeginValue ();
+  out += '{';
+  nonEmpty.push_back (false);
+}
+
+void
+JsonWriter::EndObject ()
+{
+  assert (!nonEmpty.empty () && !afterKey);
+  nonEmpty.pop_back ();
+  out += '}';
+}
+
+void
+JsonWriter::BeginArray ()
+{
+  BeginValue ();
+  out += '[';
+  nonEmpty.push_back (false);
+}
+
+void
+JsonWriter::EndArray ()
+{
+  assert (!nonEmpty.empty () && !afterKey);
+  nonEmpty.pop_back ();
+  out += ']';
+}
+
+void
+JsonWriter::Key (const std::string& key)
+{
+  assert (!afterKey);
+  BeginValue ();
+  WriteEscaped (key);
+  out += ':';
+  afterKey = true;
+}
+
+void
+JsonWriter::Int (const int64_t val)
+{
+  BeginValue ();
+  char buf[32];
+  snprintf (buf, sizeof (buf), "%" PRId64, val);
+  out += buf;
+}
+
+void
+JsonWriter::Bool (const bool val)
+{
+  BeginValue ();
+  out += (val ? "true" : "false");
+}
+
+void
+JsonWriter::String (const std::string& val)
+{
+  BeginValue ();
+  WriteEscaped (val);
+}
+
+void
+JsonWriter::Amount (const CAmount val)
+{
+  BeginValue ();
+
+  const bool sign = val < 0;
+  const int64_t abs = (sign ? -val : val);
+  char buf[64];
+  snprintf (buf, sizeof (buf), "%s%" PRId64 ".%08" PRId64,
+            sign ? "-" : "", abs / COIN, abs % COIN);
+  out += buf;
+}
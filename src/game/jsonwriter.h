@@ -0,0 +1,92 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GAME_JSONWRITER_H
+#define GAME_JSONWRITER_H
+
+#include <amount.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Streaming writer for JSON.  The output is appended directly to a string,
+ * without building up a UniValue tree first.  This is used for dumping
+ * (potentially large) game states.  The format is the same as produced by
+ * UniValue::write without indentation, including the escaping of strings
+ * and the formatting of amounts (as by ValueFromAmount).
+ *
+ * The caller is responsible for producing well-formed JSON, i. e., for
+ * matching Begin/End calls and for calling Key before each value inside
+ * of objects.  This is only checked by assertions.
+ */
+class JsonWriter
+{
+
+private:
+
+  /** The output string.  */
+  std::string& out;
+
+  /**
+   * For each open object or array, whether or not it already contains
+   * an element (so that a separator is needed before the next one).
+   */
+  std::vector<bool> nonEmpty;
+
+  /** Set if a key has been written and the value has to follow.  */
+  bool afterKey;
+
+  /** Write a separator before the next value if necessary.  */
+  void BeginValue ();
+
+  /** Write a string literal with escaping.  */
+  void WriteEscaped (const std::string& str);
+
+public:
+
+  explicit inline JsonWriter (std::string& o)
+    : out(o), nonEmpty(), afterKey(false)
+  {}
+
+  JsonWriter (const JsonWriter&) = delete;
+  void operator= (const JsonWriter&) = delete;
+
+  void BeginObject ();
+  void EndObject ();
+  void BeginArray ();
+  void EndArray ();
+
+  /** Write the key of the next value in an object.  */
+  void Key (const std::string& key);
+
+  void Int (int64_t val);
+  void Bool (bool val);
+  void String (const std::string& val);
+
+  /** Write a coin amount in the format of ValueFromAmount.  */
+  void Amount (CAmount val);
+
+  /** Check that all objects and arrays have been closed.  */
+  inline bool
+  IsComplete () const
+  {
+    return nonEmpty.empty () && !afterKey;
+  }
+
+};
+
+#endif // GAME_JSONWRITER_H
@@ -19,6 +19,9 @@
 #include <boost/foreach.hpp>
 #include <boost/xpressive/xpressive_dynamic.hpp>
 
+#include <algorithm>
+#include <limits>
+
 /* Maximum number of waypoints per character.  */
 static const int MAX_WAYPOINTS = 100;
 
@@ -43,7 +46,7 @@ bool Move::IsValid(const GameState &state) const
     {
       if (IsSpawn ())
         return false;
-      oldLocked = mi->second.lockedCoins;
+      oldLocked = mi->second->lockedCoins;
     }
 
   assert (oldLocked >= 0 && newLocked >= 0);
@@ -57,7 +60,7 @@ bool Move::IsValid(const GameState &state) const
   return true;
 }
 
-bool ParseWaypoints(UniValue& obj, std::vector<Coord>& result, bool& bWaypoints)
+bool ParseWaypoints(UniValue& obj, WaypointVector& result, bool& bWaypoints)
 {
     bWaypoints = false;
     result.clear();
@@ -108,7 +111,7 @@ IsValidReceiveAddress (const std::string& str)
   return IsKeyDestination (dest);
 }
 
-bool Move::Parse(const PlayerID &p, const std::string &json)
+bool Move::ParseWithUniValue(const PlayerID &p, const std::string &json)
 {
     try
     {
@@ -163,7 +166,7 @@ bool Move::Parse(const PlayerID &p, const std::string &json)
         if (!v.isObject ())
             return false;
         bool bWaypoints = false;
-        std::vector<Coord> wp;
+        WaypointVector wp;
         if (!ParseWaypoints(v, wp, bWaypoints))
             return false;
         bool bDestruct;
@@ -189,9 +192,485 @@ bool Move::Parse(const PlayerID &p, const std::string &json)
     }
 }
 
+bool Move::operator==(const Move &that) const
+{
+    return player == that.player && newLocked == that.newLocked
+            && message == that.message && address == that.address
+            && addressLock == that.addressLock && color == that.color
+            && waypoints == that.waypoints && destruct == that.destruct;
+}
+
+namespace
+{
+
+/**
+ * Parser for the JSON values of moves.  It only understands the (small)
+ * grammar of moves and writes the result directly into a Move, instead of
+ * building a UniValue tree first.  It must accept and reject exactly the
+ * same values as Move::ParseWithUniValue, which means replicating the
+ * non-strict mode of UniValue::read:
+ *
+ *  - integers may have leading zeros,
+ *  - strings may contain raw control characters and invalid UTF-8, and
+ *    the non-standard escape \' is allowed,
+ *  - anything following the top-level object is ignored.
+ */
+class MoveParser
+{
+
+private:
+
+  const char* cur;
+  const char* const end;
+
+  /** Skip JSON whitespace.  */
+  void
+  SkipSpace ()
+  {
+    while (cur < end && (*cur == ' ' || *cur == '\t'
+                         || *cur == '\n' || *cur == '\r'))
+      ++cur;
+  }
+
+  /** Skip whitespace and consume the given character if it is next.  */
+  bool
+  Consume (const char c)
+  {
+    SkipSpace ();
+    if (cur >= end || *cur != c)
+      return false;
+    ++cur;
+    return true;
+  }
+
+  /**
+   * Consume the separator after an element of an object or array.  Sets
+   * done if it was the closing character.
+   */
+  bool
+  Separator (const char close, bool& done)
+  {
+    SkipSpace ();
+    if (cur >= end)
+      return false;
+    if (*cur == ',')
+      done = false;
+    else if (*cur == close)
+      done = true;
+    else
+      return false;
+    ++cur;
+    return true;
+  }
+
+  /** Append a code point as UTF-8.  */
+  static void
+  AppendCodePoint (const unsigned cp, std::string& out)
+  {
+    if (cp <= 0x7f)
+      out.push_back (static_cast<char> (cp));
+    else if (cp <= 0x7ff)
+      {
+        out.push_back (static_cast<char> (0xc0 | (cp >> 6)));
+        out.push_back (static_cast<char> (0x80 | (cp & 0x3f)));
+      }
+    else if (cp <= 0xffff)
+      {
+        out.push_back (static_cast<char> (0xe0 | (cp >> 12)));
+        out.push_back (static_cast<char> (0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back (static_cast<char> (0x80 | (cp & 0x3f)));
+      }
+    else
+      {
+        out.push_back (static_cast<char> (0xf0 | (cp >> 18)));
+        out.push_back (static_cast<char> (0x80 | ((cp >> 12) & 0x3f)));
+        out.push_back (static_cast<char> (0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back (static_cast<char> (0x80 | (cp & 0x3f)));
+      }
+  }
+
+  static int
+  HexDigit (const char c)
+  {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  }
+
+  /**
+   * Parse a string (which must be next) and decode it into out.
+   * \u escapes are decoded like UniValue's UTF-8 filter does it:  A high
+   * surrogate is kept until a low surrogate follows, and other \u escapes
+   * (but not raw characters) are dropped while it is pending.
+   */
+  bool
+  String (std::string& out)
+  {
+    if (!Consume ('"'))
+      return false;
+
+    out.clear ();
+    unsigned surrogate = 0;
+    while (true)
+      {
+        if (cur >= end)
+          return false;
+
+        const char c = *cur++;
+        if (c == '"')
+          return true;
+        if (c != '\\')
+          {
+            out.push_back (c);
+            continue;
+          }
+
+        if (cur >= end)
+          return false;
+        switch (*cur)
+          {
+          case '"':
+          case '\\':
+          case '/':
+          case '\'':
+            out.push_back (*cur);
+            break;
+          case 'b':
+            out.push_back ('\b');
+            break;
+          case 'f':
+            out.push_back ('\f');
+            break;
+          case 'n':
+            out.push_back ('\n');
+            break;
+          case 'r':
+            out.push_back ('\r');
+            break;
+          case 't':
+            out.push_back ('\t');
+            break;
+
+          case 'u':
+            {
+              /* UniValue requires at least one more character after
+                 the four hex digits.  */
+              if (end - cur <= 5)
+                return false;
+              unsigned cp = 0;
+              for (int i = 1; i <= 4; ++i)
+                {
+                  const int d = HexDigit (cur[i]);
+                  if (d < 0)
+                    return false;
+                  cp = (cp << 4) | d;
+                }
+              cur += 4;
+
+              if (cp >= 0xd800 && cp < 0xdc00)
+                {
+                  if (surrogate == 0)
+                    surrogate = cp;
+                }
+              else if (cp >= 0xdc00 && cp < 0xe000)
+                {
+                  if (surrogate != 0)
+                    {
+                      AppendCodePoint (0x10000 | ((surrogate - 0xd800) << 10)
+                                         | (cp - 0xdc00), out);
+                      surrogate = 0;
+                    }
+                }
+              else if (surrogate == 0)
+                AppendCodePoint (cp, out);
+              break;
+            }
+
+          default:
+            return false;
+          }
+        ++cur;
+      }
+  }
+
+  /**
+   * Parse an integer the way UniValue::get_int accepts it:  No fraction
+   * or exponent, and in the range of int32_t.
+   */
+  bool
+  Int (int& out)
+  {
+    SkipSpace ();
+    bool negative = false;
+    if (cur < end && *cur == '-')
+      {
+        negative = true;
+        ++cur;
+      }
+    if (cur >= end || *cur < '0' || *cur > '9')
+      return false;
+
+    const int64_t limit = static_cast<int64_t> (1) << 31;
+    int64_t value = 0;
+    for (; cur < end && *cur >= '0' && *cur <= '9'; ++cur)
+      {
+        value = 10 * value + (*cur - '0');
+        if (value > limit)
+          return false;
+      }
+    if (cur < end && (*cur == '.' || *cur == 'e' || *cur == 'E'))
+      return false;
+
+    if (negative)
+      value = -value;
+    if (value >= limit)
+      return false;
+
+    out = static_cast<int> (value);
+    return true;
+  }
+
+  /** Parse a boolean literal.  */
+  bool
+  Bool (bool& out)
+  {
+    SkipSpace ();
+    if (end - cur >= 4 && std::equal (cur, cur + 4, "true"))
+      {
+        cur += 4;
+        out = true;
+        return true;
+      }
+    if (end - cur >= 5 && std::equal (cur, cur + 5, "false"))
+      {
+        cur += 5;
+        out = false;
+        return true;
+      }
+    return false;
+  }
+
+  /**
+   * Parse the waypoints array.  They are stored reversed, for easier
+   * deletion of the current waypoint from the end of the vector.
+   */
+  bool
+  Waypoints (WaypointVector& result)
+  {
+    if (!Consume ('['))
+      return false;
+
+    result.clear ();
+    SkipSpace ();
+    if (cur < end && *cur == ']')
+      {
+        ++cur;
+        return true;
+      }
+
+    bool done = false;
+    while (!done)
+      {
+        int x, y;
+        if (!Int (x) || !Consume (',') || !Int (y) || !Separator (']', done))
+          return false;
+        if (result.size () >= static_cast<unsigned> (MAX_WAYPOINTS)
+              || !IsInsideMap (x, y))
+          return false;
+
+        const Coord c(x, y);
+        if (!result.empty () && result.back () == c)
+          return false;
+        result.push_back (c);
+      }
+
+    std::reverse (result.begin (), result.end ());
+    return true;
+  }
+
+  /** Parse the object with the move of a character.  */
+  bool
+  Character (const int index, Move& m, std::string& key)
+  {
+    if (!Consume ('{'))
+      return false;
+
+    bool haveWaypoints = false;
+    bool haveDestruct = false;
+    WaypointVector wp;
+    bool destruct = false;
+
+    SkipSpace ();
+    bool done = (cur < end && *cur == '}');
+    if (done)
+      ++cur;
+    while (!done)
+      {
+        if (!String (key) || !Consume (':'))
+          return false;
+
+        if (key == "wp")
+          {
+            if (haveWaypoints || !Waypoints (wp))
+              return false;
+            haveWaypoints = true;
+          }
+        else if (key == "destruct")
+          {
+            if (haveDestruct || !Bool (destruct))
+              return false;
+            haveDestruct = true;
+          }
+        else
+          return false;
+
+        if (!Separator ('}', done))
+          return false;
+      }
+
+    if (destruct)
+      m.destruct.insert (index);
+    if (haveWaypoints)
+      m.waypoints.insert (std::make_pair (index, wp));
+
+    return true;
+  }
+
+  /**
+   * Parse a character index.  It must be formatted as non-negative
+   * integer without leading zeros, and fit into an int.
+   */
+  static bool
+  CharacterIndex (const std::string& key, int& index)
+  {
+    if (key.empty () || key.size () > 10 || (key[0] == '0' && key.size () > 1))
+      return false;
+
+    int64_t value = 0;
+    for (const char c : key)
+      {
+        if (c < '0' || c > '9')
+          return false;
+        value = 10 * value + (c - '0');
+      }
+    if (value > std::numeric_limits<int>::max ())
+      return false;
+
+    index = static_cast<int> (value);
+    return true;
+  }
+
+  /** Parse an address field.  */
+  bool
+  Address (boost::optional<std::string>& out)
+  {
+    out = std::string ();
+    return String (*out) && (out->empty () || IsValidReceiveAddress (*out));
+  }
+
+public:
+
+  explicit MoveParser (const std::string& json)
+    : cur(json.data ()), end(json.data () + json.size ())
+  {}
+
+  /** Parse the JSON into the move.  */
+  bool
+  Parse (Move& m)
+  {
+    if (!Consume ('{'))
+      return false;
+
+    bool haveMsg = false;
+    bool haveAddress = false;
+    bool haveAddressLock = false;
+    bool haveColor = false;
+    std::set<int> indices;
+
+    std::string key;
+    SkipSpace ();
+    bool done = (cur < end && *cur == '}');
+    if (done)
+      ++cur;
+    while (!done)
+      {
+        if (!String (key) || !Consume (':'))
+          return false;
+
+        if (key == "msg")
+          {
+            if (haveMsg)
+              return false;
+            haveMsg = true;
+            m.message = std::string ();
+            if (!String (*m.message))
+              return false;
+          }
+        else if (key == "address")
+          {
+            if (haveAddress || !Address (m.address))
+              return false;
+            haveAddress = true;
+          }
+        else if (key == "addressLock")
+          {
+            if (haveAddressLock || !Address (m.addressLock))
+              return false;
+            haveAddressLock = true;
+          }
+        else if (key == "color")
+          {
+            /* A spawn move must not contain character moves.  */
+            int color;
+            if (haveColor || !indices.empty () || !Int (color))
+              return false;
+            haveColor = true;
+            m.color = static_cast<unsigned char> (color);
+            if (m.color >= NUM_TEAM_COLORS)
+              return false;
+          }
+        else
+          {
+            int index;
+            if (haveColor || !CharacterIndex (key, index)
+                  || !indices.insert (index).second
+                  || !Character (index, m, key))
+              return false;
+          }
+
+        if (!Separator ('}', done))
+          return false;
+      }
+
+    /* Anything after the object is ignored, as UniValue::read does in
+       non-strict mode.  */
+    return true;
+  }
+
+};
+
+} // anonymous namespace
+
+bool Move::Parse(const PlayerID &p, const std::string &json)
+{
+    if (!IsValidPlayerName(p))
+        return false;
+
+    MoveParser parser(json);
+    if (!parser.Parse(*this))
+        return false;
+
+    player = p;
+    return true;
+}
+
 void Move::ApplyCommon(GameState &state) const
 {
-    std::map<PlayerID, PlayerState>::iterator mi = state.players.find(player);
+    PlayerStateMap::iterator mi = state.players.find(player);
 
     if (mi == state.players.end())
     {
@@ -204,7 +683,10 @@ void Move::ApplyCommon(GameState &state) const
         return;
     }
 
-    PlayerState &pl = mi->second;
+    if (!message && !address && !addressLock)
+        return;
+
+    PlayerState &pl = mi->second.Modify();
     if (message)
     {
         pl.message = *message;
@@ -225,7 +707,7 @@ std::string Move::AddressOperationPermission(const GameState &state) const
     if (mi == state.players.end())
         return std::string();      // Spawn move - allow any address operation
 
-    return mi->second.addressLock;
+    return mi->second->addressLock;
 }
 
 void
@@ -262,24 +744,26 @@ Move::ApplySpawn (GameState &state, RandomGenerator &rnd) const
   for (unsigned i = 0; i < limit; i++)
     pl.SpawnCharacter (state, rnd);
 
-  state.players.insert (std::make_pair (player, pl));
+  state.coinTotals.AddPlayer (pl);
+  state.players.insert (std::make_pair (player, CowPtr<PlayerState> (pl)));
 }
 
 void Move::ApplyWaypoints(GameState &state) const
 {
-    std::map<PlayerID, PlayerState>::iterator pl;
+    PlayerStateMap::iterator pl;
     pl = state.players.find (player);
-    if (pl == state.players.end ())
+    if (pl == state.players.end () || waypoints.empty ())
       return;
 
+    CharacterMap& characters = pl->second.Modify ().characters;
     for (const auto& p : waypoints)
     {
-        std::map<int, CharacterState>::iterator mi;
-        mi = pl->second.characters.find(p.first);
-        if (mi == pl->second.characters.end())
+        CharacterMap::iterator mi;
+        mi = characters.find(p.first);
+        if (mi == characters.end())
             continue;
         CharacterState &ch = mi->second;
-        const std::vector<Coord> &wp = p.second;
+        const WaypointVector &wp = p.second;
 
         if (ch.waypoints.empty() || wp.empty() || ch.waypoints.back() != wp.back())
             ch.from = ch.coord;
@@ -340,49 +824,73 @@ StepData::StepData (const GameState& s)
   nTreasureAmount = nSubsidy * 9;
 }
 
+void
+StepData::ParseMoves (const CTransaction& tx, std::vector<ParsedMove>& moves)
+{
+  moves.clear ();
+  if (!tx.IsNamecoin ())
+    return;
+
+  for (const auto& txo : tx.vout)
+    {
+      const CNameScript nameOp(txo.scriptPubKey);
+      if (!nameOp.isNameOp () || !nameOp.isAnyUpdate ())
+        continue;
+
+      moves.push_back (ParsedMove ());
+      ParsedMove& pm = moves.back ();
+      pm.name = ValtypeToString (nameOp.getOpName ());
+      pm.value = ValtypeToString (nameOp.getOpValue ());
+      pm.firstUpdate = (nameOp.getNameOp () == OP_NAME_FIRSTUPDATE);
+
+      pm.move.newLocked = txo.nValue;
+      pm.parsed = pm.move.Parse (pm.name, pm.value);
+    }
+}
+
 bool
 StepData::addTransaction (const CTransaction& tx, const CCoinsView* pview,
                           CValidationState& res)
 {
-  if (!tx.IsNamecoin ())
-    return true;
+  std::vector<ParsedMove> moves;
+  ParseMoves (tx, moves);
 
+  return addParsedTransaction (tx, moves, pview, res);
+}
+
+bool
+StepData::addParsedTransaction (const CTransaction& tx,
+                                const std::vector<ParsedMove>& moves,
+                                const CCoinsView* pview,
+                                CValidationState& res)
+{
   /* Keep the moves to add to the step data here first.  This is necessary
      to prevent a situation where some moves are added already but the
      function fails later with an error.  */
   std::vector<Move> newMoves;
 
-  for (const auto& txo : tx.vout)
+  for (const auto& pm : moves)
     {
-      const CNameScript nameOp(txo.scriptPubKey);
-      if (!nameOp.isNameOp () || !nameOp.isAnyUpdate ())
-        continue;
-
-      const std::string strName = ValtypeToString (nameOp.getOpName ());
-      const std::string strValue = ValtypeToString (nameOp.getOpValue ());
-
-      if (dup.count (strName))
+      if (dup.count (pm.name))
         return res.Invalid (error ("%s: duplicate name '%s' in block",
-                                   __func__, strName.c_str ()));
-      dup.insert (strName);
-
-      Move m;
-      m.newLocked = txo.nValue;
+                                   __func__, pm.name.c_str ()));
+      dup.insert (pm.name);
 
-      if (!m.Parse (strName, strValue))
+      const Move& m = pm.move;
+      if (!pm.parsed)
         return res.Invalid (error ("%s: cannot parse move %s",
-                                   __func__, strValue.c_str ()));
+                                   __func__, pm.value.c_str ()));
       if (!m.IsValid (state))
         return res.Invalid (error ("%s: invalid move for player %s",
-                                   __func__, strName.c_str ()));
+                                   __func__, pm.name.c_str ()));
 
       if (m.IsSpawn ())
         {
-          if (nameOp.getNameOp () != OP_NAME_FIRSTUPDATE)
+          if (!pm.firstUpdate)
             return res.Invalid (error ("%s: spawn is not firstupdate",
                                        __func__));
         }
-      else if (nameOp.getNameOp () != OP_NAME_UPDATE)
+      else if (pm.firstUpdate)
         return res.Invalid (error ("%s: firstupdate is not spawn"));
 
       const std::string addressLock = m.AddressOperationPermission (state);
@@ -420,6 +928,19 @@ StepData::addTransaction (const CTransaction& tx, const CCoinsView* pview,
   return true;
 }
 
+/* ************************************************************************** */
+/* ParsedBlock.  */
+
+void
+ParsedBlock::Parse ()
+{
+  hash = block.GetHash ();
+
+  moves.resize (block.vtx.size ());
+  for (size_t i = 0; i < block.vtx.size (); ++i)
+    StepData::ParseMoves (*block.vtx[i], moves[i]);
+}
+
 /* ************************************************************************** */
 
 bool
@@ -439,3 +960,26 @@ PerformStep (const CBlock& block, const GameState& stateIn,
 
   return true;
 }
+
+bool
+PerformStep (const ParsedBlock& block, const GameState& stateIn,
+             const CCoinsView* pview, CValidationState& valid,
+             StepResult& res, GameState& stateOut)
+{
+  assert (block.moves.size () == block.block.vtx.size ());
+
+  StepData step(stateIn);
+  for (size_t i = 0; i < block.block.vtx.size (); ++i)
+    {
+      const CTransaction& tx = *block.block.vtx[i];
+      if (!step.addParsedTransaction (tx, block.moves[i], pview, valid))
+        return error ("%s: tx %s not accepted",
+                      __func__, tx.GetHash ().GetHex ().c_str());
+    }
+  step.newHash = block.hash;
+
+  if (!PerformStep (stateIn, step, stateOut, res))
+    return error ("%s: game engine failed to perform step", __func__);
+
+  return true;
+}
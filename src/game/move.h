@@ -4,6 +4,7 @@
 #include <amount.h>
 #include <game/common.h>
 #include <consensus/params.h>
+#include <primitives/block.h>
 #include <uint256.h>
 
 #include <univalue.h>
@@ -14,7 +15,6 @@
 #include <string>
 #include <vector>
 
-class CBlock;
 class CCoinsView;
 class CGameDB;
 class CTransaction;
@@ -55,6 +55,17 @@ struct Move
     // Move must be empty before Parse and cannot be reused after Parse
     bool Parse(const PlayerID &player, const std::string &json);
 
+    /**
+     * Parse the move by reading the JSON into a UniValue first.  This is
+     * how moves were parsed before Parse got its own parser, and it accepts
+     * and rejects exactly the same values.  It is kept as reference for
+     * testing the parser.
+     */
+    bool ParseWithUniValue(const PlayerID &player, const std::string &json);
+
+    bool operator==(const Move &that) const;
+    bool operator!=(const Move &that) const { return !(*this == that); }
+
     /**
      * Return the minimum required "game fee" for this move.  The params
      * and block height are used to decide about fork states.
@@ -66,6 +77,41 @@ struct Move
     static bool IsValidPlayerName (const std::string& player);
 };
 
+/* A name update of a transaction, parsed as move.  Parsing does not depend
+   on the game state, so it can be done ahead of time (e. g., on worker
+   threads while replaying blocks).  The checks against the game state are
+   done when the move is added to a StepData.  */
+struct ParsedMove
+{
+    Move move;
+
+    /* The name and value of the name operation.  */
+    PlayerID name;
+    std::string value;
+
+    /* Whether Move::Parse succeeded.  */
+    bool parsed;
+    /* Whether this is a name_firstupdate (instead of name_update).  */
+    bool firstUpdate;
+
+    ParsedMove ()
+      : move(), name(), value(), parsed(false), firstUpdate(false)
+    {}
+};
+
+/* A block with the moves of all its transactions already parsed.  */
+struct ParsedBlock
+{
+    CBlock block;
+    uint256 hash;
+
+    /* Parsed moves, indexed in parallel to block.vtx.  */
+    std::vector<std::vector<ParsedMove> > moves;
+
+    /* Compute the hash and parse all moves of the block.  */
+    void Parse ();
+};
+
 class StepData
 {
 
@@ -98,6 +144,18 @@ public:
     bool addTransaction (const CTransaction& tx, const CCoinsView* pview,
                          CValidationState& res);
 
+    /* Same as addTransaction, but with the moves of tx already parsed
+       by ParseMoves.  */
+    bool addParsedTransaction (const CTransaction& tx,
+                               const std::vector<ParsedMove>& moves,
+                               const CCoinsView* pview,
+                               CValidationState& res);
+
+    /* Parse all moves of the given tx.  This does not depend on the
+       game state and can be done in parallel.  */
+    static void ParseMoves (const CTransaction& tx,
+                            std::vector<ParsedMove>& moves);
+
 };
 
 /* Perform a game engine step based on the given block.  Returns false if any
@@ -106,4 +164,9 @@ bool PerformStep (const CBlock& block, const GameState& stateIn,
                   const CCoinsView* pview, CValidationState& valid,
                   StepResult& res, GameState& stateOut);
 
+/* Perform a game engine step based on a block with already parsed moves.  */
+bool PerformStep (const ParsedBlock& block, const GameState& stateIn,
+                  const CCoinsView* pview, CValidationState& valid,
+                  StepResult& res, GameState& stateOut);
+
 #endif
@@ -17,244 +17,368 @@
 
 #include <game/map.h>
 #include <game/state.h>
+#include <util.h>
 
-#include <boost/graph/astar_search.hpp>
-#include <boost/graph/grid_graph.hpp>
-#include <boost/unordered_map.hpp>
-
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
 #include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-struct neighbor_iterator;
-
-// Model of:
-//  * Graph
-//  * IncidenceGraph
-struct Maze
+namespace
 {
-    // Graph concept requirements
-    typedef Coord                             vertex_descriptor;
-    typedef std::pair<Coord, Coord>           edge_descriptor;
-    typedef boost::undirected_tag             directed_category;
-    typedef boost::disallow_parallel_edge_tag edge_parallel_category;
-    typedef boost::incidence_graph_tag        traversal_category;
-
-    // IncidenceGraph concept requirements
-    typedef neighbor_iterator          out_edge_iterator;
-    typedef int                        degree_size_type;
-};
 
-namespace boost
-{
-    template <> struct graph_traits<Maze>
-    {
-        typedef Maze G;
+/* Number of tiles on the map.  All per-tile arrays have this size.  */
+const int NUM_TILES = MAP_WIDTH * MAP_HEIGHT;
 
-        typedef G::vertex_descriptor      vertex_descriptor;
-        typedef G::edge_descriptor        edge_descriptor;
-        typedef G::out_edge_iterator      out_edge_iterator;
+/* Offsets to the eight neighbours of a tile, in the order in which they
+   are explored by the search.  */
+const int NUM_NEIGHBOURS = 8;
+const int NEIGHBOUR_DX[NUM_NEIGHBOURS] = {-1, 0, 1, -1, 1, -1, 0, 1};
+const int NEIGHBOUR_DY[NUM_NEIGHBOURS] = {-1, -1, -1, 0, 0, 1, 1, 1};
 
-        typedef G::directed_category      directed_category;
-        typedef G::edge_parallel_category edge_parallel_category;
-        typedef G::traversal_category     traversal_category;
-
-        typedef G::degree_size_type       degree_size_type;
-
-        typedef void in_edge_iterator;
-        typedef void vertex_iterator;
-        typedef void vertices_size_type;
-        typedef void edge_iterator;
-        typedef void edges_size_type;
-    };
-}
-
-// IncidenceGraph concept requirements
-std::pair<Maze::out_edge_iterator, Maze::out_edge_iterator> out_edges(Maze::vertex_descriptor v, const Maze & g);
-Maze::degree_size_type out_degree(Maze::vertex_descriptor v, const Maze & g);
-Maze::vertex_descriptor source(const Maze::edge_descriptor &e, const Maze & g);
-Maze::vertex_descriptor target(const Maze::edge_descriptor &e, const Maze & g);
-
-static inline bool WalkableCoord(int x, int y)
+inline bool WalkableCoord(int x, int y)
 {
     return IsInsideMap(x, y) && IsWalkable(x, y);
 }
 
-static inline bool WalkableCoord(const Coord &c)
+inline bool WalkableCoord(const Coord &c)
 {
     return WalkableCoord(c.x, c.y);
 }
 
-// Iterator
-struct neighbor_iterator :
-    public boost::iterator_facade<neighbor_iterator,
-                                  std::pair<Coord, Coord>,
-                                  boost::forward_traversal_tag,
-                                  std::pair<Coord, Coord>& >
+/* Index of a tile in the per-tile arrays.  */
+inline int TileNumber(int x, int y)
+{
+    return y * MAP_WIDTH + x;
+}
+
+/**
+ * Navigation data derived once from ObstacleMap:  The walkable neighbours
+ * of each tile as bit mask, and a labelling of the connected regions.
+ * The latter allows us to reject unreachable goals immediately, instead of
+ * exploring the full region of the start tile.
+ */
+class NavigationGrid
 {
+
+private:
+
+    /* Bit i is set if neighbour i (as per NEIGHBOUR_DX/DY) is walkable.  */
+    std::vector<unsigned char> neighbours;
+
+    /* Connected region of each walkable tile, -1 for obstacles.  */
+    std::vector<int> region;
+
+    NavigationGrid()
+      : neighbours(NUM_TILES, 0), region(NUM_TILES, -1)
+    {
+        for (int y = 0; y < MAP_HEIGHT; ++y)
+            for (int x = 0; x < MAP_WIDTH; ++x)
+            {
+                if (!IsWalkable(x, y))
+                    continue;
+                unsigned char mask = 0;
+                for (int i = 0; i < NUM_NEIGHBOURS; ++i)
+                    if (WalkableCoord(x + NEIGHBOUR_DX[i], y + NEIGHBOUR_DY[i]))
+                        mask |= (1 << i);
+                neighbours[TileNumber(x, y)] = mask;
+            }
+
+        int nextRegion = 0;
+        std::vector<int> todo;
+        for (int y = 0; y < MAP_HEIGHT; ++y)
+            for (int x = 0; x < MAP_WIDTH; ++x)
+            {
+                const int start = TileNumber(x, y);
+                if (!IsWalkable(x, y) || region[start] != -1)
+                    continue;
+
+                region[start] = nextRegion;
+                todo.push_back(start);
+                while (!todo.empty())
+                {
+                    const int cur = todo.back();
+                    todo.pop_back();
+                    const int cx = cur % MAP_WIDTH;
+                    const int cy = cur / MAP_WIDTH;
+                    for (int i = 0; i < NUM_NEIGHBOURS; ++i)
+                    {
+                        if (!(neighbours[cur] & (1 << i)))
+                            continue;
+                        const int n = TileNumber(cx + NEIGHBOUR_DX[i],
+                                                 cy + NEIGHBOUR_DY[i]);
+                        if (region[n] == -1)
+                        {
+                            region[n] = nextRegion;
+                            todo.push_back(n);
+                        }
+                    }
+                }
+                ++nextRegion;
+            }
+    }
+
 public:
-    neighbor_iterator()
+
+    NavigationGrid(const NavigationGrid&) = delete;
+    void operator=(const NavigationGrid&) = delete;
+
+    /* Return the instance, constructing it on first use.  */
+    static const NavigationGrid& Get()
+    {
+        static const NavigationGrid instance;
+        return instance;
+    }
+
+    inline unsigned char Neighbours(int tile) const
+    {
+        return neighbours[tile];
+    }
+
+    inline bool Connected(int a, int b) const
     {
+        return region[a] != -1 && region[a] == region[b];
     }
 
-    neighbor_iterator(const Coord &c, bool end)
-        : coord(c)
+};
+
+/**
+ * Scratch memory for the search.  It is kept per thread and reused between
+ * calls, so that FindPath does not need to allocate or clear arrays over
+ * the full map.  Per-tile entries are only valid if their stamp matches
+ * the current search.
+ */
+struct SearchArena
+{
+
+    /* Entry of the open list, ordered by f = g + h.  Ties are broken
+       in favour of larger g, i. e., tiles closer to the goal.  */
+    struct OpenEntry
     {
-        if (end)
+        int f;
+        int g;
+        int tile;
+
+        inline bool operator<(const OpenEntry& o) const
         {
-            dx = -1;
-            dy = 2;
+            if (f != o.f)
+                return f > o.f;
+            return g < o.g;
         }
-        else
+    };
+
+    std::vector<uint32_t> stamp;
+    std::vector<int> dist;
+    std::vector<int> pred;
+    std::vector<OpenEntry> open;
+    std::vector<int> queue;
+    uint32_t current;
+
+    SearchArena()
+      : stamp(NUM_TILES, 0), dist(NUM_TILES), pred(NUM_TILES), open(),
+        queue(), current(0)
+    {}
+
+    /* Start a new search, invalidating all per-tile entries.  */
+    void Reset()
+    {
+        open.clear();
+        queue.clear();
+        ++current;
+        if (current == 0)
         {
-            dy = -2;
-            dx = 1;
-            increment();
+            std::fill(stamp.begin(), stamp.end(), 0);
+            current = 1;
         }
     }
 
-    neighbor_iterator &operator=(const neighbor_iterator &that)
+    inline bool Seen(int tile) const
     {
-        coord = that.coord;
-        dx = that.dx;
-        dy = that.dy;
-        return *this;
+        return stamp[tile] == current;
     }
 
-    std::pair<Coord, Coord> operator*() const
+    inline void Set(int tile, int d, int p)
     {
-        return std::make_pair(coord, Coord(coord.x + dx, coord.y + dy));
+        stamp[tile] = current;
+        dist[tile] = d;
+        pred[tile] = p;
     }
 
-    void operator++()
+    static SearchArena& Get()
     {
-        increment();
+        static thread_local std::unique_ptr<SearchArena> arena;
+        if (!arena)
+            arena.reset(new SearchArena());
+        return *arena;
     }
 
-    bool operator==(neighbor_iterator const& that) const
-    {
-        return coord == that.coord && dx == that.dx && dy == that.dy;
-    }
+};
+
+/**
+ * Run A* (with unit step costs and the L-infinity distance as heuristic)
+ * from start to goal.  Both must be walkable and connected.  The tiles
+ * of the path (excluding start) are returned in order.
+ */
+std::vector<Coord> SearchPath(const Coord &start, const Coord &goal)
+{
+    const NavigationGrid& grid = NavigationGrid::Get();
+    SearchArena& arena = SearchArena::Get();
+    arena.Reset();
+
+    const int startTile = TileNumber(start.x, start.y);
+    const int goalTile = TileNumber(goal.x, goal.y);
 
-    bool equal(neighbor_iterator const& that) const { return operator==(that); }
+    arena.Set(startTile, 0, -1);
+    arena.open.push_back({static_cast<int>(distLInf(start, goal)), 0,
+                          startTile});
 
-    void increment()
+    bool found = false;
+    while (!arena.open.empty())
     {
-        for (;;)
+        std::pop_heap(arena.open.begin(), arena.open.end());
+        const SearchArena::OpenEntry cur = arena.open.back();
+        arena.open.pop_back();
+
+        /* Skip stale entries for tiles that were reached more cheaply
+           after they were pushed.  */
+        if (cur.g != arena.dist[cur.tile])
+            continue;
+        if (cur.tile == goalTile)
         {
-            dx++;
-            if (dx == 2)
-            {
-                dx = -1;
-                dy++;
-            }
-            else if (dx == 0 && dy == 0)
+            found = true;
+            break;
+        }
+
+        const int cx = cur.tile % MAP_WIDTH;
+        const int cy = cur.tile / MAP_WIDTH;
+        const unsigned char mask = grid.Neighbours(cur.tile);
+        for (int i = 0; i < NUM_NEIGHBOURS; ++i)
+        {
+            if (!(mask & (1 << i)))
                 continue;
 
-            if (dy >= 2)
-                return;
-            if (WalkableCoord(coord.x + dx, coord.y + dy))
-                return;
+            const Coord n(cx + NEIGHBOUR_DX[i], cy + NEIGHBOUR_DY[i]);
+            const int nTile = TileNumber(n.x, n.y);
+            const int g = cur.g + 1;
+            if (arena.Seen(nTile) && arena.dist[nTile] <= g)
+                continue;
+
+            arena.Set(nTile, g, cur.tile);
+            arena.open.push_back({g + static_cast<int>(distLInf(n, goal)), g,
+                                  nTile});
+            std::push_heap(arena.open.begin(), arena.open.end());
         }
     }
 
-private:
-    Coord coord;
-    int dx, dy;
-};
-
-std::pair<Maze::out_edge_iterator, Maze::out_edge_iterator> out_edges(Maze::vertex_descriptor v, const Maze & g)
-{
-    return std::make_pair(
-        Maze::out_edge_iterator(v, false),
-        Maze::out_edge_iterator(v, true) );
-}
+    /* The goal is in the same region as the start, so it must be found.  */
+    assert(found);
 
-Maze::degree_size_type out_degree(Maze::vertex_descriptor v, const Maze & g)
-{
-    std::pair<Maze::out_edge_iterator, Maze::out_edge_iterator> iters = out_edges(v, g);
-    int deg = 0;
-    while (iters.first != iters.second)
+    std::vector<Coord> solution(arena.dist[goalTile]);
+    int tile = goalTile;
+    for (auto it = solution.rbegin(); it != solution.rend(); ++it)
     {
-        iters.first++;
-        deg++;
+        *it = Coord(tile % MAP_WIDTH, tile / MAP_WIDTH);
+        tile = arena.pred[tile];
     }
-    return deg;
-}
+    assert(tile == startTile);
 
-Maze::vertex_descriptor source(const Maze::edge_descriptor &e, const Maze & g)
-{
-    return e.first;
+    return solution;
 }
 
-Maze::vertex_descriptor target(const Maze::edge_descriptor &e, const Maze & g)
+/**
+ * Worker threads for ProcessPathQueries.  They are started on first use
+ * and live until the process exits.  This way, their (thread-local)
+ * search arenas are allocated once and reused by all later batches.
+ */
+class PathWorkerPool
 {
-    return e.second;
-}
 
-// Goal visitor and heuristic functor
-class MazeGoal : public boost::default_astar_visitor,
-                 public boost::astar_heuristic<Maze, int>
-{
-public:
-    MazeGoal(const Coord &goal_) : goal(goal_)
-    {
-    }
+private:
 
-    // Exception thrown when the goal vertex is found
-    struct found_goal {};
+    std::mutex mut;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> threads;
+    bool stop;
 
-    // Vertex visitor
-    void examine_vertex(const Coord &v, const Maze&) const
+    explicit PathWorkerPool(size_t nThreads)
+      : stop(false)
     {
-        if (v == goal)
-            throw found_goal();
+        for (size_t i = 0; i < nThreads; ++i)
+            threads.emplace_back(&PathWorkerPool::Run, this);
     }
 
-    // Heuristic
-    int operator()(const Coord &v)
+    /* Main loop of the worker threads.  */
+    void Run()
     {
-        return distLInf(v, goal);
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mut);
+                cv.wait(lock, [this]() { return stop || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
     }
 
-private:
-    Coord goal;
-};
+public:
 
-// A hash function for vertices.
-struct vertex_hash : public std::unary_function<Coord, std::size_t>
-{
-    std::size_t operator()(const Coord &c) const
+    PathWorkerPool(const PathWorkerPool&) = delete;
+    void operator=(const PathWorkerPool&) = delete;
+
+    ~PathWorkerPool()
     {
-        return (c.x << 16) | c.y;
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto& t : threads)
+            t.join();
     }
-};
 
-template <typename K, typename V>
-class default_map
-{
-public:
-    typedef K key_type;
-    typedef V data_type;
-    typedef std::pair<K, V> value_type;
+    inline size_t Size() const
+    {
+        return threads.size();
+    }
 
-    default_map(const V &defaultValue_)
-        : defaultValue(defaultValue_)
+    /* Queue a task to be run by one of the workers.  */
+    void Post(std::function<void()> task)
     {
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
     }
 
-    V & operator[](K const& k)
+    /* Return the instance, starting the threads on first use.  The calling
+       thread works on each batch as well, so start one thread less than
+       the number of threads to use.  */
+    static PathWorkerPool& Get()
     {
-        typename std::map<K, V>::iterator mi = m.find(k);
-        if (mi != m.end())
-            return mi->second;
-        mi = m.insert(value_type(k, defaultValue)).first;
-        return mi->second;
+        static PathWorkerPool instance(
+            std::min<size_t>(std::max(GetNumCores(), 1), MAX_PATH_THREADS)
+              - 1);
+        return instance;
     }
 
-private:
-    std::map<K, V> m;
-    V const defaultValue;
 };
 
+} // anonymous namespace
+
 // Helper function for creating waypoints (linear path segments)
 bool CheckLinearPath(const Coord &start, const Coord &target)
 {
@@ -272,77 +396,150 @@ std::vector<Coord> FindPath(const Coord &startPt, const Coord &goal)
 
     if (!WalkableCoord(startPt) || !WalkableCoord(goal))
         return waypoints;
-
-    boost::static_property_map<int> weight(1);
-
-    // The predecessor map is a vertex-to-vertex mapping.
-    typedef boost::unordered_map<Coord, Coord, vertex_hash> pred_map;
-    pred_map predecessor;
-    boost::associative_property_map<pred_map> pred_pmap(predecessor);
-
-    typedef boost::associative_property_map< default_map<Coord, int> > DistanceMap;
-    typedef default_map<Coord, int> WrappedDistanceMap;
-    WrappedDistanceMap wrappedMap = WrappedDistanceMap(std::numeric_limits<int>::max());
-    wrappedMap[startPt] = 0;
-    DistanceMap d = DistanceMap(wrappedMap);
-
-    MazeGoal maze_goal(goal);
-
-    std::map<Coord, int> index_map, rank_map;
-    std::map<Coord, boost::default_color_type> color_map;
-
-    bool found = false;
-
-    try
-    {
-        astar_search_no_init(
-                Maze(), startPt, maze_goal,
-                boost::weight_map(weight)
-                    .predecessor_map(pred_pmap)
-                    .distance_map(d)
-                    .visitor(maze_goal)
-                    .vertex_index_map(boost::associative_property_map< std::map<Coord, int> >(index_map))
-                    .rank_map(boost::associative_property_map< std::map<Coord, int> >(rank_map))
-                    .color_map(boost::associative_property_map< std::map<Coord, boost::default_color_type> >(color_map))
-                    .distance_compare(std::less<int>())
-                    .distance_combine(std::plus<int>())
-            );
-    }
-    catch (MazeGoal::found_goal fg)
-    {
-        found = true;
-    }
-
-    if (!found)
+    if (!NavigationGrid::Get().Connected(TileNumber(startPt.x, startPt.y),
+                                         TileNumber(goal.x, goal.y)))
         return waypoints;
 
-    // Walk backwards from the goal through the predecessor chain adding
-    // vertices to the solution path.
-    std::deque<Coord> solution;
-    for (Coord u = goal; u != startPt; u = predecessor[u])
-        solution.push_front(u);
+    const std::vector<Coord> solution = SearchPath(startPt, goal);
 
     // Generate waypoints by linearizing parts of path
     waypoints.push_back(startPt);
-    while (!solution.empty())
+    size_t next = 0;
+    while (next < solution.size())
     {
         // Find prefix of solution that can be linearized
 
         // Binary search
         int start = 0;
-        int end = solution.size();
+        int end = solution.size() - next;
         while (start < end - 1)
         {
             int mid = (start + end) / 2;
-            if (CheckLinearPath(waypoints.back(), solution[mid]))
+            if (CheckLinearPath(waypoints.back(), solution[next + mid]))
                 start = mid;
             else
                 end = mid;
         }
-        solution.erase(solution.begin(), solution.begin() + start);
-        waypoints.push_back(solution.front());
-        solution.pop_front();
+        waypoints.push_back(solution[next + start]);
+        next += start + 1;
     }
 
     return waypoints;
 }
+
+std::vector<int> FindDistances(const Coord &source,
+                               const std::vector<Coord> &targets)
+{
+    std::vector<int> res(targets.size(), -1);
+    if (!WalkableCoord(source))
+        return res;
+
+    const NavigationGrid& grid = NavigationGrid::Get();
+    const int sourceTile = TileNumber(source.x, source.y);
+
+    /* Collect the reachable target tiles, so that we can stop the search
+       as soon as all of them have been found.  */
+    std::vector<int> pending;
+    for (const auto& t : targets)
+        if (WalkableCoord(t)
+              && grid.Connected(sourceTile, TileNumber(t.x, t.y)))
+            pending.push_back(TileNumber(t.x, t.y));
+    std::sort(pending.begin(), pending.end());
+    pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+
+    /* Breadth-first search, which yields the walking distances since all
+       steps have unit cost.  */
+    SearchArena& arena = SearchArena::Get();
+    arena.Reset();
+    arena.Set(sourceTile, 0, -1);
+    arena.queue.push_back(sourceTile);
+    size_t remaining = pending.size();
+    if (std::binary_search(pending.begin(), pending.end(), sourceTile))
+        --remaining;
+
+    for (size_t i = 0; i < arena.queue.size() && remaining > 0; ++i)
+    {
+        const int cur = arena.queue[i];
+        const int cx = cur % MAP_WIDTH;
+        const int cy = cur / MAP_WIDTH;
+        const unsigned char mask = grid.Neighbours(cur);
+        for (int j = 0; j < NUM_NEIGHBOURS; ++j)
+        {
+            if (!(mask & (1 << j)))
+                continue;
+            const int n = TileNumber(cx + NEIGHBOUR_DX[j],
+                                     cy + NEIGHBOUR_DY[j]);
+            if (arena.Seen(n))
+                continue;
+
+            arena.Set(n, arena.dist[cur] + 1, cur);
+            arena.queue.push_back(n);
+            if (std::binary_search(pending.begin(), pending.end(), n))
+                --remaining;
+        }
+    }
+    assert(remaining == 0);
+
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        const Coord& t = targets[i];
+        if (!WalkableCoord(t))
+            continue;
+        const int tile = TileNumber(t.x, t.y);
+        if (arena.Seen(tile))
+            res[i] = arena.dist[tile];
+    }
+
+    return res;
+}
+
+std::vector<PathResult> ProcessPathQueries(const std::vector<PathQuery> &queries)
+{
+    std::vector<PathResult> res(queries.size());
+
+    /* Each worker claims the next unprocessed query until all are done.
+       The scratch arenas are per thread, so the workers do not share
+       any state apart from the results (which are written to distinct
+       entries).  The workers are the calling thread and the threads of
+       the persistent pool.  */
+    std::atomic<size_t> next(0);
+    auto worker = [&queries, &res, &next]()
+    {
+        while (true)
+        {
+            const size_t i = next++;
+            if (i >= queries.size())
+                return;
+
+            const PathQuery& q = queries[i];
+            if (q.targets.empty())
+                res[i].path = FindPath(q.from, q.to);
+            else
+                res[i].distances = FindDistances(q.from, q.targets);
+        }
+    };
+
+    PathWorkerPool& pool = PathWorkerPool::Get();
+    const size_t nHelpers
+      = queries.empty() ? 0 : std::min(pool.Size(), queries.size() - 1);
+
+    std::mutex mutDone;
+    std::condition_variable cvDone;
+    size_t running = nHelpers;
+    for (size_t i = 0; i < nHelpers; ++i)
+        pool.Post([&worker, &mutDone, &cvDone, &running]()
+        {
+            worker();
+            std::lock_guard<std::mutex> lock(mutDone);
+            if (--running == 0)
+                cvDone.notify_one();
+        });
+    worker();
+
+    /* The tasks refer to our local variables, so wait for all of them
+       even if the queries were finished by others already.  */
+    std::unique_lock<std::mutex> lock(mutDone);
+    cvDone.wait(lock, [&running]() { return running == 0; });
+
+    return res;
+}
@@ -20,7 +20,61 @@
 
 #include <vector>
 
+/** Maximum number of worker threads used by ProcessPathQueries.  */
+static const unsigned MAX_PATH_THREADS = 8;
+
 std::vector<Coord>
 FindPath (const Coord &start, const Coord &goal);
 
+/**
+ * Compute the walking distances (in steps) from source to each of the
+ * targets.  Unreachable targets (and all targets if source is not walkable)
+ * get a distance of -1.  This is done with a single search, so it is much
+ * cheaper than finding paths to all targets individually.
+ */
+std::vector<int>
+FindDistances (const Coord &source, const std::vector<Coord> &targets);
+
+/** A query for batch pathfinding.  */
+struct PathQuery
+{
+
+  /** The starting coordinate.  */
+  Coord from;
+
+  /** The goal for path queries.  */
+  Coord to;
+
+  /**
+   * If non-empty, compute the distances to all these coordinates with
+   * FindDistances instead of the path to "to".
+   */
+  std::vector<Coord> targets;
+
+  PathQuery ()
+    : from(0, 0), to(0, 0)
+  {}
+
+};
+
+/** The result of a PathQuery.  */
+struct PathResult
+{
+
+  /** The path (as returned by FindPath) for path queries.  */
+  std::vector<Coord> path;
+
+  /** The distances for distance queries.  */
+  std::vector<int> distances;
+
+};
+
+/**
+ * Process a batch of queries, spreading the work across the calling thread
+ * and a pool of persistent worker threads.  The results are returned in
+ * the order of the queries.
+ */
+std::vector<PathResult>
+ProcessPathQueries (const std::vector<PathQuery> &queries);
+
 #endif
@@ -0,0 +1,120 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <game/prefetch.h>
+
+#include <game/move.h>
+#include <util.h>
+#include <validation.h>
+
+#include <algorithm>
+
+BlockPrefetcher::BlockPrefetcher (const Consensus::Params& p,
+                                  const std::vector<Entry>& b, bool parse)
+  : params(p), blocks(b), parseMoves(parse),
+    cs(), cv(), nextToRead(0), nextToTake(0), ready(), interrupted(false),
+    workers()
+{
+  /* Leave one core for the thread consuming the blocks.  */
+  int nThreads = GetNumCores () - 1;
+  nThreads = std::min<int> (nThreads, MAX_PREFETCH_THREADS);
+  nThreads = std::min<int> (nThreads, blocks.size ());
+  nThreads = std::max (nThreads, 1);
+
+  if (blocks.empty ())
+    return;
+
+  for (int i = 0; i < nThreads; ++i)
+    workers.emplace_back (&BlockPrefetcher::ThreadWorker, this);
+}
+
+BlockPrefetcher::~BlockPrefetcher ()
+{
+  {
+    WaitableLock lock(cs);
+    interrupted = true;
+  }
+  cv.notify_all ();
+
+  for (auto& t : workers)
+    t.join ();
+}
+
+void
+BlockPrefetcher::ThreadWorker ()
+{
+  RenameThread ("huntercoin-gameprefetch");
+
+  while (true)
+    {
+      size_t index;
+      {
+        WaitableLock lock(cs);
+        while (!interrupted && nextToRead < blocks.size ()
+                && nextToRead >= nextToTake + PREFETCH_WINDOW)
+          cv.wait (lock);
+
+        if (interrupted || nextToRead >= blocks.size ())
+          return;
+        index = nextToRead++;
+      }
+
+      const Entry& entry = blocks[index];
+      std::unique_ptr<ParsedBlock> res(new ParsedBlock ());
+      if (!ReadBlockFromDisk (res->block, entry.pos, params))
+        {
+          error ("%s: failed to read block %s from disk",
+                 __func__, entry.hash.GetHex ().c_str ());
+          res.reset ();
+        }
+      else if (parseMoves)
+        res->Parse ();
+      else
+        res->hash = res->block.GetHash ();
+
+      if (res && res->hash != entry.hash)
+        {
+          error ("%s: block on disk does not match index for %s",
+                 __func__, entry.hash.GetHex ().c_str ());
+          res.reset ();
+        }
+
+      {
+        WaitableLock lock(cs);
+        ready[index] = std::move (res);
+      }
+      cv.notify_all ();
+    }
+}
+
+std::unique_ptr<ParsedBlock>
+BlockPrefetcher::Next ()
+{
+  WaitableLock lock(cs);
+  assert (nextToTake < blocks.size ());
+
+  std::map<size_t, std::unique_ptr<ParsedBlock>>::iterator mi;
+  while ((mi = ready.find (nextToTake)) == ready.end ())
+    cv.wait (lock);
+
+  std::unique_ptr<ParsedBlock> res = std::move (mi->second);
+  ready.erase (mi);
+  ++nextToTake;
+
+  /* Wake up workers that wait for space in the window.  */
+  cv.notify_all ();
+
+  return res;
+}
@@ -0,0 +1,121 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GAME_PREFETCH_H
+#define GAME_PREFETCH_H
+
+#include <chain.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct ParsedBlock;
+
+namespace Consensus
+{
+struct Params;
+}
+
+/** Maximum number of worker threads used to prefetch blocks.  */
+static const unsigned MAX_PREFETCH_THREADS = 4;
+/** Maximum number of blocks that are read ahead of the consumer.  */
+static const unsigned PREFETCH_WINDOW = 64;
+
+/**
+ * Reads a sequence of blocks from disk on worker threads, ahead of the
+ * thread that processes them.  Optionally the moves in the blocks are
+ * parsed as well.  This is used when replaying game steps, so that the
+ * (necessarily sequential) game engine does not have to wait for disk reads,
+ * deserialisation and JSON parsing.
+ *
+ * The worker threads do not lock cs_main.  All data needed from the block
+ * index must be passed in when constructing the prefetcher.
+ */
+class BlockPrefetcher
+{
+
+public:
+
+  /** A block that should be read.  */
+  struct Entry
+  {
+    uint256 hash;
+    CDiskBlockPos pos;
+
+    explicit Entry (const CBlockIndex& index)
+      : hash(index.GetBlockHash ()), pos(index.GetBlockPos ())
+    {}
+
+    Entry (const uint256& h, const CDiskBlockPos& p)
+      : hash(h), pos(p)
+    {}
+  };
+
+private:
+
+  const Consensus::Params& params;
+  const std::vector<Entry> blocks;
+  const bool parseMoves;
+
+  CWaitableCriticalSection cs;
+  CConditionVariable cv;
+
+  /** Index of the next block that will be claimed by a worker.  */
+  size_t nextToRead;
+  /** Index of the next block that will be returned by Next().  */
+  size_t nextToTake;
+  /**
+   * Blocks that have been processed but not yet taken.  Failed reads
+   * are stored as null pointers.
+   */
+  std::map<size_t, std::unique_ptr<ParsedBlock>> ready;
+  /** Set when the workers should stop.  */
+  bool interrupted;
+
+  std::vector<std::thread> workers;
+
+  /** Main loop of the worker threads.  */
+  void ThreadWorker ();
+
+public:
+
+  /**
+   * Construct the prefetcher and start the worker threads.
+   * @param p Consensus parameters used to check the blocks.
+   * @param b The blocks to read, in the order they will be requested.
+   * @param parse Whether or not the moves should be parsed.
+   */
+  BlockPrefetcher (const Consensus::Params& p, const std::vector<Entry>& b,
+                   bool parse);
+
+  ~BlockPrefetcher ();
+
+  BlockPrefetcher (const BlockPrefetcher&) = delete;
+  void operator= (const BlockPrefetcher&) = delete;
+
+  /**
+   * Return the next block in the sequence, waiting for it to be read
+   * if necessary.  Returns null if the block could not be read or
+   * does not match its expected hash.
+   */
+  std::unique_ptr<ParsedBlock> Next ();
+
+};
+
+#endif // GAME_PREFETCH_H
@@ -15,9 +15,10 @@
 
 #include <game/state.h>
 
-#include <core_io.h>
+#include <game/jsonwriter.h>
 #include <game/map.h>
 #include <game/move.h>
+#include <game/tiles.h>
 #include <rpc/server.h>
 #include <util.h>
 #include <utilstrencodings.h>
@@ -58,18 +59,42 @@ IsWalkableCoord (const Coord &c)
 }
 
 /**
- * Keep a set of walkable tiles.  This is used for random selection of
+ * Keep lists of walkable tiles.  They are used for random selection of
  * one of them for spawning / dynamic bank purposes.  Note that it is
  * important how they are ordered (according to Coord::operator<) in order
  * to reach consensus on the game state.
  *
- * This is filled in from IsWalkable() whenever it is empty (on startup).  It
- * does not ever change.
+ * The lists are computed from IsWalkable() on first use and never change.
+ * Game steps run concurrently (e. g., historical replays next to block
+ * validation), so they are built through a function-local static, whose
+ * initialisation is thread-safe.
  */
-std::vector<Coord> walkableTiles;
-// for FORK_TIMESAVE -- 2 more sets of walkable tiles
-std::vector<Coord> walkableTiles_ts_players;
-std::vector<Coord> walkableTiles_ts_banks;
+class WalkableTiles
+{
+
+private:
+
+  WalkableTiles ();
+
+public:
+
+  std::vector<Coord> all;
+  // for FORK_TIMESAVE -- 2 more sets of walkable tiles
+  std::vector<Coord> tsPlayers;
+  std::vector<Coord> tsBanks;
+
+  WalkableTiles (const WalkableTiles&) = delete;
+  void operator= (const WalkableTiles&) = delete;
+
+  /* Return the instance, constructing it on first use.  */
+  static const WalkableTiles&
+  Get ()
+  {
+    static const WalkableTiles instance;
+    return instance;
+  }
+
+};
 
 /* Calculate carrying capacity.  This is where it is basically defined.
    It depends on the block height (taking forks changing it into account)
@@ -128,44 +153,40 @@ DropHeart (const GameState& state)
   return state.nHeight % heartEvery == 0;
 }
 
-/* Fills in a walkableTiles array, using the passed predicate in addition
+/* Fills in a walkable tiles array, using the passed predicate in addition
    to the general IsWalkable() function to decide which coordinates should
    be put into the list.  */
 void
 FillWalkableArray (std::vector<Coord>& tiles,
                    const std::function<bool(int, int)>& predicate)
 {
-  if (tiles.empty ())
-    {
-      for (int x = 0; x < MAP_WIDTH; ++x)
-        for (int y = 0; y < MAP_HEIGHT; ++y)
-          if (IsWalkable (x, y) && predicate (x, y))
-            tiles.push_back (Coord (x, y));
+  assert (tiles.empty ());
+  for (int x = 0; x < MAP_WIDTH; ++x)
+    for (int y = 0; y < MAP_HEIGHT; ++y)
+      if (IsWalkable (x, y) && predicate (x, y))
+        tiles.push_back (Coord (x, y));
 
-      /* Do not forget to sort in the order defined by operator<!  */
-      std::sort (tiles.begin (), tiles.end ());
-    }
+  /* Do not forget to sort in the order defined by operator<!  */
+  std::sort (tiles.begin (), tiles.end ());
 
   assert (!tiles.empty ());
 }
 
-/* Ensure that walkableTiles is filled.  */
-void
-FillWalkableTiles ()
+WalkableTiles::WalkableTiles ()
 {
-  FillWalkableArray (walkableTiles_ts_players,
+  FillWalkableArray (tsPlayers,
     [] (int x, int y)
       {
         return SpawnMap[y][x] & SPAWNMAPFLAG_PLAYER;
       });
 
-  FillWalkableArray (walkableTiles_ts_banks,
+  FillWalkableArray (tsBanks,
     [] (int x, int y)
       {
         return SpawnMap[y][x] & SPAWNMAPFLAG_BANK;
       });
 
-  FillWalkableArray (walkableTiles,
+  FillWalkableArray (all,
     [] (int x, int y)
       {
         return true;
@@ -275,7 +296,7 @@ CharactersOnTiles::EnsureIsBuilt (const GameState& state)
   assert (tiles.empty ());
 
   for (const auto& p : state.players)
-    for (const auto& pc : p.second.characters)
+    for (const auto& pc : p.second->characters)
       {
         // newly spawned hunters not attackable
         if (state.ForkInEffect (FORK_TIMESAVE))
@@ -287,11 +308,12 @@ CharactersOnTiles::EnsureIsBuilt (const GameState& state)
 
         AttackableCharacter a;
         a.chid = CharacterID (p.first, pc.first);
-        a.color = p.second.color;
+        a.color = p.second->color;
         a.drawnLife = 0;
 
-        tiles.insert (std::make_pair (pc.second.coord, a));
+        tiles.Add (pc.second.coord, a);
       }
+  tiles.Finalise ();
   built = true;
 }
 
@@ -306,10 +328,10 @@ CharactersOnTiles::ApplyAttacks (const GameState& state,
 
       const PlayerStateMap::const_iterator miPl = state.players.find (m.player);
       assert (miPl != state.players.end ());
-      const PlayerState& pl = miPl->second;
+      const PlayerState& pl = *miPl->second;
       for (const int i : m.destruct)
         {
-          const std::map<int, CharacterState>::const_iterator miCh
+          const CharacterMap::const_iterator miCh
             = pl.characters.find (i);
           if (miCh == pl.characters.end ())
             continue;
@@ -335,7 +357,7 @@ CharactersOnTiles::ApplyAttacks (const GameState& state,
             for (int x = c.x - radius; x <= c.x + radius; x++)
               {
                 const std::pair<Map::iterator, Map::iterator> iters
-                  = tiles.equal_range (Coord (x, y));
+                  = tiles.EqualRange (Coord (x, y));
                 for (Map::iterator it = iters.first; it != iters.second; ++it)
                   {
                     AttackableCharacter& a = it->second;
@@ -369,7 +391,7 @@ CharactersOnTiles::DrawLife (GameState& state, StepResult& result)
       /* Find the player state of the attacked character.  */
       PlayerStateMap::iterator vit = state.players.find (a.chid.player);
       assert (vit != state.players.end ());
-      PlayerState& victim = vit->second;
+      PlayerState& victim = vit->second.Modify ();
 
       /* In case of life steal, actually draw life.  The coins are not yet
          added to the attacker, but instead their total amount is saved
@@ -382,6 +404,7 @@ CharactersOnTiles::DrawLife (GameState& state, StepResult& result)
           if (fullDamage > victim.value)
             fullDamage = victim.value;
 
+          const CAmount valueBefore = victim.value;
           victim.value -= fullDamage;
           a.drawnLife += fullDamage;
 
@@ -393,6 +416,7 @@ CharactersOnTiles::DrawLife (GameState& state, StepResult& result)
               a.drawnLife += victim.value;
               victim.value = 0;
             }
+          state.coinTotals.playerValues -= valueBefore - victim.value;
         }
       assert (victim.value >= 0);
       assert (a.drawnLife >= 0);
@@ -476,7 +500,7 @@ CharactersOnTiles::DistributeDrawnLife (RandomGenerator& rnd,
   /* Life is already drawn.  It remains to distribute the drawn balances
      from each attacked character back to its attackers.  For this,
      we first find the still alive players and assemble them in a map.  */
-  std::map<CharacterID, PlayerState*> alivePlayers;
+  std::map<CharacterID, CowPtr<PlayerState>*> alivePlayers;
   for (const auto& tile : tiles)
     {
       const AttackableCharacter& a = tile.second;
@@ -489,9 +513,8 @@ CharactersOnTiles::DistributeDrawnLife (RandomGenerator& rnd,
       const PlayerStateMap::iterator pit = state.players.find (a.chid.player);
       if (pit != state.players.end ())
         {
-          PlayerState& pl = pit->second;
-          assert (pl.characters.count (a.chid.index) > 0);
-          alivePlayers.insert (std::make_pair (a.chid, &pl));
+          assert (pit->second->characters.count (a.chid.index) > 0);
+          alivePlayers.insert (std::make_pair (a.chid, &pit->second));
         }
     }
 
@@ -516,12 +539,13 @@ CharactersOnTiles::DistributeDrawnLife (RandomGenerator& rnd,
       while (!alive.empty () && toSpend >= damage)
         {
           const unsigned ind = rnd.GetIntRnd (alive.size ());
-          const std::map<CharacterID, PlayerState*>::iterator plIt
+          const std::map<CharacterID, CowPtr<PlayerState>*>::iterator plIt
             = alivePlayers.find (alive[ind]);
           assert (plIt != alivePlayers.end ());
 
           toSpend -= damage;
-          plIt->second->value += damage;
+          plIt->second->Modify ().value += damage;
+          state.coinTotals.playerValues += damage;
 
           /* Do not use a silly trick like swapping in the last element.
              We want to keep the array ordered at all times.  The order is
@@ -545,10 +569,9 @@ CharacterState::Spawn (const GameState& state, int color, RandomGenerator &rnd)
   // less possible player spawn tiles
   if (state.ForkInEffect (FORK_TIMESAVE))
   {
-      FillWalkableTiles ();
-
-      const int pos = rnd.GetIntRnd (walkableTiles_ts_players.size ());
-      coord = walkableTiles_ts_players[pos];
+      const std::vector<Coord>& tiles = WalkableTiles::Get ().tsPlayers;
+      const int pos = rnd.GetIntRnd (tiles.size ());
+      coord = tiles[pos];
 
       dir = rnd.GetIntRnd (1, 8);
       if (dir >= 5)
@@ -558,10 +581,9 @@ CharacterState::Spawn (const GameState& state, int color, RandomGenerator &rnd)
   /* Pick a random walkable spawn location after the life-steal fork.  */
   else if (state.ForkInEffect (FORK_LIFESTEAL))
     {
-      FillWalkableTiles ();
-
-      const int pos = rnd.GetIntRnd (walkableTiles.size ());
-      coord = walkableTiles[pos];
+      const std::vector<Coord>& tiles = WalkableTiles::Get ().all;
+      const int pos = rnd.GetIntRnd (tiles.size ());
+      coord = tiles[pos];
 
       dir = rnd.GetIntRnd (1, 8);
       if (dir >= 5)
@@ -692,7 +714,7 @@ void CharacterState::MoveTowardsWaypoint()
         }
     };
 
-    Coord new_c;
+    Coord new_c(0, 0);
     Coord target = waypoints.back();
     
     int dx = target.x - from.x;
@@ -730,7 +752,7 @@ void CharacterState::MoveTowardsWaypoint()
     }
 }
 
-std::vector<Coord> CharacterState::DumpPath(const std::vector<Coord> *alternative_waypoints /* = NULL */) const
+std::vector<Coord> CharacterState::DumpPath(const WaypointVector *alternative_waypoints /* = NULL */) const
 {
     std::vector<Coord> ret;
     CharacterState tmp = *this;
@@ -839,77 +861,102 @@ PlayerState::CanSpawnCharacter() const
           && next_character_index < MAX_CHARACTERS_PER_PLAYER_TOTAL;
 }
 
-UniValue PlayerState::ToJsonValue(int crown_index, bool dead /* = false*/) const
+void PlayerState::WriteJson(JsonWriter& out, int crown_index, bool dead /* = false*/) const
 {
-  UniValue obj(UniValue::VOBJ);
-  obj.pushKV ("color", (int)color);
-  obj.pushKV ("value", ValueFromAmount(value));
+  out.BeginObject ();
+  out.Key ("color");
+  out.Int (color);
+  out.Key ("value");
+  out.Amount (value);
 
   /* If the character is poisoned, write that out.  Otherwise just
      leave the field off.  */
   if (remainingLife > 0)
-    obj.pushKV ("poison", remainingLife);
+    {
+      out.Key ("poison");
+      out.Int (remainingLife);
+    }
   else
     assert (remainingLife == -1);
 
   if (!message.empty())
     {
-      obj.pushKV ("msg", message);
-      obj.pushKV ("msg_block", message_block);
+      out.Key ("msg");
+      out.String (message);
+      out.Key ("msg_block");
+      out.Int (message_block);
     }
 
   if (!dead)
     {
       if (!address.empty())
-        obj.pushKV ("address", address);
+        {
+          out.Key ("address");
+          out.String (address);
+        }
       if (!addressLock.empty())
-        obj.pushKV ("addressLock", address);
+        {
+          out.Key ("addressLock");
+          out.String (address);
+        }
     }
   else
     {
       // Note: not all dead players are listed - only those who sent chat
       // messages in their last move.
       assert(characters.empty());
-      obj.pushKV ("dead", 1);
+      out.Key ("dead");
+      out.Int (1);
     }
 
-  UniValue characterObj(UniValue::VOBJ);
+  out.Key ("characters");
+  out.BeginObject ();
   for (const auto& pc : characters)
     {
       int i = pc.first;
       const CharacterState &ch = pc.second;
-      characterObj.pushKV (strprintf ("%d", i),
-                           ch.ToJsonValue (i == crown_index));
+      out.Key (strprintf ("%d", i));
+      ch.WriteJson (out, i == crown_index);
     }
-  obj.pushKV ("characters", characterObj);
+  out.EndObject ();
 
-  return obj;
+  out.EndObject ();
 }
 
-UniValue CharacterState::ToJsonValue(bool has_crown) const
+void CharacterState::WriteJson(JsonWriter& out, bool has_crown) const
 {
-    UniValue obj(UniValue::VOBJ);
-    obj.pushKV("x", coord.x);
-    obj.pushKV("y", coord.y);
+    out.BeginObject();
+    out.Key("x");
+    out.Int(coord.x);
+    out.Key("y");
+    out.Int(coord.y);
     if (!waypoints.empty())
     {
-        obj.pushKV("fromX", from.x);
-        obj.pushKV("fromY", from.y);
-        UniValue arr(UniValue::VARR);
+        out.Key("fromX");
+        out.Int(from.x);
+        out.Key("fromY");
+        out.Int(from.y);
+        out.Key("wp");
+        out.BeginArray();
         for (int i = waypoints.size() - 1; i >= 0; i--)
         {
-            arr.push_back(waypoints[i].x);
-            arr.push_back(waypoints[i].y);
+            out.Int(waypoints[i].x);
+            out.Int(waypoints[i].y);
         }
-        obj.pushKV("wp", arr);
+        out.EndArray();
     }
-    obj.pushKV("dir", (int)dir);
-    obj.pushKV("stay_in_spawn_area", stay_in_spawn_area);
-    obj.pushKV("loot", ValueFromAmount(loot.nAmount));
+    out.Key("dir");
+    out.Int(dir);
+    out.Key("stay_in_spawn_area");
+    out.Int(stay_in_spawn_area);
+    out.Key("loot");
+    out.Amount(loot.nAmount);
     if (has_crown)
-        obj.pushKV("has_crown", true);
-
-    return obj;
+    {
+        out.Key("has_crown");
+        out.Bool(true);
+    }
+    out.EndObject();
 }
 
 /* ************************************************************************** */
@@ -941,6 +988,8 @@ SetOriginalBanks (std::map<Coord, unsigned>& banks)
     }
 }
 
+bool fCheckGameCoins = false;
+
 GameState::GameState(const Consensus::Params& p)
   : param(&p)
 {
@@ -950,84 +999,119 @@ GameState::GameState(const Consensus::Params& p)
     nHeight = -1;
     nDisasterHeight = -1;
     hashBlock.SetNull ();
+    nCoinTotalsScanned = -1;
     SetOriginalBanks (banks);
 }
 
-UniValue GameState::ToJsonValue() const
+void GameState::WriteJson(JsonWriter& out) const
 {
-    UniValue obj(UniValue::VOBJ);
+    out.BeginObject();
 
-    UniValue jsonPlayers(UniValue::VOBJ);
+    /* Chat messages of dead players are written together with the alive
+       players.  In the (theoretical) case that a name is in both, the
+       dead entry is written in place of the alive one.  */
+    out.Key("players");
+    out.BeginObject();
     for (const auto& p : players)
       {
+        out.Key(p.first);
+        const auto mi = dead_players_chat.find(p.first);
+        if (mi != dead_players_chat.end())
+          {
+            mi->second.WriteJson(out, -1, true);
+            continue;
+          }
         int crown_index = p.first == crownHolder.player ? crownHolder.index : -1;
-        jsonPlayers.pushKV(p.first, p.second.ToJsonValue(crown_index));
+        p.second->WriteJson(out, crown_index);
       }
-
-    // Save chat messages of dead players
     for (const auto& p : dead_players_chat)
-        jsonPlayers.pushKV(p.first, p.second.ToJsonValue(-1, true));
-
-    obj.pushKV("players", jsonPlayers);
+      if (players.count(p.first) == 0)
+        {
+          out.Key(p.first);
+          p.second.WriteJson(out, -1, true);
+        }
+    out.EndObject();
 
-    UniValue jsonLoot(UniValue::VARR);
+    out.Key("loot");
+    out.BeginArray();
     for (const auto& p : loot)
       {
-        UniValue subobj(UniValue::VOBJ);
-        subobj.pushKV("x", p.first.x);
-        subobj.pushKV("y", p.first.y);
-        subobj.pushKV("amount", ValueFromAmount(p.second.nAmount));
-        UniValue blk_rng(UniValue::VARR);
-        blk_rng.push_back(p.second.firstBlock);
-        blk_rng.push_back(p.second.lastBlock);
-        subobj.pushKV("blockRange", blk_rng);
-        jsonLoot.push_back(subobj);
+        out.BeginObject();
+        out.Key("x");
+        out.Int(p.first.x);
+        out.Key("y");
+        out.Int(p.first.y);
+        out.Key("amount");
+        out.Amount(p.second.nAmount);
+        out.Key("blockRange");
+        out.BeginArray();
+        out.Int(p.second.firstBlock);
+        out.Int(p.second.lastBlock);
+        out.EndArray();
+        out.EndObject();
       }
-    obj.pushKV("loot", jsonLoot);
+    out.EndArray();
 
-    UniValue jsonHearts(UniValue::VARR);
+    out.Key ("hearts");
+    out.BeginArray ();
     for (const auto& c : hearts)
       {
-        UniValue subobj(UniValue::VOBJ);
-        subobj.pushKV ("x", c.x);
-        subobj.pushKV ("y", c.y);
-        jsonHearts.push_back (subobj);
+        out.BeginObject ();
+        out.Key ("x");
+        out.Int (c.x);
+        out.Key ("y");
+        out.Int (c.y);
+        out.EndObject ();
       }
-    obj.pushKV ("hearts", jsonHearts);
+    out.EndArray ();
 
-    UniValue jsonBanks(UniValue::VARR);
+    out.Key ("banks");
+    out.BeginArray ();
     for (const auto& b : banks)
       {
-        UniValue subobj(UniValue::VOBJ);
-        subobj.pushKV ("x", b.first.x);
-        subobj.pushKV ("y", b.first.y);
-        subobj.pushKV ("life", static_cast<int> (b.second));
-        jsonBanks.push_back (subobj);
+        out.BeginObject ();
+        out.Key ("x");
+        out.Int (b.first.x);
+        out.Key ("y");
+        out.Int (b.first.y);
+        out.Key ("life");
+        out.Int (b.second);
+        out.EndObject ();
       }
-    obj.pushKV ("banks", jsonBanks);
-
-    UniValue jsonCrown(UniValue::VOBJ);
-    jsonCrown.pushKV("x", crownPos.x);
-    jsonCrown.pushKV("y", crownPos.y);
+    out.EndArray ();
+
+    out.Key("crown");
+    out.BeginObject();
+    out.Key("x");
+    out.Int(crownPos.x);
+    out.Key("y");
+    out.Int(crownPos.y);
     if (!crownHolder.player.empty())
     {
-        jsonCrown.pushKV("holderName", crownHolder.player);
-        jsonCrown.pushKV("holderIndex", crownHolder.index);
+        out.Key("holderName");
+        out.String(crownHolder.player);
+        out.Key("holderIndex");
+        out.Int(crownHolder.index);
     }
-    obj.pushKV("crown", jsonCrown);
-
-    obj.pushKV ("gameFund", ValueFromAmount (gameFund));
-    obj.pushKV ("height", nHeight);
-    obj.pushKV ("disasterHeight", nDisasterHeight);
-    obj.pushKV ("hashBlock", hashBlock.ToString().c_str());
-
-    return obj;
+    out.EndObject();
+
+    out.Key ("gameFund");
+    out.Amount (gameFund);
+    out.Key ("height");
+    out.Int (nHeight);
+    out.Key ("disasterHeight");
+    out.Int (nDisasterHeight);
+    out.Key ("hashBlock");
+    out.String (hashBlock.ToString ());
+
+    out.EndObject();
 }
 
 void GameState::AddLoot(Coord coord, CAmount nAmount)
 {
     if (nAmount == 0)
         return;
+    coinTotals.lootOnMap += nAmount;
     std::map<Coord, LootInfo>::iterator mi = loot.find(coord);
     if (mi != loot.end())
     {
@@ -1120,23 +1204,15 @@ operator< (const CharacterOnLootTile& a, const CharacterOnLootTile& b)
 
 void GameState::DivideLootAmongPlayers()
 {
-    std::map<Coord, int> playersOnLootTile;
-    std::vector<CharacterOnLootTile> collectors;
-    for (auto& p : players)
-      for (auto& pc : p.second.characters)
+    /* Find the characters on loot tiles first without touching the
+       (possibly shared) player states.  Only the players that actually
+       collect something are detached afterwards.  */
+    typedef std::pair<PlayerStateMap::iterator, int> CollectorRef;
+    std::vector<CollectorRef> onLoot;
+    for (PlayerStateMap::iterator mi = players.begin (); mi != players.end (); ++mi)
+      for (const auto& pc : mi->second->characters)
         {
-          CharacterOnLootTile tileChar;
-
-          tileChar.pid = p.first;
-          tileChar.cid = pc.first;
-          tileChar.ch = &pc.second;
-
-          const bool isCrownHolder = (tileChar.pid == crownHolder.player
-                                      && tileChar.cid == crownHolder.index);
-          tileChar.carryCap = GetCarryingCapacity (*this, tileChar.cid == 0,
-                                                   isCrownHolder);
-
-          const Coord& coord = tileChar.ch->coord;
+          const Coord& coord = pc.second.coord;
 
           // ghosting with phasing-in
           if (ForkInEffect (FORK_TIMESAVE))
@@ -1146,18 +1222,35 @@ void GameState::DivideLootAmongPlayers()
                      continue;
 
           if (loot.count (coord) > 0)
-            {
-              std::map<Coord, int>::iterator mi;
-              mi = playersOnLootTile.find (coord);
+            onLoot.push_back (std::make_pair (mi, pc.first));
+        }
 
-              if (mi != playersOnLootTile.end ())
-                mi->second++;
-              else
-                playersOnLootTile.insert (std::make_pair (coord, 1));
+    std::map<Coord, int> playersOnLootTile;
+    std::vector<CharacterOnLootTile> collectors;
+    for (const auto& ref : onLoot)
+      {
+        CharacterOnLootTile tileChar;
 
-              collectors.push_back (tileChar);
-            }
-        }
+        tileChar.pid = ref.first->first;
+        tileChar.cid = ref.second;
+        tileChar.ch = &ref.first->second.Modify ().characters[ref.second];
+
+        const bool isCrownHolder = (tileChar.pid == crownHolder.player
+                                    && tileChar.cid == crownHolder.index);
+        tileChar.carryCap = GetCarryingCapacity (*this, tileChar.cid == 0,
+                                                 isCrownHolder);
+
+        const Coord& coord = tileChar.ch->coord;
+        std::map<Coord, int>::iterator mi;
+        mi = playersOnLootTile.find (coord);
+
+        if (mi != playersOnLootTile.end ())
+          mi->second++;
+        else
+          playersOnLootTile.insert (std::make_pair (coord, 1));
+
+        collectors.push_back (tileChar);
+      }
 
     std::sort (collectors.begin (), collectors.end ());
     for (std::vector<CharacterOnLootTile>::iterator i = collectors.begin ();
@@ -1177,6 +1270,7 @@ void GameState::DivideLootAmongPlayers()
           {
             const CAmount rem = i->ch->CollectLoot (lootInfo, nHeight,
                                                     i->carryCap);
+            coinTotals.carriedLoot += lootInfo.nAmount - rem;
             AddLoot (coord, rem - lootInfo.nAmount);
           }
       }
@@ -1188,7 +1282,7 @@ void GameState::UpdateCrownState(bool &respawn_crown)
     if (crownHolder.player.empty())
         return;
 
-    std::map<PlayerID, PlayerState>::const_iterator mi = players.find(crownHolder.player);
+    PlayerStateMap::const_iterator mi = players.find(crownHolder.player);
     if (mi == players.end())
     {
         // Player is dead, drop the crown
@@ -1196,8 +1290,8 @@ void GameState::UpdateCrownState(bool &respawn_crown)
         return;
     }
 
-    const PlayerState &pl = mi->second;
-    std::map<int, CharacterState>::const_iterator mi2 = pl.characters.find(crownHolder.index);
+    const PlayerState &pl = *mi->second;
+    CharacterMap::const_iterator mi2 = pl.characters.find(crownHolder.index);
     if (mi2 == pl.characters.end())
     {
         // Character is dead, drop the crown
@@ -1223,13 +1317,14 @@ GameState::CrownBonus (CAmount nAmount)
 {
   if (!crownHolder.player.empty ())
     {
-      PlayerState& p = players[crownHolder.player];
+      PlayerState& p = players[crownHolder.player].Modify ();
       CharacterState& ch = p.characters[crownHolder.index];
 
       const LootInfo crownLoot(nAmount, nHeight);
       const CAmount cap = GetCarryingCapacity (*this, crownHolder.index == 0,
                                                true);
       const CAmount rem = ch.CollectLoot (crownLoot, nHeight, cap);
+      coinTotals.carriedLoot += nAmount - rem;
 
       /* We keep to the logic of "crown on the floor -> game fund" and
          don't distribute coins that can not be hold by the crown holder
@@ -1253,42 +1348,130 @@ GameState::IsBank (const Coord& c) const
   return banks.count (c) > 0;
 }
 
-CAmount
-GameState::GetCoinsOnMap () const
+void
+CoinTotals::AddPlayer (const PlayerState& pl, const int sign)
 {
-  CAmount onMap = 0;
+  playerValues += sign * pl.value;
+  for (const auto& pc : pl.characters)
+    carriedLoot += sign * pc.second.loot.nAmount;
+}
+
+CoinTotals
+GameState::ScanCoinTotals () const
+{
+  CoinTotals res;
   for (const auto& l : loot)
-    onMap += l.second.nAmount;
+    res.lootOnMap += l.second.nAmount;
   for (const auto& p : players)
-    {
-      onMap += p.second.value;
-      for (const auto& pc : p.second.characters)
-        onMap += pc.second.loot.nAmount;
-    }
+    res.AddPlayer (*p.second);
+
+  return res;
+}
+
+void
+GameState::RecomputeCoinTotals ()
+{
+  coinTotals = ScanCoinTotals ();
+  nCoinTotalsScanned = nHeight;
+}
+
+bool
+GameState::NeedsCoinTotalsScan () const
+{
+  return fCheckGameCoins || nCoinTotalsScanned < 0
+          || nHeight >= nCoinTotalsScanned + COIN_TOTALS_SCAN_INTERVAL;
+}
+
+namespace
+{
 
-  return onMap;
+/* Heap memory of a string.  Short strings are stored inline in the
+   string object itself by the standard library.  */
+size_t
+StringUsage (const std::string& str)
+{
+  const char* begin = reinterpret_cast<const char*> (&str);
+  if (str.data () >= begin && str.data () < begin + sizeof (str))
+    return 0;
+  return memusage::MallocUsage (str.capacity () + 1);
+}
+
+} // anonymous namespace
+
+size_t
+RecursiveDynamicUsage (const CharacterState& c)
+{
+  return memusage::DynamicUsage (c.waypoints);
+}
+
+size_t
+RecursiveDynamicUsage (const PlayerState& p)
+{
+  size_t mem = p.characters.DynamicUsage ();
+  for (const auto& pc : p.characters)
+    mem += RecursiveDynamicUsage (pc.second);
+
+  mem += StringUsage (p.message);
+  mem += StringUsage (p.address);
+  mem += StringUsage (p.addressLock);
+
+  return mem;
+}
+
+size_t
+RecursiveDynamicUsage (const GameState& state, const bool withPlayers)
+{
+  size_t mem = memusage::DynamicUsage (state.players);
+  if (withPlayers)
+    for (const auto& p : state.players)
+      mem += p.second.DynamicUsage () + RecursiveDynamicUsage (*p.second);
+
+  mem += memusage::DynamicUsage (state.dead_players_chat);
+  for (const auto& p : state.dead_players_chat)
+    mem += RecursiveDynamicUsage (p.second);
+
+  mem += memusage::DynamicUsage (state.loot);
+  mem += memusage::DynamicUsage (state.hearts);
+  mem += memusage::DynamicUsage (state.banks);
+
+  return mem;
 }
 
 void GameState::CollectHearts(RandomGenerator &rnd)
 {
-    std::map<Coord, std::vector<PlayerState*> > playersOnHeartTile;
-    for (std::map<PlayerID, PlayerState>::iterator mi = players.begin(); mi != players.end(); mi++)
+    /* Hearts are no longer created after the life-steal fork, so there
+       is usually nothing to do here.  */
+    if (hearts.empty())
+        return;
+
+    /* Index the characters of players that can collect hearts by tile.  The
+       player is added once per character on a heart tile, matching the
+       original implementation.  */
+    TileIndex<CowPtr<PlayerState>*> playersOnTiles;
+    for (PlayerStateMap::iterator mi = players.begin(); mi != players.end(); mi++)
     {
-        PlayerState *pl = &mi->second;
-        if (!pl->CanSpawnCharacter())
+        CowPtr<PlayerState> *pl = &mi->second;
+        if (!(*pl)->CanSpawnCharacter())
             continue;
-        for (const auto& pc : pl->characters)
-          {
-            const CharacterState &ch = pc.second;
-
-            if (hearts.count(ch.coord))
-                playersOnHeartTile[ch.coord].push_back(pl);
-          }
+        for (const auto& pc : (*pl)->characters)
+            if (hearts.count(pc.second.coord))
+                playersOnTiles.Add(pc.second.coord, pl);
     }
-    for (std::map<Coord, std::vector<PlayerState*> >::iterator mi = playersOnHeartTile.begin(); mi != playersOnHeartTile.end(); mi++)
+    if (playersOnTiles.empty())
+        return;
+    playersOnTiles.Finalise();
+
+    /* Process the heart tiles in order.  Hearts that are collected are
+       erased from the set, so advance the iterator before that.  */
+    for (std::set<Coord>::iterator hi = hearts.begin(); hi != hearts.end(); )
     {
-        const Coord &c = mi->first;
-        std::vector<PlayerState*> &v = mi->second;
+        const Coord c = *hi++;
+
+        std::vector<CowPtr<PlayerState>*> v;
+        const auto range = playersOnTiles.EqualRange(c);
+        for (auto it = range.first; it != range.second; ++it)
+            v.push_back(it->second);
+
         int n = v.size();
         int i;
         for (;;)
@@ -1299,14 +1482,14 @@ void GameState::CollectHearts(RandomGenerator &rnd)
                 break;
             }
             i = n == 1 ? 0 : rnd.GetIntRnd(n);
-            if (v[i]->CanSpawnCharacter())
+            if ((*v[i])->CanSpawnCharacter())
                 break;
             v.erase(v.begin() + i);
             n--;
         }
         if (i >= 0)
         {
-            v[i]->SpawnCharacter(*this, rnd);
+            v[i]->Modify().SpawnCharacter(*this, rnd);
             hearts.erase(c);
         }
     }
@@ -1329,7 +1512,7 @@ void GameState::CollectCrown(RandomGenerator &rnd, bool respawn_crown)
 
     std::vector<CharacterID> charactersOnCrownTile;
     for (const auto& pl : players)
-      for (const auto& pc : pl.second.characters)
+      for (const auto& pc : pl.second->characters)
         if (pc.second.coord == crownPos)
           charactersOnCrownTile.push_back(CharacterID(pl.first, pc.first));
     int n = charactersOnCrownTile.size();
@@ -1378,13 +1561,19 @@ GameState::HandleKilledLoot (const PlayerID& pId, int chInd,
 {
   const PlayerStateMap::const_iterator mip = players.find (pId);
   assert (mip != players.end ());
-  const PlayerState& pc = mip->second;
+  const PlayerState& pc = *mip->second;
   assert (pc.value >= 0);
-  const std::map<int, CharacterState>::const_iterator mic
+  const CharacterMap::const_iterator mic
     = pc.characters.find (chInd);
   assert (mic != pc.characters.end ());
   const CharacterState& ch = mic->second;
 
+  /* The character (and with the general also the player) is removed
+     from the state by the caller.  */
+  coinTotals.carriedLoot -= ch.loot.nAmount;
+  if (chInd == 0)
+    coinTotals.playerValues -= pc.value;
+
   /* If refunding is possible, do this for the locked amount right now.
      Later on, exclude the amount from further considerations.  */
   bool refunded = false;
@@ -1441,7 +1630,7 @@ GameState::FinaliseKills (StepResult& step)
   /* Kill depending characters.  */
   for (const auto& victim : killedPlayers)
     {
-      const PlayerState& victimState = players.find (victim)->second;
+      const PlayerState& victimState = *players.find (victim)->second;
 
       /* Take a look at the killed info to determine flags for handling
          the player loot.  */
@@ -1483,63 +1672,74 @@ GameState::KillSpawnArea (StepResult& step)
 {
   /* Even if spawn death is disabled after the corresponding softfork,
      we still want to do the loop (but not actually kill players)
-     because it keeps stay_in_spawn_area up-to-date.  */
+     because it keeps stay_in_spawn_area up-to-date.
+
+     The updates are collected first and only applied to players
+     that are actually changed, so that unchanged player states
+     remain shared with the previous game state.  */
 
   for (auto& p : players)
     {
+      std::map<int, unsigned char> stayUpdates;
       std::set<int> toErase;
-      for (auto& pc : p.second.characters)
+      for (const auto& pc : p.second->characters)
         {
           const int i = pc.first;
-          CharacterState &ch = pc.second;
+          const CharacterState &ch = pc.second;
+          unsigned char stay = ch.stay_in_spawn_area;
+          bool kill;
 
           // process logout timer
           if (ForkInEffect (FORK_TIMESAVE))
           {
               if (IsBank (ch.coord))
               {
-                  ch.stay_in_spawn_area = CHARACTER_MODE_LOGOUT; // hunters will never be on bank tile while in spectator mode
+                  stay = CHARACTER_MODE_LOGOUT; // hunters will never be on bank tile while in spectator mode
               }
               else if (SpawnMap[ch.coord.y][ch.coord.x] & SPAWNMAPFLAG_PLAYER)
               {
-                  if (CharacterSpawnProtectionAlmostFinished(ch.stay_in_spawn_area))
+                  if (CharacterSpawnProtectionAlmostFinished(stay))
                   {
                       // enter spectator mode if standing still
                       // notes : - movement will put the hunter in normal mode (when movement is processed)
                       //         - right now (in KillSpawnArea) waypoint updates are not yet applied for current block,
                       //           i.e. (ch.waypoints.empty()) is always true
-                      ch.stay_in_spawn_area = CHARACTER_MODE_SPECTATOR_BEGIN;
+                      stay = CHARACTER_MODE_SPECTATOR_BEGIN;
                   }
                   else
                   {
                       // give new hunters 10 blocks more thinking time before ghosting ends
-                      if ((nHeight % 500 < 490) || (ch.stay_in_spawn_area > 0))
-                          ch.stay_in_spawn_area++;
+                      if ((nHeight % 500 < 490) || (stay > 0))
+                          stay++;
                   }
               }
-              else if (CharacterIsProtected(ch.stay_in_spawn_area)) // catch all (for hunters who spawned pre-fork)
+              else if (CharacterIsProtected(stay)) // catch all (for hunters who spawned pre-fork)
               {
-                  ch.stay_in_spawn_area++;
+                  stay++;
               }
 
-              if (CharacterNoLogout(ch.stay_in_spawn_area))
-                  continue;
+              kill = !CharacterNoLogout(stay);
           }
           else // pre-fork
           {
               if (!IsBank (ch.coord))
                 {
-                  ch.stay_in_spawn_area = 0;
-                  continue;
+                  stay = 0;
+                  kill = false;
+                }
+              else
+                {
+                  /* Make sure to increment the counter in every case.  */
+                  const int maxStay = MaxStayOnBank (*this);
+                  kill = !(stay++ < maxStay || maxStay == -1);
                 }
-
-              /* Make sure to increment the counter in every case.  */
-              assert (IsBank (ch.coord));
-              const int maxStay = MaxStayOnBank (*this);
-              if (ch.stay_in_spawn_area++ < maxStay || maxStay == -1)
-                continue;
           }
 
+          if (stay != ch.stay_in_spawn_area)
+            stayUpdates.insert (std::make_pair (i, stay));
+          if (!kill)
+            continue;
+
           /* Handle the character's loot and kill the player.  */
           const KilledByInfo killer(KilledByInfo::KILLED_SPAWN);
           HandleKilledLoot (p.first, i, killer, step);
@@ -1550,8 +1750,15 @@ GameState::KillSpawnArea (StepResult& step)
              iterator 'pc'.  */
           toErase.insert(i);
         }
+
+      if (stayUpdates.empty () && toErase.empty ())
+        continue;
+
+      PlayerState& pl = p.second.Modify ();
+      for (const auto& upd : stayUpdates)
+        pl.characters[upd.first].stay_in_spawn_area = upd.second;
       for (const int i : toErase)
-        p.second.characters.erase(i);
+        pl.characters.erase(i);
     }
 }
 
@@ -1565,9 +1772,10 @@ GameState::ApplyDisaster (RandomGenerator& rng)
          are not yet poisoned.  Check this.  In case we introduce a general
          expiry, this can be changed accordingly -- but make sure that
          poisoning doesn't actually *increase* the life expectation.  */
-      assert (p.second.remainingLife == -1);
+      assert (p.second->remainingLife == -1);
 
-      p.second.remainingLife = rng.GetIntRnd (POISON_MIN_LIFE, POISON_MAX_LIFE);
+      p.second.Modify ().remainingLife
+        = rng.GetIntRnd (POISON_MIN_LIFE, POISON_MAX_LIFE);
     }
 
   /* Remove all hearts from the map.  */
@@ -1583,13 +1791,14 @@ GameState::DecrementLife (StepResult& step)
 {
   for (auto& p : players)
     {
-      if (p.second.remainingLife == -1)
+      if (p.second->remainingLife == -1)
         continue;
 
-      assert (p.second.remainingLife > 0);
-      --p.second.remainingLife;
+      PlayerState& pl = p.second.Modify ();
+      assert (pl.remainingLife > 0);
+      --pl.remainingLife;
 
-      if (p.second.remainingLife == 0)
+      if (pl.remainingLife == 0)
         {
           const KilledByInfo killer(KilledByInfo::KILLED_POISON);
           step.KillPlayer (p.first, killer);
@@ -1609,7 +1818,7 @@ GameState::RemoveHeartedCharacters (StepResult& step)
   for (auto& p : players)
     {
       std::set<int> toErase;
-      for (const auto& pc : p.second.characters)
+      for (const auto& pc : p.second->characters)
         {
           const int i = pc.first;
           if (i == 0)
@@ -1622,8 +1831,12 @@ GameState::RemoveHeartedCharacters (StepResult& step)
              iterator 'pc'.  */
           toErase.insert (i);
         }
+      if (toErase.empty ())
+        continue;
+
+      PlayerState& pl = p.second.Modify ();
       for (const int i : toErase)
-        p.second.characters.erase (i);
+        pl.characters.erase (i);
     }
 }
 
@@ -1668,62 +1881,29 @@ GameState::UpdateBanks (RandomGenerator& rng)
   assert (newBanks.size () <= DYNBANKS_NUM_BANKS);
 
   // less possible bank spawn tiles
-  if (ForkInEffect (FORK_TIMESAVE))
-  {
-    FillWalkableTiles ();
-    std::set<Coord> optionsSet(walkableTiles_ts_banks.begin (), walkableTiles_ts_banks.end ());
-    for (const auto& b : newBanks)
-    {
-      assert (optionsSet.count (b.first) == 1);
-      optionsSet.erase (b.first);
-    }
-    assert (optionsSet.size () + newBanks.size () == walkableTiles_ts_banks.size ());
+  const WalkableTiles& walkable = WalkableTiles::Get ();
+  const std::vector<Coord>& tiles
+    = (ForkInEffect (FORK_TIMESAVE) ? walkable.tsBanks : walkable.all);
 
-    std::vector<Coord> options(optionsSet.begin (), optionsSet.end ());
-    for (unsigned cnt = newBanks.size (); cnt < DYNBANKS_NUM_BANKS; ++cnt)
+  AvailableTiles options(tiles);
+  for (const auto& b : newBanks)
+    options.Exclude (b.first);
+  assert (options.size () + newBanks.size () == tiles.size ());
+
+  for (unsigned cnt = newBanks.size (); cnt < DYNBANKS_NUM_BANKS; ++cnt)
     {
       const int ind = rng.GetIntRnd (options.size ());
       const int life = rng.GetIntRnd (DYNBANKS_MIN_LIFE, DYNBANKS_MAX_LIFE);
-      const Coord& c = options[ind];
-
-      assert (newBanks.count (c) == 0);
-      newBanks.insert (std::make_pair (c, life));
 
       /* Do not use a silly trick like swapping in the last element.
-         We want to keep the array ordered at all times.  The order is
+         We want to keep the options ordered at all times.  The order is
          important with respect to consensus, and this makes the consensus
          protocol "clearer" to describe.  */
-      options.erase (options.begin () + ind);
-    }
-  }
-  else // pre-fork
-  {
-    FillWalkableTiles ();
-    std::set<Coord> optionsSet(walkableTiles.begin (), walkableTiles.end ());
-    for (const auto& b : newBanks)
-    {
-      assert (optionsSet.count (b.first) == 1);
-      optionsSet.erase (b.first);
-    }
-    assert (optionsSet.size () + newBanks.size () == walkableTiles.size ());
-
-    std::vector<Coord> options(optionsSet.begin (), optionsSet.end ());
-    for (unsigned cnt = newBanks.size (); cnt < DYNBANKS_NUM_BANKS; ++cnt)
-    {
-      const int ind = rng.GetIntRnd (options.size ());
-      const int life = rng.GetIntRnd (DYNBANKS_MIN_LIFE, DYNBANKS_MAX_LIFE);
-      const Coord& c = options[ind];
+      const Coord& c = options.Take (ind);
 
       assert (newBanks.count (c) == 0);
       newBanks.insert (std::make_pair (c, life));
-
-      /* Do not use a silly trick like swapping in the last element.
-         We want to keep the array ordered at all times.  The order is
-         important with respect to consensus, and this makes the consensus
-         protocol "clearer" to describe.  */
-      options.erase (options.begin () + ind);
     }
-  }
 
   banks.swap (newBanks);
   assert (banks.size () == DYNBANKS_NUM_BANKS);
@@ -1739,7 +1919,7 @@ CollectedBounty::UpdateAddress (const GameState& state)
   if (i == state.players.end ())
     return;
 
-  address = i->second.address;
+  address = i->second->address;
 }
 
 bool PerformStep(const GameState &inState, const StepData &stepData, GameState &outState, StepResult &stepResult)
@@ -1768,11 +1948,12 @@ bool PerformStep(const GameState &inState, const StepData &stepData, GameState &
         {
           const PlayerStateMap::iterator mi = outState.players.find (m.player);
           assert (mi != outState.players.end ());
-          assert (m.newLocked >= mi->second.lockedCoins);
-          const CAmount newFee = m.newLocked - mi->second.lockedCoins;
+          PlayerState& pl = mi->second.Modify ();
+          assert (m.newLocked >= pl.lockedCoins);
+          const CAmount newFee = m.newLocked - pl.lockedCoins;
           outState.gameFund += newFee;
           moneyIn += newFee;
-          mi->second.lockedCoins = m.newLocked;
+          pl.lockedCoins = m.newLocked;
         }
       else
         moneyIn += m.newLocked;
@@ -1807,9 +1988,23 @@ bool PerformStep(const GameState &inState, const StepData &stepData, GameState &
         if (!m.IsSpawn())
             m.ApplyWaypoints(outState);
 
-    // For all alive players perform path-finding
+    /* For all alive players perform path-finding.  Characters that are
+       standing still are not changed by this, so we skip players without
+       moving characters in order to keep their state shared.  */
     for (auto& p : outState.players)
-      for (auto& pc : p.second.characters)
+      {
+        bool moving = false;
+        for (const auto& pc : p.second->characters)
+          if (!pc.second.waypoints.empty ()
+                || pc.second.from != pc.second.coord)
+            {
+              moving = true;
+              break;
+            }
+        if (!moving)
+          continue;
+
+        for (auto& pc : p.second.Modify ().characters)
         {
             // can't move in spectator mode, moving will lose spawn protection
             if ((outState.ForkInEffect (FORK_TIMESAVE)) &&
@@ -1822,6 +2017,7 @@ bool PerformStep(const GameState &inState, const StepData &stepData, GameState &
             }
             pc.second.MoveTowardsWaypoint();
         }
+      }
 
     bool respawn_crown = false;
     outState.UpdateCrownState(respawn_crown);
@@ -1831,25 +2027,37 @@ bool PerformStep(const GameState &inState, const StepData &stepData, GameState &
 
     // Banking
     for (auto& p : outState.players)
-      for (auto& pc : p.second.characters)
-        {
-            int i = pc.first;
-            CharacterState &ch = pc.second;
+      {
+        std::vector<int> banking;
+        for (const auto& pc : p.second->characters)
+          {
+            const CharacterState &ch = pc.second;
 
             // player spawn tiles work like banks (for the purpose of banking)
             if (((ch.loot.nAmount > 0) && (outState.IsBank (ch.coord))) ||
                 ((outState.ForkInEffect (FORK_TIMESAVE)) && (ch.loot.nAmount > 0) && (IsInsideMap(ch.coord.x, ch.coord.y)) && (SpawnMap[ch.coord.y][ch.coord.x] & SPAWNMAPFLAG_PLAYER)))
-            {
-                // Tax from banking: 10%
-                CAmount nTax = ch.loot.nAmount / 10;
-                stepResult.nTaxAmount += nTax;
-                ch.loot.nAmount -= nTax;
-
-                CollectedBounty b(p.first, i, ch.loot, p.second.address);
-                stepResult.bounties.push_back (b);
-                ch.loot = CollectedLootInfo();
-            }
+                banking.push_back (pc.first);
+          }
+        if (banking.empty ())
+          continue;
+
+        PlayerState &pl = p.second.Modify ();
+        for (const int i : banking)
+        {
+            CharacterState &ch = pl.characters[i];
+
+            outState.coinTotals.carriedLoot -= ch.loot.nAmount;
+
+            // Tax from banking: 10%
+            CAmount nTax = ch.loot.nAmount / 10;
+            stepResult.nTaxAmount += nTax;
+            ch.loot.nAmount -= nTax;
+
+            CollectedBounty b(p.first, i, ch.loot, pl.address);
+            stepResult.bounties.push_back (b);
+            ch.loot = CollectedLootInfo();
         }
+      }
 
     // Miners set hashBlock to 0 in order to compute tax and include it into the coinbase.
     // At this point the tax is fully computed, so we can return.
@@ -1894,9 +2102,9 @@ bool PerformStep(const GameState &inState, const StepData &stepData, GameState &
     // Set colors for dead players, so their messages can be shown in the chat window
     for (auto& p : outState.dead_players_chat)
       {
-        std::map<PlayerID, PlayerState>::const_iterator mi = inState.players.find(p.first);
+        PlayerStateMap::const_iterator mi = inState.players.find(p.first);
         assert(mi != inState.players.end());
-        const PlayerState &pl = mi->second;
+        const PlayerState &pl = *mi->second;
         p.second.color = pl.color;
       }
 
@@ -1929,7 +2137,7 @@ bool PerformStep(const GameState &inState, const StepData &stepData, GameState &
     {
         assert (!outState.ForkInEffect (FORK_LIFESTEAL));
 
-        Coord heart;
+        Coord heart(0, 0);
         do
         {
             heart.x = rnd.GetIntRnd(MAP_WIDTH);
@@ -1947,11 +2155,42 @@ bool PerformStep(const GameState &inState, const StepData &stepData, GameState &
       moneyOut += b.loot.nAmount;
 
     /* Compare total money before and after the step.  If there is a mismatch,
-       we have a bug in the logic.  Better not accept the new game state.  */
-    const CAmount moneyBefore = inState.GetCoinsOnMap () + inState.gameFund;
-    const CAmount moneyAfter = outState.GetCoinsOnMap () + outState.gameFund;
-    if (moneyBefore + stepData.nTreasureAmount + moneyIn
-          != moneyAfter + moneyOut)
+       we have a bug in the logic.  Better not accept the new game state.
+
+       This uses the running coin totals.  They are only a cache of the
+       full scan, though.  The scan is done periodically (always with
+       fCheckGameCoins), and whenever the totals do not balance, so that an
+       accounting mistake cannot cause a valid step to be rejected.  If the
+       totals differ from the scan, they are replaced by it.  The difference
+       is only an error with fCheckGameCoins, which is a debugging aid.  */
+    CAmount moneyBefore = inState.GetCoinsOnMap () + inState.gameFund;
+    CAmount moneyAfter = outState.GetCoinsOnMap () + outState.gameFund;
+    bool balanced = (moneyBefore + stepData.nTreasureAmount + moneyIn
+                      == moneyAfter + moneyOut);
+    if (!balanced || inState.NeedsCoinTotalsScan ())
+      {
+        const CoinTotals scanBefore = inState.ScanCoinTotals ();
+        const CoinTotals scanAfter = outState.ScanCoinTotals ();
+        if (scanBefore != inState.coinTotals
+              || scanAfter != outState.coinTotals)
+          {
+            LogPrintf ("Coin totals before: %ld, scanned: %ld (@%d)\n",
+                       inState.coinTotals.Total (), scanBefore.Total (),
+                       inState.nHeight);
+            LogPrintf ("Coin totals after: %ld, scanned: %ld\n",
+                       outState.coinTotals.Total (), scanAfter.Total ());
+            if (fCheckGameCoins)
+              return error ("running coin totals do not match the game state");
+            outState.coinTotals = scanAfter;
+          }
+        outState.nCoinTotalsScanned = outState.nHeight;
+
+        moneyBefore = scanBefore.Total () + inState.gameFund;
+        moneyAfter = scanAfter.Total () + outState.gameFund;
+        balanced = (moneyBefore + stepData.nTreasureAmount + moneyIn
+                      == moneyAfter + moneyOut);
+      }
+    if (!balanced)
       {
         LogPrintf ("Old game state: %ld (@%d)\n", moneyBefore, inState.nHeight);
         LogPrintf ("New game state: %ld\n", moneyAfter);
@@ -19,11 +19,14 @@
 #include <amount.h>
 #include <consensus/params.h>
 #include <game/common.h>
+#include <game/tiles.h>
 #include <uint256.h>
 #include <serialize.h>
 
 #include <univalue.h>
 
+class JsonWriter;
+
 #include <cmath>
 #include <map>
 #include <string>
@@ -83,8 +86,12 @@ struct AttackableCharacter
 struct CharactersOnTiles
 {
 
-  /** The map type used.  */
-  typedef std::multimap<Coord, AttackableCharacter> Map;
+  /**
+   * The map type used.  It is a dense index over the map, so that the
+   * tiles in the destruct radius can be looked up directly.  Iteration is
+   * in the same order as for a multimap keyed by the coordinate.
+   */
+  typedef TileIndex<AttackableCharacter> Map;
 
   /** The actual map.  */
   Map tiles;
@@ -293,7 +300,7 @@ struct CharacterState
     }
 
     void MoveTowardsWaypoint();
-    WaypointVector DumpPath(const WaypointVector *alternative_waypoints = NULL) const;
+    std::vector<Coord> DumpPath(const WaypointVector *alternative_waypoints = NULL) const;
 
     /**
      * Calculate total length (in the same L-infinity sense that gives the
@@ -308,9 +315,12 @@ struct CharacterState
        loot amount that *remains* will be returned.  */
     CAmount CollectLoot (LootInfo newLoot, int nHeight, CAmount carryCap);
 
-    UniValue ToJsonValue(bool has_crown) const;
+    void WriteJson(JsonWriter& out, bool has_crown) const;
 };
 
+/* Characters of a player by index.  */
+typedef FlatMap<int, CharacterState> CharacterMap;
+
 struct PlayerState
 {
     /* Colour represents player team.  */
@@ -325,7 +335,7 @@ struct PlayerState
     /* Actual value of the general in the game state.  */
     CAmount value;
 
-    std::map<int, CharacterState> characters;   // Characters owned by the player (0 is the main character)
+    CharacterMap characters;                    // Characters owned by the player (0 is the main character)
     int next_character_index;                   // Index of the next spawned character
 
     /* Number of blocks the player still lives if poisoned.  If it is 1,
@@ -364,7 +374,58 @@ struct PlayerState
 
     void SpawnCharacter(const GameState& state, RandomGenerator &rnd);
     bool CanSpawnCharacter() const;
-    UniValue ToJsonValue(int crown_index, bool dead = false) const;
+    void WriteJson(JsonWriter& out, int crown_index, bool dead = false) const;
+};
+
+/* Enable the full-scan cross check of the running coin totals.  */
+extern bool fCheckGameCoins;
+
+/* Even without fCheckGameCoins, the running coin totals are verified against
+   a full scan at least this often (in blocks).  */
+static const int COIN_TOTALS_SCAN_INTERVAL = 100;
+
+/**
+ * Totals of the coins in the game world (apart from the game fund).  They
+ * are kept up-to-date by GameState as the game logic moves coins around,
+ * so that the money-conservation check at the end of each step does not need
+ * to walk all players and characters.
+ */
+struct CoinTotals
+{
+
+  /** Loot lying on the map.  */
+  CAmount lootOnMap;
+  /** Loot carried by characters.  */
+  CAmount carriedLoot;
+  /** Values of all players.  */
+  CAmount playerValues;
+
+  CoinTotals ()
+    : lootOnMap(0), carriedLoot(0), playerValues(0)
+  {}
+
+  inline CAmount
+  Total () const
+  {
+    return lootOnMap + carriedLoot + playerValues;
+  }
+
+  /** Add (or remove, if sign is negative) the coins held by a player.  */
+  void AddPlayer (const PlayerState& pl, int sign = 1);
+
+  friend inline bool
+  operator== (const CoinTotals& a, const CoinTotals& b)
+  {
+    return a.lootOnMap == b.lootOnMap && a.carriedLoot == b.carriedLoot
+            && a.playerValues == b.playerValues;
+  }
+
+  friend inline bool
+  operator!= (const CoinTotals& a, const CoinTotals& b)
+  {
+    return !(a == b);
+  }
+
 };
 
 struct GameState
@@ -413,6 +474,16 @@ struct GameState
     /* TODO: Can we get rid of this?  */
     uint256 hashBlock;
 
+    /* Running totals of the coins on the map.  They are not serialised,
+       but recomputed when the state is read.  Code that modifies players
+       or loot directly (instead of through the game logic) has to call
+       RecomputeCoinTotals afterwards.  */
+    CoinTotals coinTotals;
+
+    /* Height (as per nHeight) at which coinTotals were last verified
+       against a full scan, or -1 if they never were.  Not serialised.  */
+    int nCoinTotalsScanned;
+
     ADD_SERIALIZE_METHODS;
 
     template<typename Stream, typename Operation>
@@ -432,9 +503,13 @@ struct GameState
       READWRITE (nHeight);
       READWRITE (nDisasterHeight);
       READWRITE (hashBlock);
+
+      if (ser_action.ForRead ())
+        RecomputeCoinTotals ();
     }
     
-    UniValue ToJsonValue() const;
+    /* Write the JSON representation, as returned by game_getstate.  */
+    void WriteJson(JsonWriter& out) const;
 
     inline bool
     ForkInEffect (Fork type) const
@@ -503,11 +578,34 @@ struct GameState
     void UpdateBanks (RandomGenerator& rng);
 
     /* Return total amount of coins on the map (in loot and hold by players,
-       including also general values).  */
-    CAmount GetCoinsOnMap () const;
+       including also general values).  This uses the running totals.  */
+    inline CAmount
+    GetCoinsOnMap () const
+    {
+      return coinTotals.Total ();
+    }
+
+    /* Compute the coin totals by walking the full state.  */
+    CoinTotals ScanCoinTotals () const;
+
+    /* Reset the running totals to the result of a full scan.  */
+    void RecomputeCoinTotals ();
+
+    /* Check whether the running totals have to be verified by a full scan
+       before a step from this state is accepted.  */
+    bool NeedsCoinTotalsScan () const;
 
 };
 
+/* Estimate the heap memory used by game state data, in the same way as
+   RecursiveDynamicUsage in core_memusage.h.  Player states are shared
+   between game states through CowPtr.  If withPlayers is false, they are
+   left out of the game state's usage (except for the map nodes), so that
+   callers can count each shared player state only once.  */
+size_t RecursiveDynamicUsage (const CharacterState& c);
+size_t RecursiveDynamicUsage (const PlayerState& p);
+size_t RecursiveDynamicUsage (const GameState& state, bool withPlayers = true);
+
 /* Encode data for a banked bounty.  This includes also the payment address
    as per the player state (may be empty if no explicit address is set), so
    that the reward-paying game tx can be constructed even if the player
@@ -0,0 +1,60 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <game/tiles.h>
+
+#include <algorithm>
+#include <cassert>
+
+void
+AvailableTiles::ExcludeIndex (const unsigned index, const size_t pos)
+{
+  assert (index < tiles.size ());
+  assert (pos <= excluded.size ());
+  assert (pos == 0 || excluded[pos - 1] < index);
+  assert (pos == excluded.size () || excluded[pos] > index);
+
+  excluded.insert (excluded.begin () + pos, index);
+}
+
+void
+AvailableTiles::Exclude (const Coord& c)
+{
+  const std::vector<Coord>::const_iterator it
+    = std::lower_bound (tiles.begin (), tiles.end (), c);
+  assert (it != tiles.end () && *it == c);
+
+  const unsigned index = it - tiles.begin ();
+  const std::vector<unsigned>::iterator pos
+    = std::lower_bound (excluded.begin (), excluded.end (), index);
+  ExcludeIndex (index, pos - excluded.begin ());
+}
+
+const Coord&
+AvailableTiles::Take (const unsigned k)
+{
+  assert (k < size ());
+
+  /* Every excluded index up to the current candidate shifts the k-th
+     available tile by one.  Since the excluded indices are sorted, a single
+     pass over them is enough.  */
+  unsigned index = k;
+  size_t pos = 0;
+  for (; pos < excluded.size () && excluded[pos] <= index; ++pos)
+    ++index;
+
+  ExcludeIndex (index, pos);
+  return tiles[index];
+}
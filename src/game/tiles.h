@@ -0,0 +1,238 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GAME_TILES_H
+#define GAME_TILES_H
+
+#include <game/common.h>
+#include <game/map.h>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+/**
+ * Random selection of tiles from a fixed, sorted array (e. g., all walkable
+ * tiles), excluding those that are already in use.  The order of the
+ * remaining tiles is the one of the underlying array, which is important
+ * for consensus:  Selecting the k-th available tile gives the same result
+ * as erasing all excluded tiles from a copy of the array and indexing it.
+ *
+ * Only the (few) excluded tiles are stored, so that constructing an
+ * instance does not copy the full array.  Selecting or excluding a tile
+ * is linear in the number of excluded tiles.
+ */
+class AvailableTiles
+{
+
+private:
+
+  /** The underlying array of tiles.  It must be sorted.  */
+  const std::vector<Coord>& tiles;
+
+  /** Sorted indices into tiles that are excluded.  */
+  std::vector<unsigned> excluded;
+
+  /**
+   * Mark the given index as excluded.  It must not be excluded already.
+   * @param index The index into tiles.
+   * @param pos Position in excluded where it has to be inserted.
+   */
+  void ExcludeIndex (unsigned index, size_t pos);
+
+public:
+
+  explicit inline AvailableTiles (const std::vector<Coord>& t)
+    : tiles(t), excluded()
+  {}
+
+  AvailableTiles (const AvailableTiles&) = delete;
+  void operator= (const AvailableTiles&) = delete;
+
+  /** Return the number of tiles that are still available.  */
+  inline size_t
+  size () const
+  {
+    return tiles.size () - excluded.size ();
+  }
+
+  /**
+   * Exclude the given tile.  It must be part of the array and
+   * not yet excluded.
+   */
+  void Exclude (const Coord& c);
+
+  /**
+   * Return the k-th available tile (counting from zero) and exclude it.
+   */
+  const Coord& Take (unsigned k);
+
+};
+
+/**
+ * Index of values by the tile they are on, e. g. characters on the map.
+ * The values are stored in a flat array sorted by coordinate (in the order
+ * of Coord::operator<, and in insertion order for values on the same tile).
+ * In addition, the start of each tile's range in this array is kept in a
+ * dense array over the whole map.  Thus finding all values on a tile costs
+ * only the number of values on it, and iterating the index visits the values
+ * in the same order as a std::multimap keyed by the coordinate would.
+ *
+ * The index is filled with Add and then built once by calling Finalise.
+ */
+template<typename T>
+  class TileIndex
+{
+
+public:
+
+  typedef std::pair<Coord, T> Entry;
+  typedef typename std::vector<Entry>::iterator iterator;
+  typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+private:
+
+  /** The values with their coordinates.  */
+  std::vector<Entry> entries;
+
+  /**
+   * Index into entries of the first value on each tile, or -1 if there
+   * is none.  Empty until the index is finalised.
+   */
+  std::vector<int> heads;
+
+  static inline int
+  TileNumber (const Coord& c)
+  {
+    return c.y * MAP_WIDTH + c.x;
+  }
+
+  static inline bool
+  CompareCoord (const Entry& a, const Entry& b)
+  {
+    return a.first < b.first;
+  }
+
+  /**
+   * Find the positions in entries of the values on the given tile.
+   * @return The range as begin and end index into entries.
+   */
+  std::pair<size_t, size_t>
+  FindRange (const Coord& c) const
+  {
+    assert (heads.size () == MAP_WIDTH * MAP_HEIGHT);
+
+    if (!IsInsideMap (c.x, c.y))
+      return std::make_pair (entries.size (), entries.size ());
+
+    const int head = heads[TileNumber (c)];
+    if (head == -1)
+      return std::make_pair (entries.size (), entries.size ());
+
+    size_t last = head;
+    while (last < entries.size () && entries[last].first == c)
+      ++last;
+
+    return std::make_pair (static_cast<size_t> (head), last);
+  }
+
+public:
+
+  TileIndex ()
+    : entries(), heads()
+  {}
+
+  TileIndex (const TileIndex<T>&) = delete;
+  void operator= (const TileIndex<T>&) = delete;
+
+  /**
+   * Add a value.  This must be done before the index is finalised.
+   */
+  inline void
+  Add (const Coord& c, const T& val)
+  {
+    assert (heads.empty ());
+    assert (IsInsideMap (c.x, c.y));
+    entries.push_back (std::make_pair (c, val));
+  }
+
+  /**
+   * Sort the values and build the lookup table of tiles.
+   */
+  void
+  Finalise ()
+  {
+    assert (heads.empty ());
+    std::stable_sort (entries.begin (), entries.end (), &CompareCoord);
+
+    heads.assign (MAP_WIDTH * MAP_HEIGHT, -1);
+    for (int i = entries.size () - 1; i >= 0; --i)
+      heads[TileNumber (entries[i].first)] = i;
+  }
+
+  inline bool
+  empty () const
+  {
+    return entries.empty ();
+  }
+
+  inline iterator
+  begin ()
+  {
+    return entries.begin ();
+  }
+
+  inline iterator
+  end ()
+  {
+    return entries.end ();
+  }
+
+  inline const_iterator
+  begin () const
+  {
+    return entries.begin ();
+  }
+
+  inline const_iterator
+  end () const
+  {
+    return entries.end ();
+  }
+
+  /**
+   * Return the range of values on the given tile.  The coordinate may be
+   * outside of the map, in which case the range is empty.
+   */
+  inline std::pair<iterator, iterator>
+  EqualRange (const Coord& c)
+  {
+    const auto range = FindRange (c);
+    return std::make_pair (entries.begin () + range.first,
+                           entries.begin () + range.second);
+  }
+
+  inline std::pair<const_iterator, const_iterator>
+  EqualRange (const Coord& c) const
+  {
+    const auto range = FindRange (c);
+    return std::make_pair (entries.begin () + range.first,
+                           entries.begin () + range.second);
+  }
+
+};
+
+#endif // GAME_TILES_H
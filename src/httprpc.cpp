@@ -188,10 +188,16 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            strReply = JSONRPCRawReplyBegin();
+            const size_t nPrefix = strReply.size();
+            jreq.rawResult = &strReply;
             UniValue result = tableRPC.execute(jreq);
 
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Send reply, unless the method wrote its result into it already
+            if (strReply.size() > nPrefix)
+                JSONRPCRawReplyEnd(strReply, jreq.id);
+            else
+                strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
         // array of requests
         } else if (valRequest.isArray())
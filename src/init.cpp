@@ -18,6 +18,7 @@
 #include <consensus/validation.h>
 #include <fs.h>
 #include <game/db.h>
+#include <game/state.h>
 #include <httpserver.h>
 #include <httprpc.h>
 #include <key.h>
@@ -364,6 +365,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-debuglogfile=<file>", strprintf(_("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)"), DEFAULT_DEBUGLOGFILE));
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
+    strUsage += HelpMessageOpt("-gamedeltadepth=<n>", strprintf(_("Keep the game state deltas of the last <n> blocks on disk; older states are recomputed from the last snapshot (default: %d)"), DEFAULT_GAME_DELTA_DEPTH));
+    strUsage += HelpMessageOpt("-gamedbcache=<n>", strprintf(_("Set game state database cache size in megabytes (default: %d)"), DEFAULT_GAME_DB_CACHE));
+    strUsage += HelpMessageOpt("-gamesnapshotinterval=<n>", strprintf(_("Keep the full game state of every <n>th block on disk; other states are reconstructed from stored deltas (default: %d)"), DEFAULT_GAME_SNAPSHOT_INTERVAL));
+    strUsage += HelpMessageOpt("-gamestatecache=<n>", strprintf(_("Keep recently used game states in memory up to <n> megabytes; the states of the last few blocks are always kept (default: %d)"), DEFAULT_GAME_STATE_CACHE));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
@@ -386,7 +391,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt("-auxpowindex", strprintf(_("Store the auxpow of merge-mined headers in the block index, so that headers are served without reading block files (default: %u)"), DEFAULT_AUXPOWINDEX));
     strUsage += HelpMessageOpt("-namehistory", strprintf(_("Keep track of the full name history (default: %u)"), 0));
+    strUsage += HelpMessageOpt("-nameheightindex", strprintf(_("Maintain an index of names by their last update height, used by name_filter (default: %u)"), 0));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info)"));
@@ -436,6 +443,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubgamestatedelta=<address>", _("Enable publish game state delta in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -444,6 +452,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkgamecoins", strprintf("Verify the running coin totals of the game state with a full scan in every game step, not only every %d blocks, and reject the step on a mismatch (default: %u)", COIN_TOTALS_SCAN_INTERVAL, defaultChainParams->DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
         strUsage += HelpMessageOpt("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used");
@@ -1008,13 +1017,15 @@ bool AppInitParameterInteraction()
     if (gArgs.IsArgSet("-blockminsize"))
         InitWarning("Unsupported argument -blockminsize ignored.");
 
-    // Checkmempool and checkblockindex default to true in regtest mode
+    // Checkmempool, checkblockindex and checkgamecoins default to true in regtest mode
     int ratio = std::min<int>(std::max<int>(gArgs.GetArg("-checkmempool", chainparams.DefaultConsistencyChecks() ? 1 : 0), 0), 1000000);
     if (ratio != 0) {
         mempool.setSanityCheck(1.0 / ratio);
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
+    fCheckGameCoins = gArgs.GetBoolArg("-checkgamecoins", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fAuxpowIndex = gArgs.GetBoolArg("-auxpowindex", DEFAULT_AUXPOWINDEX);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1269,8 +1280,10 @@ bool AppInitMain()
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i=0; i<nScriptCheckThreads-1; i++)
+        for (int i=0; i<nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadHeaderCheck);
+        }
     }
 
     // Start the lightweight task scheduler thread
@@ -1438,6 +1451,18 @@ bool AppInitMain()
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
+    // game database cache sizes
+    const int64_t nGameDBCache = std::max<int64_t>(gArgs.GetArg("-gamedbcache", DEFAULT_GAME_DB_CACHE), 1) << 20;
+    const int64_t nGameStateCache = std::max<int64_t>(gArgs.GetArg("-gamestatecache", DEFAULT_GAME_STATE_CACHE), 0) << 20;
+    const int64_t nGameSnapshotInterval = gArgs.GetArg("-gamesnapshotinterval", DEFAULT_GAME_SNAPSHOT_INTERVAL);
+    if (nGameSnapshotInterval < 1 || nGameSnapshotInterval > std::numeric_limits<int>::max())
+        return InitError(strprintf(_("Invalid -gamesnapshotinterval: %d"), nGameSnapshotInterval));
+    const int64_t nGameDeltaDepth = gArgs.GetArg("-gamedeltadepth", DEFAULT_GAME_DELTA_DEPTH);
+    if (nGameDeltaDepth < 1 || nGameDeltaDepth > std::numeric_limits<int>::max())
+        return InitError(strprintf(_("Invalid -gamedeltadepth: %d"), nGameDeltaDepth));
+    LogPrintf("* Using %.1fMiB for game state database\n", nGameDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for in-memory game states\n", nGameStateCache * (1.0 / 1024 / 1024));
+
     bool fLoaded = false;
     while (!fLoaded && !fRequestShutdown) {
         bool fReset = fReindex;
@@ -1495,6 +1520,11 @@ bool AppInitMain()
                     strLoadError = _("You need to rebuild the database using -reindex to change -namehistory");
                     break;
                 }
+                // Check for changed -nameheightindex state
+                if (fNameHeightIndex != gArgs.GetBoolArg("-nameheightindex", false)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -nameheightindex");
+                    break;
+                }
 
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
@@ -1517,7 +1547,7 @@ bool AppInitMain()
 
                 pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
                 pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
-                pgameDb.reset(new CGameDB(false, fReindex));
+                pgameDb.reset(new CGameDB(nGameDBCache, nGameStateCache, nGameSnapshotInterval, nGameDeltaDepth, false, fReindex));
 
                 // If necessary, upgrade from older database format.
                 // This is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
@@ -100,6 +100,24 @@ void BlockAssembler::resetBlock()
     nFees = 0;
 }
 
+/**
+ * Game data of the last block template, reused by later templates on the
+ * same parent block.  Pools ask for new templates much more often than
+ * blocks are found or game moves arrive, so most templates can skip both
+ * loading the parent's game state and performing the game step (also when
+ * checking the template with TestBlockValidity).
+ *
+ * The parent's state is only referenced weakly, so that it is not kept in
+ * memory after the tip changed and the game DB has released it.
+ */
+static struct {
+    uint256 hashPrev;
+    std::weak_ptr<const GameState> prevState;
+    std::vector<uint256> moveTxids;
+    StepResult stepResult;
+    bool fHaveStep;
+} templateGameCache GUARDED_BY(cs_main);
+
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, const CScript& scriptPubKeyIn, bool fMineWitnessTx)
 {
     int64_t nTimeStart = GetTimeMicros();
@@ -122,10 +140,22 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, con
     assert(pindexPrev != nullptr);
     nHeight = pindexPrev->nHeight + 1;
 
-    prevGameState.reset(new GameState(chainparams.GetConsensus()));
-    if (!pgameDb->get(*pindexPrev->phashBlock, *prevGameState))
-        throw std::runtime_error(strprintf("%s: Failed to read prev game state", __func__));
+    if (templateGameCache.hashPrev != pindexPrev->GetBlockHash()) {
+        templateGameCache.hashPrev = pindexPrev->GetBlockHash();
+        templateGameCache.prevState.reset();
+        templateGameCache.moveTxids.clear();
+        templateGameCache.stepResult = StepResult();
+        templateGameCache.fHaveStep = false;
+    }
+    prevGameState = templateGameCache.prevState.lock();
+    if (!prevGameState) {
+        prevGameState = pgameDb->getSnapshot(*pindexPrev->phashBlock);
+        if (!prevGameState)
+            throw std::runtime_error(strprintf("%s: Failed to read prev game state", __func__));
+        templateGameCache.prevState = prevGameState;
+    }
     gameStep.reset(new StepData(*prevGameState));
+    gameMoveTxids.clear();
 
     const int32_t nChainId = chainparams.GetConsensus ().nAuxpowChainId[algo];
     // FIXME: Active version bits after the always-auxpow fork!
@@ -159,12 +189,8 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, con
 
     int64_t nTime1 = GetTimeMicros();
 
-    // Compute miner taxes from game step.
-    assert(gameStep->newHash.IsNull());
-    GameState newGameState(chainparams.GetConsensus());
-    StepResult stepResult;
-    if (!PerformStep(*prevGameState, *gameStep, newGameState, stepResult))
-        throw std::runtime_error(strprintf("%s: game engine failed to perform step", __func__));
+    const StepResult& gameStepResult = GetGameStepResult(pindexPrev->GetBlockHash());
+    const CAmount nTaxAmount = gameStepResult.nTaxAmount;
 
     nLastBlockTx = nBlockTx;
     nLastBlockWeight = nBlockWeight;
@@ -175,7 +201,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, con
     coinbaseTx.vin[0].prevout.SetNull();
     coinbaseTx.vout.resize(1);
     coinbaseTx.vout[0].scriptPubKey = scriptPubKeyIn;
-    coinbaseTx.vout[0].nValue = nFees + stepResult.nTaxAmount + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
+    coinbaseTx.vout[0].nValue = nFees + nTaxAmount + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
     coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
     pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
     pblocktemplate->vchCoinbaseCommitment = GenerateCoinbaseCommitment(*pblock, pindexPrev, chainparams.GetConsensus());
@@ -190,8 +216,10 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, con
     pblock->nNonce         = 0;
     pblocktemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*pblock->vtx[0]);
 
+    // The moves were checked against the parent's game state when adding
+    // them, so the game step need not be performed again.
     CValidationState state;
-    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false, &gameStepResult)) {
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
     }
     int64_t nTime2 = GetTimeMicros();
@@ -201,6 +229,29 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(PowAlgo algo, con
     return std::move(pblocktemplate);
 }
 
+const StepResult& BlockAssembler::GetGameStepResult(const uint256& hashPrev)
+{
+    AssertLockHeld(cs_main);
+    assert(templateGameCache.hashPrev == hashPrev);
+
+    /* The moves are fully determined by the transactions that contain
+       them, so the step result only changes if that list does.  */
+    if (templateGameCache.fHaveStep && templateGameCache.moveTxids == gameMoveTxids)
+        return templateGameCache.stepResult;
+
+    assert(gameStep->newHash.IsNull());
+    GameState newGameState(chainparams.GetConsensus());
+    StepResult stepResult;
+    if (!PerformStep(*prevGameState, *gameStep, newGameState, stepResult))
+        throw std::runtime_error(strprintf("%s: game engine failed to perform step", __func__));
+
+    templateGameCache.moveTxids = gameMoveTxids;
+    templateGameCache.stepResult = std::move(stepResult);
+    templateGameCache.fHaveStep = true;
+
+    return templateGameCache.stepResult;
+}
+
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
 {
     for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
@@ -298,9 +349,12 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
        to the game rules, but that one "should" not fail and will lead to
        an invalid block.  */
     CValidationState state;
+    const size_t nMovesBefore = gameStep->vMoves.size();
     if (!gameStep->addTransaction(iter->GetTx(), pcoinsTip.get(), state))
         throw std::runtime_error(strprintf("tx %s not accepted for game step",
                                            iter->GetTx().GetHash().GetHex().c_str()));
+    if (gameStep->vMoves.size() != nMovesBefore)
+        gameMoveTxids.push_back(iter->GetTx().GetHash());
 
     bool fPrintPriority = gArgs.GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
     if (fPrintPriority) {
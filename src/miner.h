@@ -147,8 +147,10 @@ private:
     const CChainParams& chainparams;
 
     // Game state context.
-    std::unique_ptr<GameState> prevGameState;
+    std::shared_ptr<const GameState> prevGameState;
     std::unique_ptr<StepData> gameStep;
+    // Txids of the block's transactions with game moves, in block order
+    std::vector<uint256> gameMoveTxids;
 
 public:
     struct Options {
@@ -169,6 +171,8 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Perform (or reuse) the game step for the selected moves */
+    const StepResult& GetGameStepResult(const uint256& hashPrev);
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
@@ -8,7 +8,11 @@
 
 #include <univalue.h>
 
+#include <cctype>
+#include <memory>
+
 bool fNameHistory = false;
+bool fNameHeightIndex = false;
 
 void
 PushValidatedNameValue (UniValue& obj, const std::string& key,
@@ -21,6 +25,50 @@ PushValidatedNameValue (UniValue& obj, const std::string& key,
     obj.pushKV (key + "_error",  "invalid UTF-8");
 }
 
+valtype
+GetRegexLiteralPrefix (const std::string& regexp)
+{
+  valtype res;
+
+  /* With alternatives, not all matches need to share the prefix.  Be
+     conservative and do not try to parse them.  */
+  if (regexp.empty () || regexp[0] != '^'
+        || regexp.find ('|') != std::string::npos)
+    return res;
+
+  static const std::string special = "\\^$.|?*+()[]{}";
+  static const std::string quantifiers = "?*+{";
+
+  size_t pos = 1;
+  while (pos < regexp.size ())
+    {
+      char c = regexp[pos];
+      size_t len = 1;
+      if (c == '\\')
+        {
+          /* Escaped punctuation is literal.  Escapes with letters or digits
+             are character classes, back references and the like.  */
+          if (pos + 1 >= regexp.size ()
+                || std::isalnum (static_cast<unsigned char> (regexp[pos + 1])))
+            break;
+          c = regexp[pos + 1];
+          len = 2;
+        }
+      else if (special.find (c) != std::string::npos)
+        break;
+
+      /* A quantified character is not part of every match.  */
+      if (pos + len < regexp.size ()
+            && quantifiers.find (regexp[pos + len]) != std::string::npos)
+        break;
+
+      res.push_back (c);
+      pos += len;
+    }
+
+  return res;
+}
+
 /* ************************************************************************** */
 /* CNameData.  */
 
@@ -35,6 +83,29 @@ CNameData::fromScript (unsigned h, const COutPoint& out,
   addr = script.getAddress ();
 }
 
+/* ************************************************************************** */
+/* CNameHistory.  */
+
+void
+CNameHistory::apply (const CNameHistory& changes)
+{
+  assert (changes.baseSize == size ());
+
+  for (unsigned i = 0; i < changes.popped; ++i)
+    {
+      if (!pushed.empty ())
+        pushed.pop_back ();
+      else
+        {
+          assert (popped < baseSize);
+          ++popped;
+        }
+    }
+
+  pushed.insert (pushed.end (),
+                 changes.pushed.begin (), changes.pushed.end ());
+}
+
 /* ************************************************************************** */
 /* CNameIterator.  */
 
@@ -52,6 +123,9 @@ class CCacheNameIterator : public CNameIterator
 
 private:
 
+  /** Copy of the cache owned by this iterator, if it works on a snapshot.  */
+  const std::unique_ptr<const CNameCache> ownedCache;
+
   /** Reference to cache object that is used.  */
   const CNameCache& cache;
 
@@ -82,6 +156,13 @@ public:
    */
   CCacheNameIterator (const CNameCache& c, CNameIterator* b);
 
+  /**
+   * Construct the iterator on a cache that it takes ownership of.
+   * @param c The cache object to use.
+   * @param b The base iterator.
+   */
+  CCacheNameIterator (std::unique_ptr<const CNameCache> c, CNameIterator* b);
+
   /* Destruct, this deletes also the base iterator.  */
   ~CCacheNameIterator ();
 
@@ -92,7 +173,7 @@ public:
 };
 
 CCacheNameIterator::CCacheNameIterator (const CNameCache& c, CNameIterator* b)
-  : cache(c), base(b)
+  : ownedCache(), cache(c), base(b)
 {
   /* Add a seek-to-start to ensure that everything is consistent.  This call
      may be superfluous if we seek to another position afterwards anyway,
@@ -100,6 +181,13 @@ CCacheNameIterator::CCacheNameIterator (const CNameCache& c, CNameIterator* b)
   seek (valtype ());
 }
 
+CCacheNameIterator::CCacheNameIterator (std::unique_ptr<const CNameCache> c,
+                                        CNameIterator* b)
+  : ownedCache(std::move (c)), cache(*ownedCache), base(b)
+{
+  seek (valtype ());
+}
+
 CCacheNameIterator::~CCacheNameIterator ()
 {
   delete base;
@@ -176,6 +264,86 @@ CCacheNameIterator::next (valtype& name, CNameData& data)
   return true;
 }
 
+/* ************************************************************************** */
+/* CCacheRecentNameIterator.  */
+
+/**
+ * Iterator over recently updated names that combines a base iterator with
+ * a copy of the changes in a name cache.  It first returns the names from
+ * the base iterator that are not changed in the cache, and then the
+ * changed names that are recent enough.
+ */
+class CCacheRecentNameIterator : public CNameIterator
+{
+
+private:
+
+  /** The cache's updated names.  */
+  const CNameCache::EntryMap entries;
+  /** The cache's deleted names.  */
+  const std::set<valtype> deleted;
+
+  /** Base iterator to combine with the cache.  */
+  const std::unique_ptr<CNameIterator> base;
+
+  /** Minimum update height of the names to return.  */
+  const unsigned minHeight;
+
+  /** Whether or not the base iterator may have more entries.  */
+  bool baseHasMore;
+  /** Iterator of the cache's entries.  */
+  CNameCache::EntryMap::const_iterator cacheIter;
+
+public:
+
+  CCacheRecentNameIterator (const CNameCache& c, CNameIterator* b,
+                            unsigned h);
+
+  /* Implement iterator methods.  */
+  void seek (const valtype& name);
+  bool next (valtype& name, CNameData& data);
+
+};
+
+CCacheRecentNameIterator::CCacheRecentNameIterator (const CNameCache& c,
+                                                    CNameIterator* b,
+                                                    const unsigned h)
+  : entries(c.entries), deleted(c.deleted), base(b), minHeight(h)
+{
+  seek (valtype ());
+}
+
+void
+CCacheRecentNameIterator::seek (const valtype& start)
+{
+  assert (start.empty ());
+  base->seek (start);
+  baseHasMore = true;
+  cacheIter = entries.begin ();
+}
+
+bool
+CCacheRecentNameIterator::next (valtype& name, CNameData& data)
+{
+  while (baseHasMore)
+    {
+      baseHasMore = base->next (name, data);
+      if (baseHasMore && entries.count (name) == 0 && deleted.count (name) == 0)
+        return true;
+    }
+
+  for (; cacheIter != entries.end (); ++cacheIter)
+    if (cacheIter->second.getHeight () >= minHeight)
+      {
+        name = cacheIter->first;
+        data = cacheIter->second;
+        ++cacheIter;
+        return true;
+      }
+
+  return false;
+}
+
 /* ************************************************************************** */
 /* CNameCache.  */
 
@@ -220,29 +388,47 @@ CNameCache::iterateNames (CNameIterator* base) const
   return new CCacheNameIterator (*this, base);
 }
 
-bool
-CNameCache::getHistory (const valtype& name, CNameHistory& res) const
+CNameIterator*
+CNameCache::iterateNamesSnapshot (CNameIterator* base) const
+{
+  /* The iterator only needs the entries, not the history.  */
+  std::unique_ptr<CNameCache> copy(new CNameCache ());
+  copy->entries = entries;
+  copy->deleted = deleted;
+
+  return new CCacheNameIterator (std::move (copy), base);
+}
+
+CNameIterator*
+CNameCache::iterateRecentNames (CNameIterator* base,
+                                const unsigned minHeight) const
+{
+  return new CCacheRecentNameIterator (*this, base, minHeight);
+}
+
+const CNameHistory*
+CNameCache::getHistory (const valtype& name) const
 {
   assert (fNameHistory);
 
   const std::map<valtype, CNameHistory>::const_iterator i = history.find (name);
   if (i == history.end ())
-    return false;
+    return nullptr;
 
-  res = i->second;
-  return true;
+  return &i->second;
 }
 
-void
-CNameCache::setHistory (const valtype& name, const CNameHistory& data)
+CNameHistory&
+CNameCache::modifyHistory (const valtype& name, const unsigned baseSize)
 {
   assert (fNameHistory);
 
   const std::map<valtype, CNameHistory>::iterator ei = history.find (name);
   if (ei != history.end ())
-    ei->second = data;
-  else
-    history.insert (std::make_pair (name, data));
+    return ei->second;
+
+  return history.insert (std::make_pair (name, CNameHistory (baseSize)))
+            .first->second;
 }
 
 void
@@ -258,5 +444,5 @@ CNameCache::apply (const CNameCache& cache)
 
   for (std::map<valtype, CNameHistory>::const_iterator i
         = cache.history.begin (); i != cache.history.end (); ++i)
-    setHistory (i->first, i->second);
+    modifyHistory (i->first, i->second.getBaseSize ()).apply (i->second);
 }
@@ -14,12 +14,15 @@
 #include <map>
 #include <set>
 
+class CCoinsView;
 class CNameScript;
 class CDBBatch;
 class UniValue;
 
 /** Whether or not name history is enabled.  */
 extern bool fNameHistory;
+/** Whether or not the index of names by their last update height is kept.  */
+extern bool fNameHeightIndex;
 
 /**
  * Construct a valtype (e. g., name) from a string.
@@ -50,6 +53,17 @@ ValtypeToString (const valtype& val)
 void PushValidatedNameValue (UniValue& obj, const std::string& key,
                              const valtype& val);
 
+/**
+ * Extract the literal prefix that all strings matched by an anchored
+ * regular expression (like "^p/") must start with.  This is conservative:
+ * If the expression is not anchored or contains alternatives, the prefix
+ * is empty.  The "^" anchor is assumed to match only at the start of
+ * the string (i. e., without embedded line breaks).
+ * @param regexp The regular expression in ECMAScript syntax.
+ * @return The literal prefix (possibly empty).
+ */
+valtype GetRegexLiteralPrefix (const std::string& regexp);
+
 /* ************************************************************************** */
 /* CNameData.  */
 
@@ -184,25 +198,43 @@ public:
 /* CNameHistory.  */
 
 /**
- * Keep track of a name's history.  This is a stack of old CNameData
- * objects that have been obsoleted.
+ * Keep track of changes to a name's history.  The history is a stack of old
+ * CNameData objects that have been obsoleted.  In the database, each entry
+ * is stored individually (keyed by its index in the stack), together with
+ * the stack's size.  This object records the entries popped off and pushed
+ * onto the stack of the underlying view, so that updating a name never
+ * needs to read or rewrite its full history.
  */
 class CNameHistory
 {
 
 private:
 
-  /** The actual data.  */
-  std::vector<CNameData> data;
+  /** Size of the stack in the underlying view.  */
+  unsigned baseSize;
+  /** Number of entries popped off the top of the underlying stack.  */
+  unsigned popped;
+  /** Entries pushed on top of the remaining underlying stack.  */
+  std::vector<CNameData> pushed;
 
 public:
 
-  ADD_SERIALIZE_METHODS;
+  /**
+   * Construct an unmodified record on top of a stack with the given size.
+   * @param base Size of the stack in the underlying view.
+   */
+  explicit inline CNameHistory (unsigned base = 0)
+    : baseSize(base), popped(0), pushed()
+  {}
 
-  template<typename Stream, typename Operation>
-    inline void SerializationOp (Stream& s, Operation ser_action)
+  /**
+   * Return the size of the stack with the changes applied.
+   * @return The number of history entries.
+   */
+  inline unsigned
+  size () const
   {
-    READWRITE (data);
+    return baseSize - popped + pushed.size ();
   }
 
   /**
@@ -213,44 +245,82 @@ public:
   inline bool
   empty () const
   {
-    return data.empty ();
+    return size () == 0;
   }
 
   /**
-   * Access the data in a read-only way.
-   * @return The data stack.
+   * Return the size of the stack in the underlying view.
+   * @return The underlying stack's size.
+   */
+  inline unsigned
+  getBaseSize () const
+  {
+    return baseSize;
+  }
+
+  /**
+   * Return the number of entries of the underlying stack that are still
+   * part of the history.  The pushed entries follow them.
+   * @return The number of kept entries from the underlying stack.
+   */
+  inline unsigned
+  getKeptBase () const
+  {
+    return baseSize - popped;
+  }
+
+  /**
+   * Access the entries pushed on top of the underlying stack.
+   * @return The pushed entries.
    */
   inline const std::vector<CNameData>&
-  getData () const
+  getPushed () const
   {
-    return data;
+    return pushed;
   }
 
   /**
    * Push a new entry onto the data stack.  The new entry's height should
-   * be at least as high as the stack top entry's.  If not, fail.
+   * be at least as high as the stack top entry's.  If not, fail.  (This is
+   * only checked against entries pushed onto this record.)
    * @param entry The new entry to push onto the stack.
    */
   inline void
   push (const CNameData& entry)
   {
-    assert (data.empty () || data.back ().getHeight () <= entry.getHeight ());
-    data.push_back (entry);
+    assert (pushed.empty ()
+              || pushed.back ().getHeight () <= entry.getHeight ());
+    pushed.push_back (entry);
   }
 
   /**
    * Pop the top entry off the stack.  This is used when undoing name
    * changes.  The name's new value is passed as argument and should
-   * match the removed entry.  If not, fail.
+   * match the removed entry if it was pushed onto this record.  Entries of
+   * the underlying stack have to be checked by the caller.
    * @param entry The name's value after undoing.
    */
   inline void
   pop (const CNameData& entry)
   {
-    assert (!data.empty () && data.back () == entry);
-    data.pop_back ();
+    if (!pushed.empty ())
+      {
+        assert (pushed.back () == entry);
+        pushed.pop_back ();
+        return;
+      }
+
+    assert (popped < baseSize);
+    ++popped;
   }
 
+  /**
+   * Apply the changes of another record, whose underlying stack is
+   * the stack represented by this record.
+   * @param changes The changes to apply.
+   */
+  void apply (const CNameHistory& changes);
+
 };
 
 /* ************************************************************************** */
@@ -268,7 +338,8 @@ public:
   virtual ~CNameIterator ();
 
   /**
-   * Seek to a given lower bound.
+   * Seek to a given lower bound.  Iterators over recently updated names
+   * are unordered and can only be seeked to the start (an empty name).
    * @param start The name to seek to.
    */
   virtual void seek (const valtype& name) = 0;
@@ -294,7 +365,7 @@ public:
 class CNameCache
 {
 
-private:
+public:
 
   /**
    * Special comparator class for names that compares by length first.
@@ -314,8 +385,6 @@ private:
     }
   };
 
-public:
-
   /**
    * Type of name entry map.  This is public because it is also used
    * by the unit tests.
@@ -329,13 +398,11 @@ private:
   /** Deleted names.  */
   std::set<valtype> deleted;
 
-  /**
-   * New or updated history stacks.  If they are empty, the corresponding
-   * database entry is deleted instead.
-   */
+  /** Changes to the history stacks of names.  */
   std::map<valtype, CNameHistory> history;
 
   friend class CCacheNameIterator;
+  friend class CCacheRecentNameIterator;
 
 public:
 
@@ -388,26 +455,40 @@ public:
      ownership of.  */
   CNameIterator* iterateNames (CNameIterator* base) const;
 
+  /* Return a name iterator like iterateNames, but based on a copy of
+     the cache's current entries.  It does not reference this object.  */
+  CNameIterator* iterateNamesSnapshot (CNameIterator* base) const;
+
+  /* Return an iterator (based on a copy of the cache) over the names
+     updated at or after the given height.  It combines the base iterator,
+     which must yield the corresponding names in the base view, with the
+     changes in the cache.  Names are returned in no particular order.  */
+  CNameIterator* iterateRecentNames (CNameIterator* base,
+                                     unsigned minHeight) const;
+
   /**
-   * Query for an history entry.
+   * Query for the history changes of a name.
    * @param name The name to look up.
-   * @param res Put the resulting history entry here.
-   * @return True iff the name was found in the cache.
+   * @return The history changes, or null if the name has none.
    */
-  bool getHistory (const valtype& name, CNameHistory& res) const;
+  const CNameHistory* getHistory (const valtype& name) const;
 
   /**
-   * Set a name history entry.
+   * Get the history changes of a name for modification.  If there are
+   * none yet, a record is created on top of the given stack size.
    * @param name The name to modify.
-   * @param data The new history entry.
+   * @param baseSize Size of the name's history in the underlying view.
+   * @return The history changes to modify.
    */
-  void setHistory (const valtype& name, const CNameHistory& data);
+  CNameHistory& modifyHistory (const valtype& name, unsigned baseSize);
 
   /* Apply all the changes in the passed-in record on top of this one.  */
   void apply (const CNameCache& cache);
 
-  /* Write all cached changes to a database batch update object.  */
-  void writeBatch (CDBBatch& batch) const;
+  /* Write all cached changes to a database batch update object.  The view
+     must be the current state of the database, which is used to look up
+     overwritten entries when updating the height index.  */
+  void writeBatch (CDBBatch& batch, const CCoinsView& view) const;
 
 };
 
@@ -9,6 +9,8 @@
 #include <consensus/validation.h>
 #include <hash.h>
 #include <dbwrapper.h>
+#include <memusage.h>
+#include <random.h>
 #include <script/interpreter.h>
 #include <script/names.h>
 #include <txmempool.h>
@@ -17,6 +19,9 @@
 #include <utilstrencodings.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <limits>
+
 /* ************************************************************************** */
 /* CNameTxUndo.  */
 
@@ -39,6 +44,17 @@ CNameTxUndo::apply (CCoinsViewCache& view) const
 /* ************************************************************************** */
 /* CNameMemPool.  */
 
+SaltedNameHasher::SaltedNameHasher ()
+  : k0(GetRand (std::numeric_limits<uint64_t>::max ())),
+    k1(GetRand (std::numeric_limits<uint64_t>::max ()))
+{}
+
+size_t
+SaltedNameHasher::operator() (const valtype& name) const
+{
+  return CSipHasher (k0, k1).Write (name.data (), name.size ()).Finalize ();
+}
+
 uint256
 CNameMemPool::getTxForName (const valtype& name) const
 {
@@ -73,7 +89,15 @@ CNameMemPool::addUnchecked (const uint256& hash, const CTxMemPoolEntry& entry)
       if (mit != mapNameNews.end ())
         assert (mit->second == hash);
       else
-        mapNameNews.insert (std::make_pair (newHash, hash));
+        {
+          /* The hash is only queued for expiry once the transaction
+             leaves the mempool again, see remove.  */
+          mapNameNews.insert (std::make_pair (newHash, hash));
+          keyUsage += memusage::DynamicUsage (newHash);
+
+          if (mapNameNews.size () > MAX_MEMPOOL_NAME_NEWS)
+            pruneNameNews (std::numeric_limits<int64_t>::min ());
+        }
     }
 
   if (entry.isNameRegistration ())
@@ -81,6 +105,7 @@ CNameMemPool::addUnchecked (const uint256& hash, const CTxMemPoolEntry& entry)
       const valtype& name = entry.getName ();
       assert (mapNameRegs.count (name) == 0);
       mapNameRegs.insert (std::make_pair (name, hash));
+      keyUsage += memusage::DynamicUsage (name);
     }
 
   if (entry.isNameUpdate ())
@@ -88,24 +113,81 @@ CNameMemPool::addUnchecked (const uint256& hash, const CTxMemPoolEntry& entry)
       const valtype& name = entry.getName ();
       assert (mapNameUpdates.count (name) == 0);
       mapNameUpdates.insert (std::make_pair (name, hash));
+      keyUsage += memusage::DynamicUsage (name);
+    }
+}
+
+void
+CNameMemPool::pruneNameNews (const int64_t time)
+{
+  AssertLockHeld (pool.cs);
+
+  while (!nameNewsByTime.empty ())
+    {
+      const auto first = nameNewsByTime.begin ();
+      if (first->first >= time
+            && mapNameNews.size () <= MAX_MEMPOOL_NAME_NEWS)
+        break;
+
+      const valtype newHash = first->second;
+      nameNewsByTime.erase (first);
+      keyUsage -= memusage::DynamicUsage (newHash);
+
+      /* The hash may have been queued more than once (if its transaction
+         was re-added to the mempool and removed again), or its transaction
+         may be back in the mempool.  In the latter case, it is queued again
+         when the transaction leaves.  */
+      const NameTxMap::iterator mit = mapNameNews.find (newHash);
+      if (mit == mapNameNews.end () || pool.mapTx.count (mit->second) > 0)
+        continue;
+
+      keyUsage -= memusage::DynamicUsage (newHash);
+      mapNameNews.erase (mit);
     }
 }
 
+size_t
+CNameMemPool::DynamicMemoryUsage () const
+{
+  return memusage::DynamicUsage (mapNameRegs)
+          + memusage::DynamicUsage (mapNameUpdates)
+          + memusage::DynamicUsage (mapNameNews)
+          + memusage::DynamicUsage (nameNewsByTime)
+          + keyUsage;
+}
+
 void
 CNameMemPool::remove (const CTxMemPoolEntry& entry)
 {
   AssertLockHeld (pool.cs);
 
+  /* The name_new hash is kept after the transaction left the mempool, but
+     from now on it may expire.  Do not prune here, since the transaction
+     is still in mapTx until the parent pool is done removing it.  */
+  if (entry.isNameNew ())
+    {
+      const valtype& newHash = entry.getNameNewHash ();
+      const NameTxMap::const_iterator mit = mapNameNews.find (newHash);
+      if (mit != mapNameNews.end ()
+            && mit->second == entry.GetTx ().GetHash ())
+        {
+          if (nameNewsByTime.emplace (entry.GetTime (), newHash).second)
+            keyUsage += memusage::DynamicUsage (newHash);
+        }
+    }
+
   if (entry.isNameRegistration ())
     {
       const NameTxMap::iterator mit = mapNameRegs.find (entry.getName ());
       assert (mit != mapNameRegs.end ());
+      keyUsage -= memusage::DynamicUsage (mit->first);
       mapNameRegs.erase (mit);
     }
   if (entry.isNameUpdate ())
     {
       const NameTxMap::iterator mit = mapNameUpdates.find (entry.getName ());
       assert (mit != mapNameUpdates.end ());
+      keyUsage -= memusage::DynamicUsage (mit->first);
       mapNameUpdates.erase (mit);
     }
 }
@@ -213,6 +295,15 @@ CNameMemPool::check (const CCoinsView& coins) const
   assert (nameRegs.size () == mapNameRegs.size ());
   assert (nameUpdates.size () == mapNameUpdates.size ());
 
+  /* All name_new hashes of transactions that left the mempool must be
+     queued for expiry.  */
+  std::set<valtype> expiring;
+  for (const auto& entry : nameNewsByTime)
+    expiring.insert (entry.second);
+  for (const auto& entry : mapNameNews)
+    if (pool.mapTx.count (entry.second) == 0)
+      assert (expiring.count (entry.first) > 0);
+
   /* Check that nameRegs and nameUpdates are disjoint.  They must be since
      a name can only be in either category, depending on whether it exists
      at the moment or not.  */
@@ -246,8 +337,7 @@ CNameMemPool::checkTx (const CTransaction& tx) const
         case OP_NAME_NEW:
           {
             const valtype& newHash = nameOp.getOpHash ();
-            std::map<valtype, uint256>::const_iterator mi;
-            mi = mapNameNews.find (newHash);
+            const NameTxMap::const_iterator mi = mapNameNews.find (newHash);
             if (mi != mapNameNews.end () && mi->second != tx.GetHash ())
               return false;
             break;
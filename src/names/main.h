@@ -16,6 +16,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 
 class CBlockUndo;
 class CCoinsView;
@@ -32,6 +33,9 @@ static const unsigned MIN_FIRSTUPDATE_DEPTH = 2;
 /** Amount to lock (at least for minimum) in name_new.  */
 static const CAmount NAMENEW_COIN_AMOUNT = COIN / 5;
 
+/** Maximum number of name_new hashes remembered by the mempool.  */
+static const unsigned MAX_MEMPOOL_NAME_NEWS = 100000;
+
 /* ************************************************************************** */
 /* CNameTxUndo.  */
 
@@ -86,6 +90,26 @@ public:
 /* ************************************************************************** */
 /* CNameMemPool.  */
 
+/**
+ * Salted hasher for names (and name_new hashes), so that peers cannot
+ * construct names that collide in the mempool's indices.
+ */
+class SaltedNameHasher
+{
+
+private:
+
+  /** Salt.  */
+  const uint64_t k0, k1;
+
+public:
+
+  SaltedNameHasher ();
+
+  size_t operator() (const valtype& name) const;
+
+};
+
 /**
  * Handle the name component of the transaction mempool.  This keeps track
  * of name operations that are in the mempool and ensures that all transactions
@@ -102,7 +126,7 @@ private:
   CTxMemPool& pool;
 
   /** Type used for internal indices.  */
-  typedef std::map<valtype, uint256> NameTxMap;
+  typedef std::unordered_map<valtype, uint256, SaltedNameHasher> NameTxMap;
 
   /**
    * Keep track of names that are registered by transactions in the pool.
@@ -115,11 +139,33 @@ private:
 
   /**
    * Map NAME_NEW hashes to the corresponding transaction IDs.  This is
-   * data that is kept only in memory but never cleared (until a restart).
-   * It is used to prevent "name_new stealing", at least in a "soft" way.
+   * data that is kept only in memory, also after the transactions have
+   * left the mempool.  It is used to prevent "name_new stealing", at least
+   * in a "soft" way.  Entries of transactions that left the mempool expire
+   * together with the mempool's transactions, and only as many of them
+   * are kept as fit into MAX_MEMPOOL_NAME_NEWS.
    */
   NameTxMap mapNameNews;
 
+  /**
+   * The name_new hashes whose transactions have left the mempool, ordered
+   * by the time the transactions entered it (so that they expire together
+   * with the mempool's transactions).  Only these can expire, so that
+   * pruning never has to look at entries that are still needed.
+   */
+  std::set<std::pair<int64_t, valtype>> nameNewsByTime;
+
+  /** Memory used by the keys of the maps above.  */
+  size_t keyUsage;
+
+  /**
+   * Remove name_new hashes of transactions that left the mempool and
+   * were added before the given time, and the oldest of them if there are
+   * more than MAX_MEMPOOL_NAME_NEWS hashes in total.
+   * @param time Expire entries added before this time.
+   */
+  void pruneNameNews (int64_t time);
+
 public:
 
   /**
@@ -127,7 +173,8 @@ public:
    * @param p The parent pool.
    */
   explicit inline CNameMemPool (CTxMemPool& p)
-    : pool(p), mapNameRegs(), mapNameUpdates(), mapNameNews()
+    : pool(p), mapNameRegs(), mapNameUpdates(), mapNameNews(),
+      nameNewsByTime(), keyUsage(0)
   {}
 
   /**
@@ -171,8 +218,26 @@ public:
     mapNameRegs.clear ();
     mapNameUpdates.clear ();
     mapNameNews.clear ();
+    nameNewsByTime.clear ();
+    keyUsage = 0;
   }
 
+  /**
+   * Forget name_new hashes that were added before the given time.  This is
+   * called when the parent mempool expires its transactions.
+   * @param time Expire entries added before this time.
+   */
+  inline void
+  expire (const int64_t time)
+  {
+    pruneNameNews (time);
+  }
+
+  /**
+   * Estimate the memory used by the name indices.
+   */
+  size_t DynamicMemoryUsage () const;
+
   /**
    * Add an entry without checking it.  It should have been checked
    * already.  If this conflicts with the mempool, it may throw.
@@ -131,7 +131,11 @@ public:
      */
     inline bool IsAuxpow() const
     {
-        return nVersion & VERSION_AUXPOW;
+        return IsAuxpow(nVersion);
+    }
+    static inline bool IsAuxpow(int32_t ver)
+    {
+        return ver & VERSION_AUXPOW;
     }
 
     /**
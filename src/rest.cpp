@@ -5,7 +5,13 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <clientversion.h>
 #include <core_io.h>
+#include <game/db.h>
+#include <game/jsonwriter.h>
+#include <game/map.h>
+#include <game/state.h>
+#include <game/tiles.h>
 #include <names/common.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
@@ -23,8 +29,14 @@
 
 #include <univalue.h>
 
+#include <list>
+#include <map>
+
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
 
+//! Maximum total size of the cached game responses
+static const size_t MAX_GAME_RESPONSE_CACHE = 32 << 20;
+
 enum class RetFormat {
     UNDEF,
     BINARY,
@@ -678,6 +690,332 @@ static bool rest_name(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/**
+ * LRU cache of serialised game REST responses.  Game states are immutable
+ * per block hash, so a response can be reused for as long as the key (which
+ * contains the block hash) is requested.
+ */
+class GameResponseCache
+{
+private:
+    typedef std::list<std::pair<std::string, std::string>> EntryList;
+
+    CCriticalSection cs;
+    EntryList entries;
+    std::map<std::string, EntryList::iterator> index;
+    size_t nBytes;
+    const size_t nMaxBytes;
+
+public:
+    explicit GameResponseCache(size_t nMax) : nBytes(0), nMaxBytes(nMax) {}
+
+    bool Get(const std::string& key, std::string& response)
+    {
+        LOCK(cs);
+        const auto mi = index.find(key);
+        if (mi == index.end())
+            return false;
+        entries.splice(entries.begin(), entries, mi->second);
+        response = mi->second->second;
+        return true;
+    }
+
+    void Put(const std::string& key, const std::string& response)
+    {
+        if (response.size() > nMaxBytes)
+            return;
+
+        LOCK(cs);
+        if (index.count(key) > 0)
+            return;
+        entries.emplace_front(key, response);
+        index.emplace(key, entries.begin());
+        nBytes += response.size();
+
+        while (nBytes > nMaxBytes) {
+            nBytes -= entries.back().second.size();
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+};
+
+static GameResponseCache gameResponseCache(MAX_GAME_RESPONSE_CACHE);
+
+/**
+ * Check a request's If-None-Match header against the ETag of the
+ * response.  If it matches, reply with "304 Not Modified" and return true.
+ */
+static bool GameNotModified(HTTPRequest* req, const std::string& etag, const std::string& cacheControl)
+{
+    const std::pair<bool, std::string> header = req->GetHeader("If-None-Match");
+    if (!header.first)
+        return false;
+
+    std::vector<std::string> tags;
+    boost::split(tags, header.second, boost::is_any_of(","));
+    for (std::string& tag : tags) {
+        boost::trim(tag);
+        if (tag == etag || tag == "*") {
+            req->WriteHeader("ETag", etag);
+            req->WriteHeader("Cache-Control", cacheControl);
+            req->WriteReply(HTTP_NOT_MODIFIED);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Serve a game response.  The key identifies the response uniquely (it
+ * includes the block hash of the game state and the format) and is used
+ * both as ETag and for the response cache.  The producer is only called
+ * if the response is not yet cached.
+ */
+template<typename Producer>
+static bool WriteGameResponse(HTTPRequest* req, RetFormat rf, const std::string& key, const std::string& cacheControl, const Producer& produce)
+{
+    const std::string etag = "\"" + key + "\"";
+    if (GameNotModified(req, etag, cacheControl))
+        return true;
+
+    std::string response;
+    if (!gameResponseCache.Get(key, response)) {
+        if (!produce(response))
+            return false;
+        gameResponseCache.Put(key, response);
+    }
+
+    switch (rf) {
+    case RetFormat::BINARY:
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        break;
+    case RetFormat::HEX:
+        req->WriteHeader("Content-Type", "text/plain");
+        break;
+    default:
+        req->WriteHeader("Content-Type", "application/json");
+        break;
+    }
+    req->WriteHeader("ETag", etag);
+    req->WriteHeader("Cache-Control", cacheControl);
+    req->WriteReply(HTTP_OK, response);
+    return true;
+}
+
+/** Cache-Control for responses that depend on the block hash in the URI.  */
+static const char* GAME_CACHE_IMMUTABLE = "public, max-age=31536000, immutable";
+/** Cache-Control for responses about the current tip.  */
+static const char* GAME_CACHE_TIP = "public, no-cache";
+
+/** Look up the current tip's hash.  */
+static uint256 GetTipHash()
+{
+    // Avoid cs_main if the tip's game state is published
+    const GameStateRef state = pgameDb->getTip();
+    if (state)
+        return state->hashBlock;
+
+    LOCK(cs_main);
+    return chainActive.Tip()->GetBlockHash();
+}
+
+/** Encode serialised data in the given format (binary or hex).  */
+static std::string GameDataToFormat(RetFormat rf, const CDataStream& ss)
+{
+    if (rf == RetFormat::HEX)
+        return HexStr(ss.begin(), ss.end()) + "\n";
+    return ss.str();
+}
+
+static bool rest_game_state(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+    if (rf == RetFormat::UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+    {
+        LOCK(cs_main);
+        if (!LookupBlockIndex(hash))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+    }
+
+    const std::string key = "state/" + strURIPart;
+    return WriteGameResponse(req, rf, key, GAME_CACHE_IMMUTABLE, [&](std::string& response) {
+        const GameStateRef snapshot = pgameDb->getSnapshot(hash);
+        if (!snapshot)
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Failed to fetch game state");
+        const GameState& state = *snapshot;
+
+        if (rf == RetFormat::JSON) {
+            JsonWriter writer(response);
+            state.WriteJson(writer);
+            response += "\n";
+        } else {
+            CDataStream ss(SER_DISK, CLIENT_VERSION);
+            ss << state;
+            response = GameDataToFormat(rf, ss);
+        }
+        return true;
+    });
+}
+
+static bool rest_game_player(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string encodedName;
+    const RetFormat rf = ParseDataFormat(encodedName, strURIPart);
+    if (rf == RetFormat::UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    valtype plainName;
+    if (!DecodeName(plainName, encodedName))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid encoded name: " + encodedName);
+
+    /* Do not intern arbitrary names from the request.  If the name is
+       not interned, no game state contains it.  */
+    PlayerID name;
+    if (!PlayerID::Lookup(ValtypeToString(plainName), name))
+        return RESTERR(req, HTTP_NOT_FOUND, "'" + ValtypeToString(plainName) + "' not found");
+
+    const uint256 hash = GetTipHash();
+    const std::string key = "player/" + hash.GetHex() + "/" + strURIPart;
+    return WriteGameResponse(req, rf, key, GAME_CACHE_TIP, [&](std::string& response) {
+        const GameStateRef snapshot = pgameDb->getSnapshot(hash);
+        if (!snapshot)
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Failed to fetch game state");
+        const GameState& state = *snapshot;
+
+        const auto mi = state.players.find(name);
+        if (mi == state.players.end())
+            return RESTERR(req, HTTP_NOT_FOUND, "'" + name.str() + "' not found");
+
+        if (rf == RetFormat::JSON) {
+            int crownIndex = -1;
+            if (name == state.crownHolder.player)
+                crownIndex = state.crownHolder.index;
+
+            JsonWriter writer(response);
+            mi->second->WriteJson(writer, crownIndex);
+            response += "\n";
+        } else {
+            CDataStream ss(SER_DISK, CLIENT_VERSION);
+            ss << *mi->second;
+            response = GameDataToFormat(rf, ss);
+        }
+        return true;
+    });
+}
+
+/**
+ * The characters of one game state indexed by their tile.  Only the index of
+ * the most recently requested state is kept, which is the tip for all tile
+ * requests.  It is rebuilt once when the tip changes, so that the requests
+ * for (uncached) tiles do not each scan all players.
+ */
+struct GameTileIndex
+{
+    uint256 hashBlock;
+    TileIndex<CharacterID> characters;
+};
+
+static CCriticalSection cs_gameTileIndex;
+static std::shared_ptr<const GameTileIndex> gameTileIndex;
+
+/** Return the tile index for the given game state, building it if needed.  */
+static std::shared_ptr<const GameTileIndex> GetGameTileIndex(const GameState& state)
+{
+    LOCK(cs_gameTileIndex);
+    if (gameTileIndex && gameTileIndex->hashBlock == state.hashBlock)
+        return gameTileIndex;
+
+    auto index = std::make_shared<GameTileIndex>();
+    index->hashBlock = state.hashBlock;
+    for (const auto& p : state.players) {
+        for (const auto& ch : p.second->characters)
+            index->characters.Add(ch.second.coord, CharacterID(p.first, ch.first));
+    }
+    index->characters.Finalise();
+
+    gameTileIndex = index;
+    return gameTileIndex;
+}
+
+static bool rest_game_tile(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf != RetFormat::JSON)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+    int x, y;
+    if (path.size() != 2 || !ParseInt32(path[0], &x) || !ParseInt32(path[1], &y))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid tile. Use /rest/game/tile/<x>/<y>.json.");
+    if (!IsInsideMap(x, y))
+        return RESTERR(req, HTTP_NOT_FOUND, "Tile is outside of the map");
+    const Coord c(x, y);
+
+    const uint256 hash = GetTipHash();
+    const std::string key = "tile/" + hash.GetHex() + "/" + strURIPart;
+    return WriteGameResponse(req, rf, key, GAME_CACHE_TIP, [&](std::string& response) {
+        const GameStateRef snapshot = pgameDb->getSnapshot(hash);
+        if (!snapshot)
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Failed to fetch game state");
+        const GameState& state = *snapshot;
+
+        JsonWriter writer(response);
+        writer.BeginObject();
+        writer.Key("x");
+        writer.Int(x);
+        writer.Key("y");
+        writer.Int(y);
+        writer.Key("walkable");
+        writer.Bool(IsWalkable(x, y));
+        writer.Key("bank");
+        writer.Bool(state.IsBank(c));
+        writer.Key("heart");
+        writer.Bool(state.hearts.count(c) > 0);
+        writer.Key("crown");
+        writer.Bool(state.crownHolder.player.empty() && state.crownPos == c);
+
+        const auto mi = state.loot.find(c);
+        if (mi != state.loot.end()) {
+            writer.Key("loot");
+            writer.Amount(mi->second.nAmount);
+        }
+
+        writer.Key("characters");
+        writer.BeginArray();
+        const std::shared_ptr<const GameTileIndex> tileIndex = GetGameTileIndex(state);
+        const auto range = tileIndex->characters.EqualRange(c);
+        for (auto it = range.first; it != range.second; ++it) {
+            writer.BeginObject();
+            writer.Key("player");
+            writer.String(it->second.player);
+            writer.Key("index");
+            writer.Int(it->second.index);
+            writer.EndObject();
+        }
+        writer.EndArray();
+
+        writer.EndObject();
+        response += "\n";
+        return true;
+    });
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -691,6 +1029,9 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/name/", rest_name},
+      {"/rest/game/state/", rest_game_state},
+      {"/rest/game/player/", rest_game_player},
+      {"/rest/game/tile/", rest_game_tile},
 };
 
 bool StartREST()
@@ -144,6 +144,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "disconnectnode", 1, "nodeid" },
     { "addwitnessaddress", 1, "p2sh" },
     { "createauxblock", 1, "algo" },
+    { "name_history", 1, "start" },
+    { "name_history", 2, "count" },
     { "name_scan", 1, "count" },
     { "name_filter", 1, "maxage" },
     { "name_filter", 2, "from" },
@@ -155,6 +157,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "sendtoname", 4, "subtractfeefromamount" },
     { "game_getpath", 0, "from" },
     { "game_getpath", 1, "to" },
+    { "game_getpaths", 0, "queries" },
     // Echo with conversion (For testing only)
     { "echojson", 0, "arg0" },
     { "echojson", 1, "arg1" },
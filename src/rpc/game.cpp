@@ -14,19 +14,110 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <chainparams.h>
+#include <clientversion.h>
 #include <game/common.h>
 #include <game/db.h>
+#include <game/jsonwriter.h>
 #include <game/movecreator.h>
 #include <game/state.h>
 #include <game/tx.h>
 #include <rpc/server.h>
 #include <script/script.h>
+#include <streams.h>
 #include <sync.h>
 #include <uint256.h>
+#include <utilstrencodings.h>
 #include <validation.h>
 
 #include <univalue.h>
 
+#include <functional>
+
+namespace
+{
+
+/**
+ * Return JSON produced with JsonWriter as RPC result.  If the request
+ * allows it, the JSON is written directly into the reply, so that large
+ * game states are neither turned into a tree of UniValue objects nor
+ * copied around.  Otherwise (e. g., for batch requests or calls from
+ * within the process), it is parsed into a proper UniValue.
+ */
+UniValue
+JsonResult (const JSONRPCRequest& request,
+            const std::function<void (JsonWriter&)>& write)
+{
+  if (request.rawResult != nullptr)
+    {
+      JsonWriter writer(*request.rawResult);
+      write (writer);
+      assert (writer.IsComplete ());
+      return NullUniValue;
+    }
+
+  std::string json;
+  JsonWriter writer(json);
+  write (writer);
+  assert (writer.IsComplete ());
+
+  UniValue res;
+  if (!res.read (json))
+    throw JSONRPCError (RPC_INTERNAL_ERROR, "Failed to parse JSON result");
+  return res;
+}
+
+/**
+ * Return the JSON representation of a game state as RPC result.
+ */
+UniValue
+GameStateJson (const JSONRPCRequest& request, const GameState& state)
+{
+  return JsonResult (request, [&state] (JsonWriter& writer)
+    {
+      state.WriteJson (writer);
+    });
+}
+
+/**
+ * Look up the game state for the given (optional) block hash parameter,
+ * or the current tip if it is absent (null).  A given hash must be valid
+ * and refer to a known block.  The published tip state is used
+ * without locking cs_main where possible.
+ */
+GameStateRef
+LookupGameState (const UniValue& hashParam)
+{
+  GameStateRef res = pgameDb->getTip ();
+
+  uint256 hash;
+  if (hashParam.isNull ())
+    {
+      if (res)
+        return res;
+
+      LOCK (cs_main);
+      hash = *chainActive.Tip ()->phashBlock;
+    }
+  else
+    {
+      hash = ParseHashV (hashParam, "blockhash");
+      if (res && hash == res->hashBlock)
+        return res;
+
+      LOCK (cs_main);
+      if (mapBlockIndex.count (hash) == 0)
+        throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    }
+
+  res = pgameDb->getSnapshot (hash);
+  if (!res)
+    throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to fetch game state");
+
+  return res;
+}
+
+} // anonymous namespace
+
 UniValue
 game_getplayerstate (const JSONRPCRequest& request)
 {
@@ -46,23 +137,15 @@ game_getplayerstate (const JSONRPCRequest& request)
         + HelpExampleRpc ("game_getplayerstate", "\"domob\" \"7125a396097e238e6f47662aaa3fa3b97af9125b8bcfea0dbd01aeedaae1faeb\"")
       );
 
-  uint256 hash;
-  {
-    LOCK (cs_main);
-    if (request.params.size () >= 2)
-      hash = uint256S (request.params[1].get_str ());
-    else
-      hash = *chainActive.Tip ()->phashBlock;
-
-    if (mapBlockIndex.count (hash) == 0)
-      throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-  }
-
-  GameState state(Params ().GetConsensus ());
-  if (!pgameDb->get (hash, state))
-    throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to fetch game state");
+  const GameStateRef snapshot
+    = LookupGameState (request.params.size () >= 2
+                         ? request.params[1] : NullUniValue);
+  const GameState& state = *snapshot;
 
-  const PlayerID name = request.params[0].get_str ();
+  /* Do not intern arbitrary names given by the caller.  */
+  PlayerID name;
+  if (!PlayerID::Lookup (request.params[0].get_str (), name))
+    throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "No such player");
   PlayerStateMap::const_iterator mi = state.players.find (name);
   if (mi == state.players.end ())
     throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "No such player");
@@ -71,44 +154,59 @@ game_getplayerstate (const JSONRPCRequest& request)
   if (name == state.crownHolder.player)
     crownIndex = state.crownHolder.index;
 
-  return mi->second.ToJsonValue (crownIndex);
+  const PlayerState& player = *mi->second;
+  return JsonResult (request, [&player, crownIndex] (JsonWriter& writer)
+    {
+      player.WriteJson (writer, crownIndex);
+    });
 }
 
 UniValue
 game_getstate (const JSONRPCRequest& request)
 {
-  if (request.fHelp || request.params.size () > 1)
+  if (request.fHelp || request.params.size () > 2)
     throw std::runtime_error (
-        "game_getstate (\"hash\")\n"
+        "game_getstate (\"hash\" \"format\")\n"
         "\nLook up and return the game state for either the latest block"
         " or the block with the given hash.\n"
         "\nArguments:\n"
         "1. \"blockhash\"    (string, optional) the block hash\n"
-        "\nResult:\n"
+        "2. \"format\"       (string, optional, default=\"json\") \"json\" or"
+        " \"binary\"\n"
+        "\nResult (for format = \"json\"):\n"
         "JSON representation of the game state\n"
+        "\nResult (for format = \"binary\"):\n"
+        "\"data\"           (string) hex-encoded game state, in the format"
+        " in which it is stored in the game database\n"
         "\nExamples:\n"
         + HelpExampleCli ("game_getstate", "")
         + HelpExampleCli ("game_getstate", "\"7125a396097e238e6f47662aaa3fa3b97af9125b8bcfea0dbd01aeedaae1faeb\"")
+        + HelpExampleCli ("game_getstate", "\"7125a396097e238e6f47662aaa3fa3b97af9125b8bcfea0dbd01aeedaae1faeb\" \"binary\"")
         + HelpExampleRpc ("game_getstate", "\"7125a396097e238e6f47662aaa3fa3b97af9125b8bcfea0dbd01aeedaae1faeb\"")
       );
 
-  uint256 hash;
-  {
-    LOCK (cs_main);
-    if (request.params.size () >= 1)
-      hash = uint256S (request.params[0].get_str ());
-    else
-      hash = *chainActive.Tip ()->phashBlock;
+  bool binary = false;
+  if (request.params.size () >= 2)
+    {
+      const std::string format = request.params[1].get_str ();
+      if (format == "binary")
+        binary = true;
+      else if (format != "json")
+        throw JSONRPCError (RPC_INVALID_PARAMETER, "Unknown format");
+    }
 
-    if (mapBlockIndex.count (hash) == 0)
-      throw JSONRPCError (RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-  }
+  const GameStateRef state
+    = LookupGameState (request.params.size () >= 1
+                         ? request.params[0] : NullUniValue);
 
-  GameState state(Params ().GetConsensus ());
-  if (!pgameDb->get (hash, state))
-    throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to fetch game state");
+  if (binary)
+    {
+      CDataStream ss(SER_DISK, CLIENT_VERSION);
+      ss << *state;
+      return HexStr (ss.begin (), ss.end ());
+    }
 
-  return state.ToJsonValue ();
+  return GameStateJson (request, *state);
 }
 
 /* ************************************************************************** */
@@ -138,22 +236,29 @@ game_waitforchange (const JSONRPCRequest& request)
   WaitableLock lock(mut_currentState);
   while (IsRPCRunning())
     {
-      /* Atomically check whether we have found a new best block and return
-         it if that's the case.  We use a lock on cs_main in order to
-         prevent race conditions.  */
-      {
-        LOCK (cs_main);
-        const uint256 bestHash = *chainActive.Tip ()->phashBlock;
-        if (hash != bestHash)
+      /* Check whether we have found a new best block and return it if
+         that's the case.  The tip state is published before cv_stateChange
+         is notified, so we do not miss an update while holding
+         mut_currentState.  If no state is published, fall back to looking
+         up the tip with cs_main.  */
+      GameStateRef state = pgameDb->getTip ();
+      if (!state)
+        {
+          uint256 bestHash;
           {
-            GameState state(Params ().GetConsensus ());
-            if (!pgameDb->get (bestHash, state))
-              throw JSONRPCError (RPC_DATABASE_ERROR,
-                                  "Failed to fetch game state");
-
-            return state.ToJsonValue ();
+            LOCK (cs_main);
+            bestHash = *chainActive.Tip ()->phashBlock;
           }
-      }
+          if (hash != bestHash)
+            {
+              state = pgameDb->getSnapshot (bestHash);
+              if (!state)
+                throw JSONRPCError (RPC_DATABASE_ERROR,
+                                    "Failed to fetch game state");
+            }
+        }
+      if (state && hash != state->hashBlock)
+        return GameStateJson (request, *state);
 
       /* Wait on the condition variable.  */
       cv_stateChange.wait (lock);
@@ -164,6 +269,30 @@ game_waitforchange (const JSONRPCRequest& request)
 
 /* ************************************************************************** */
 
+/**
+ * Convert a path as returned by FindPath to the JSON format of way points
+ * used in moves.  The starting coordinate is not included.
+ */
+static UniValue
+PathToJson (const std::vector<Coord>& path)
+{
+  UniValue res(UniValue::VARR);
+  bool first = true;
+  for (const auto& c : path)
+    {
+      if (first)
+        {
+          first = false;
+          continue;
+        }
+
+      res.push_back (c.x);
+      res.push_back (c.y);
+    }
+
+  return res;
+}
+
 UniValue
 game_getpath (const JSONRPCRequest& request)
 {
@@ -197,20 +326,106 @@ game_getpath (const JSONRPCRequest& request)
   const Coord toC(request.params[1][0].get_int (),
                   request.params[1][1].get_int ());
 
-  const std::vector<Coord> path = FindPath (fromC, toC);
+  return PathToJson (FindPath (fromC, toC));
+}
+
+/* Maximum number of queries accepted by a single game_getpaths call.  */
+static const unsigned MAX_PATH_QUERIES = 10000;
+
+namespace
+{
+
+/**
+ * Parse a [x,y] coordinate from JSON.
+ */
+Coord
+ParseCoord (const UniValue& val)
+{
+  if (!val.isArray () || val.size () != 2)
+    throw std::runtime_error ("invalid coordinates given");
+
+  return Coord (val[0].get_int (), val[1].get_int ());
+}
+
+} // anonymous namespace
+
+UniValue
+game_getpaths (const JSONRPCRequest& request)
+{
+  if (request.fHelp || request.params.size () != 1)
+    throw std::runtime_error (
+        "game_getpaths [{\"from\":[x,y],...},...]\n"
+        "\nProcess a batch of pathfinding queries in parallel.  Each query"
+        " either finds a path as game_getpath does (if \"to\" is given),"
+        " or computes the walking distances from \"from\" to a list of"
+        " \"targets\" (e. g., all banks).\n"
+        "\nArguments:\n"
+        "1. \"queries\"   (json array, required) the queries\n"
+        "    [\n"
+        "      {\n"
+        "        \"from\": [x,y],         (int array, required) starting coordinate\n"
+        "        \"to\": [x,y],           (int array) target coordinate\n"
+        "        \"targets\": [[x,y],...] (json array) targets for distances\n"
+        "      },\n"
+        "      ...\n"
+        "    ]\n"
+        "\nResult:\n"
+        "[              (json array with one entry per query)\n"
+        "   [x1,y1,...],  (int array) way points as returned by game_getpath\n"
+        "   [d1,d2,...],  (int array) distances to the targets, -1 if unreachable\n"
+        "   ...\n"
+        "]\n"
+        "\nExamples:\n"
+        + HelpExampleCli ("game_getpaths", "'[{\"from\":[0,0],\"to\":[100,100]}]'")
+        + HelpExampleCli ("game_getpaths", "'[{\"from\":[0,0],\"targets\":[[10,10],[20,20]]}]'")
+        + HelpExampleRpc ("game_getpaths", "[{\"from\":[0,0],\"to\":[100,100]}]")
+      );
+
+  const UniValue& arr = request.params[0].get_array ();
+  if (arr.size () > MAX_PATH_QUERIES)
+    throw std::runtime_error (strprintf ("at most %u queries are allowed",
+                                         MAX_PATH_QUERIES));
+
+  std::vector<PathQuery> queries;
+  for (unsigned i = 0; i < arr.size (); ++i)
+    {
+      const UniValue& obj = arr[i].get_obj ();
+      const UniValue& from = find_value (obj, "from");
+      const UniValue& to = find_value (obj, "to");
+      const UniValue& targets = find_value (obj, "targets");
+
+      PathQuery q;
+      q.from = ParseCoord (from);
+      if (to.isNull () == targets.isNull ())
+        throw std::runtime_error ("each query needs either 'to' or 'targets'");
+      if (!to.isNull ())
+        q.to = ParseCoord (to);
+      else
+        {
+          if (targets.get_array ().empty ())
+            throw std::runtime_error ("'targets' must not be empty");
+          for (unsigned j = 0; j < targets.size (); ++j)
+            q.targets.push_back (ParseCoord (targets[j]));
+        }
+
+      queries.push_back (q);
+    }
+
+  const std::vector<PathResult> results = ProcessPathQueries (queries);
 
   UniValue res(UniValue::VARR);
-  bool first = true;
-  for (const auto& c : path)
+  for (unsigned i = 0; i < queries.size (); ++i)
     {
-      if (first)
+      if (queries[i].targets.empty ())
         {
-          first = false;
+          res.push_back (PathToJson (results[i].path));
           continue;
         }
 
-      res.push_back (c.x);
-      res.push_back (c.y);
+      UniValue distances(UniValue::VARR);
+      for (const int d : results[i].distances)
+        distances.push_back (d);
+      res.push_back (distances);
     }
 
   return res;
@@ -222,8 +437,9 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "game",               "game_getplayerstate",    &game_getplayerstate,    {"name","hash"} },
-    { "game",               "game_getstate",          &game_getstate,          {"hash"} },
+    { "game",               "game_getstate",          &game_getstate,          {"hash","format"} },
     { "game",               "game_getpath",           &game_getpath,           {"from","to"} },
+    { "game",               "game_getpaths",          &game_getpaths,          {"queries"} },
     { "game",               "game_waitforchange",     &game_waitforchange,     {"hash"} },
 };
 
@@ -539,7 +539,7 @@ getstatsforheight (const JSONRPCRequest& request)
     throw JSONRPCError (RPC_DATABASE_ERROR, "Failed to fetch game state");
   unsigned nHunters = 0;
   for (const auto& cur : gameState.players)
-    nHunters += cur.second.characters.size ();
+    nHunters += cur.second->characters.size ();
   UniValue game(UniValue::VOBJ);
   const unsigned nPlayers = gameState.players.size ();
   game.pushKV ("players", static_cast<int> (nPlayers));
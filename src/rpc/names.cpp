@@ -23,6 +23,7 @@
 
 #include <boost/xpressive/xpressive_dynamic.hpp>
 
+#include <algorithm>
 #include <memory>
 #include <sstream>
 
@@ -160,13 +161,16 @@ name_show (const JSONRPCRequest& request)
 UniValue
 name_history (const JSONRPCRequest& request)
 {
-  if (request.fHelp || request.params.size () != 1)
+  if (request.fHelp || request.params.size () < 1
+        || request.params.size () > 3)
     throw std::runtime_error (
-        "name_history \"name\"\n"
+        "name_history \"name\" (\"start\" (\"count\"))\n"
         "\nLook up the current and all past data for the given name."
         "  -namehistory must be enabled.\n"
         "\nArguments:\n"
         "1. \"name\"          (string, required) the name to query for\n"
+        "2. \"start\"         (numeric, optional, default=0) skip this many of the oldest entries\n"
+        "3. \"count\"         (numeric, optional) return at most this many entries\n"
         "\nResult:\n"
         "[\n"
         + getNameInfoHelp ("  ", ",") +
@@ -174,10 +178,12 @@ name_history (const JSONRPCRequest& request)
         "]\n"
         "\nExamples:\n"
         + HelpExampleCli ("name_history", "\"myname\"")
+        + HelpExampleCli ("name_history", "\"myname\" 100 10")
         + HelpExampleRpc ("name_history", "\"myname\"")
       );
 
-  RPCTypeCheck (request.params, {UniValue::VSTR});
+  RPCTypeCheck (request.params,
+                {UniValue::VSTR, UniValue::VNUM, UniValue::VNUM});
 
   if (!fNameHistory)
     throw std::runtime_error ("-namehistory is not enabled");
@@ -187,8 +193,24 @@ name_history (const JSONRPCRequest& request)
   const std::string nameStr = request.params[0].get_str ();
   const valtype name = ValtypeFromString (nameStr);
 
+  int start = 0;
+  if (request.params.size () >= 2)
+    start = request.params[1].get_int ();
+  if (start < 0)
+    throw JSONRPCError (RPC_INVALID_PARAMETER, "start must not be negative");
+
+  int count = -1;
+  if (request.params.size () >= 3)
+    {
+      count = request.params[2].get_int ();
+      if (count < 0)
+        throw JSONRPCError (RPC_INVALID_PARAMETER,
+                            "count must not be negative");
+    }
+
   CNameData data;
-  CNameHistory history;
+  std::vector<CNameData> history;
+  bool withCurrent;
 
   {
     LOCK (cs_main);
@@ -200,14 +222,28 @@ name_history (const JSONRPCRequest& request)
         throw JSONRPCError (RPC_WALLET_ERROR, msg.str ());
       }
 
-    if (!pcoinsTip->GetNameHistory (name, history))
-      assert (history.empty ());
+    /* The result consists of the history entries (oldest first) followed
+       by the current data.  Only read the requested range of them.  */
+    const unsigned total = pcoinsTip->GetNameHistorySize (name) + 1;
+    unsigned num = 0;
+    if (static_cast<unsigned> (start) < total)
+      {
+        num = total - start;
+        if (count >= 0 && static_cast<unsigned> (count) < num)
+          num = count;
+      }
+
+    withCurrent = (num > 0 && start + num == total);
+    const unsigned numHistory = (withCurrent ? num - 1 : num);
+    if (!pcoinsTip->GetNameHistory (name, start, numHistory, history))
+      throw JSONRPCError (RPC_DATABASE_ERROR, "failed to read name history");
   }
 
   UniValue res(UniValue::VARR);
-  for (const auto& entry : history.getData ())
+  for (const auto& entry : history)
     res.push_back (getNameInfo (name, entry));
-  res.push_back (getNameInfo (name, data));
+  if (withCurrent)
+    res.push_back (getNameInfo (name, data));
 
   return res;
 }
@@ -272,12 +308,19 @@ name_filter (const JSONRPCRequest& request)
     throw std::runtime_error (
         "name_filter (\"regexp\" (\"maxage\" (\"from\" (\"nb\" (\"stat\")))))\n"
         "\nScan and list names matching a regular expression.\n"
+        "\"^\" and \"$\" match at the start and end of the name.  Expressions"
+        " starting with \"^\" and a literal prefix only look at names with"
+        " that prefix.  With -nameheightindex, names older than \"maxage\""
+        " are skipped without reading them.\n"
         "\nArguments:\n"
         "1. \"regexp\"      (string, optional) filter names with this regexp\n"
         "2. \"maxage\"      (numeric, optional, default=36000) only consider names updated in the last \"maxage\" blocks; 0 means all names\n"
         "3. \"from\"        (numeric, optional, default=0) return from this position onward; index starts at 0\n"
         "4. \"nb\"          (numeric, optional, default=0) return only \"nb\" entries; 0 means all\n"
         "5. \"stat\"        (string, optional) if set to the string \"stat\", print statistics instead of returning the names\n"
+        "\nCompatibility note:\n"
+        "\"^\" and \"$\" no longer match at line breaks inside a name, only at its"
+        " start and end.  Use \"\\n\" to match line breaks explicitly.\n"
         "\nResult:\n"
         "[\n"
         + getNameInfoHelp ("  ", ",") +
@@ -301,6 +344,7 @@ name_filter (const JSONRPCRequest& request)
 
   bool haveRegexp(false);
   boost::xpressive::sregex regexp;
+  valtype prefix;
 
   int maxage(36000), from(0), nb(0);
   bool stats(false);
@@ -308,7 +352,14 @@ name_filter (const JSONRPCRequest& request)
   if (request.params.size () >= 1)
     {
       haveRegexp = true;
-      regexp = boost::xpressive::sregex::compile (request.params[0].get_str ());
+      const std::string& str = request.params[0].get_str ();
+      /* "^" and "$" match only at the start and end of the whole name.
+         This is what a filter on names means, and it allows seeking
+         to the literal prefix of anchored expressions.  */
+      regexp = boost::xpressive::sregex::compile (
+          str, boost::xpressive::regex_constants::ECMAScript
+                | boost::xpressive::regex_constants::single_line);
+      prefix = GetRegexLiteralPrefix (str);
     }
 
   if (request.params.size () >= 2)
@@ -334,49 +385,132 @@ name_filter (const JSONRPCRequest& request)
       stats = true;
     }
 
-  /* ******************************************* */
-  /* Iterate over names to build up the result.  */
+  /* ************************************************************* */
+  /* Take a snapshot of the name database, so that the potentially
+     long iteration below does not need to hold cs_main.  */
 
-  UniValue names(UniValue::VARR);
-  unsigned count(0);
+  int height;
+  std::unique_ptr<CNameIterator> iter;
+  bool ordered;
+  {
+    LOCK (cs_main);
+    height = chainActive.Height ();
+
+    /* Use the height index if it allows us to skip old names.  If we have
+       a prefix and all names are recent enough anyway, it is better to
+       only iterate the names with the prefix.  */
+    const int minHeight = height - maxage + 1;
+    ordered = (!fNameHeightIndex || maxage == 0
+                || (minHeight <= 0 && !prefix.empty ()));
+    if (ordered)
+      iter.reset (pcoinsTip->IterateNamesSnapshot ());
+    else
+      iter.reset (pcoinsTip->IterateRecentNames (std::max (minHeight, 0)));
+  }
 
-  LOCK (cs_main);
+  /* ************************************************************* */
+  /* Go through all names matching the filter.  Matches in the requested
+     page are counted or put into the result directly.  Only names from the
+     height index need to be collected first (unless we just count them),
+     since they have to be sorted before paging.  The callback returns
+     false to stop the iteration.  */
 
-  valtype name;
-  CNameData data;
-  std::unique_ptr<CNameIterator> iter(pcoinsTip->IterateNames ());
-  while (iter->next (name, data))
+  UniValue names(UniValue::VARR);
+  unsigned count(0);
+  unsigned matched(0);
+  const bool needSort = (!ordered && !stats);
+  std::vector<std::pair<valtype, CNameData>> matches;
+  const auto filter = [&] (const valtype& name, const CNameData& data)
     {
-      const int age = chainActive.Height () - data.getHeight ();
+      const int age = height - data.getHeight ();
       assert (age >= 0);
       if (maxage != 0 && age >= maxage)
-        continue;
+        return true;
+
+      if (name.size () < prefix.size ()
+            || !std::equal (prefix.begin (), prefix.end (), name.begin ()))
+        return true;
 
       if (haveRegexp)
         {
           const std::string nameStr = ValtypeToString (name);
-          boost::xpressive::smatch matches;
-          if (!boost::xpressive::regex_search (nameStr, matches, regexp))
-            continue;
+          boost::xpressive::smatch m;
+          if (!boost::xpressive::regex_search (nameStr, m, regexp))
+            return true;
         }
 
-      if (from > 0)
+      if (needSort)
         {
-          --from;
-          continue;
+          matches.emplace_back (name, data);
+          return true;
         }
-      assert (from == 0);
 
-      if (stats)
-        ++count;
-      else
-        names.push_back (getNameInfo (name, data));
+      const unsigned pos = matched++;
+      if (pos >= static_cast<unsigned> (from)
+            && (nb == 0 || pos < static_cast<unsigned> (from + nb)))
+        {
+          if (stats)
+            ++count;
+          else
+            names.push_back (getNameInfo (name, data));
+        }
+
+      /* If names are iterated in order, stop as soon as we have
+         filled the requested page.  */
+      return !ordered || nb == 0
+              || matched < static_cast<unsigned> (from + nb);
+    };
 
-      if (nb > 0)
+  valtype name;
+  CNameData data;
+  if (ordered && !prefix.empty ())
+    {
+      /* The database is sorted by the length of names first.  Thus
+         seek to the prefix separately for each name length.  */
+      bool more = true;
+      for (unsigned len = prefix.size (); more && len <= MAX_NAME_LENGTH;
+           ++len)
         {
-          --nb;
-          if (nb == 0)
+          valtype start(prefix);
+          start.resize (len, 0);
+          for (iter->seek (start); iter->next (name, data); )
+            {
+              if (name.size () != len
+                    || !std::equal (prefix.begin (), prefix.end (),
+                                    name.begin ()))
+                break;
+              if (!filter (name, data))
+                {
+                  more = false;
+                  break;
+                }
+            }
+        }
+    }
+  else
+    {
+      while (iter->next (name, data))
+        if (!filter (name, data))
+          break;
+    }
+
+  /* Names from the height index come in no particular order.  Sort them
+     like the name database, so that paging works in the same way.  */
+  if (needSort)
+    {
+      CNameCache::NameComparator cmp;
+      std::sort (matches.begin (), matches.end (),
+                 [&cmp] (const std::pair<valtype, CNameData>& a,
+                         const std::pair<valtype, CNameData>& b)
+                   {
+                     return cmp (a.first, b.first);
+                   });
+
+      for (unsigned i = from; i < matches.size (); ++i)
+        {
+          if (nb > 0 && i >= static_cast<unsigned> (from + nb))
             break;
+          names.push_back (getNameInfo (matches[i].first, matches[i].second));
         }
     }
 
@@ -386,7 +520,7 @@ name_filter (const JSONRPCRequest& request)
   if (stats)
     {
       UniValue res(UniValue::VOBJ);
-      res.pushKV ("blocks", chainActive.Height ());
+      res.pushKV ("blocks", height);
       res.pushKV ("count", static_cast<int> (count));
 
       return res;
@@ -432,23 +566,26 @@ name_pending (const JSONRPCRequest& request)
   LOCK (mempool.cs);
 #endif
 
-  std::vector<uint256> txHashes;
+  std::vector<CTransactionRef> txs;
   if (request.params.size () == 0)
-    mempool.queryHashes (txHashes);
+    {
+      std::vector<uint256> txHashes;
+      mempool.queryHashes (txHashes);
+      for (const auto& txid : txHashes)
+        txs.push_back (mempool.get (txid));
+    }
   else
     {
       const std::string name = request.params[0].get_str ();
       const valtype vchName = ValtypeFromString (name);
-      const uint256 txid = mempool.getTxForName (vchName);
-      if (!txid.IsNull ())
-        txHashes.push_back (txid);
+      const CTransactionRef tx = mempool.getPendingNameTx (vchName);
+      if (tx)
+        txs.push_back (tx);
     }
 
   UniValue arr(UniValue::VARR);
-  for (std::vector<uint256>::const_iterator i = txHashes.begin ();
-       i != txHashes.end (); ++i)
+  for (const auto& tx : txs)
     {
-      std::shared_ptr<const CTransaction> tx = mempool.get (*i);
       if (!tx || !tx->IsNamecoin ())
         continue;
 
@@ -674,7 +811,7 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "namecoin",           "name_show",              &name_show,              {"name"} },
-    { "namecoin",           "name_history",           &name_history,           {"name"} },
+    { "namecoin",           "name_history",           &name_history,           {"name","start","count"} },
     { "namecoin",           "name_scan",              &name_scan,              {"start","count"} },
     { "namecoin",           "name_filter",            &name_filter,            {"regexp","maxage","from","nb","stat"} },
     { "namecoin",           "name_pending",           &name_pending,           {"name"} },
@@ -50,6 +50,18 @@ std::string JSONRPCReply(const UniValue& result, const UniValue& error, const Un
     return reply.write() + "\n";
 }
 
+std::string JSONRPCRawReplyBegin()
+{
+    return "{\"result\":";
+}
+
+void JSONRPCRawReplyEnd(std::string& reply, const UniValue& id)
+{
+    reply += ",\"error\":null,\"id\":";
+    reply += id.write();
+    reply += "}\n";
+}
+
 UniValue JSONRPCError(int code, const std::string& message)
 {
     UniValue error(UniValue::VOBJ);
@@ -19,6 +19,7 @@
 enum HTTPStatusCode
 {
     HTTP_OK                    = 200,
+    HTTP_NOT_MODIFIED          = 304,
     HTTP_BAD_REQUEST           = 400,
     HTTP_UNAUTHORIZED          = 401,
     HTTP_FORBIDDEN             = 403,
@@ -93,6 +94,10 @@ enum RPCErrorCode
 UniValue JSONRPCRequestObj(const std::string& strMethod, const UniValue& params, const UniValue& id);
 UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const UniValue& id);
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
+/** Start a reply (as by JSONRPCReply) whose result is appended as JSON text. */
+std::string JSONRPCRawReplyBegin();
+/** Complete a reply started with JSONRPCRawReplyBegin after the result. */
+void JSONRPCRawReplyEnd(std::string& reply, const UniValue& id);
 UniValue JSONRPCError(int code, const std::string& message);
 
 /** Generate a new RPC authentication cookie and write it to disk */
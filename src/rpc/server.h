@@ -53,7 +53,15 @@ public:
     std::string authUser;
     std::string peerAddr;
 
-    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
+    /**
+     * If set, a method may append its result as JSON text to this buffer
+     * instead of returning it as UniValue.  It returns NullUniValue then.
+     * This is offered by the HTTP server for single requests, so that large
+     * results (like game states) are written straight into the reply.
+     */
+    std::string* rawResult;
+
+    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false), rawResult(nullptr) {}
     void parse(const UniValue& valRequest);
 };
 
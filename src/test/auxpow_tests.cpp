@@ -3,12 +3,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "auxpow.h"
+#include "chain.h"
 #include "chainparams.h"
 #include "coins.h"
 #include "consensus/merkle.h"
+#include "consensus/validation.h"
 #include "validation.h"
 #include "primitives/block.h"
 #include "script/script.h"
+#include "txdb.h"
 #include "utilstrencodings.h"
 #include "uint256.h"
 
@@ -453,4 +456,169 @@ BOOST_AUTO_TEST_CASE (auxpow_pow)
 
 /* ************************************************************************** */
 
+BOOST_FIXTURE_TEST_CASE (auxpow_header_index, TestingSetup)
+{
+  const Consensus::Params& params = Params ().GetConsensus ();
+
+  CAuxpowBuilder builder(5, 42);
+  CScript scr = (CScript () << 2809 << 2013) + COINBASE_FLAGS;
+  builder.setCoinbase (scr);
+  const CAuxPow auxpow = builder.get ();
+
+  CBlockHeader header;
+  header.nTime = 1234;
+  header.nBits = 0x207fffff;
+  header.SetBaseVersion (2, params.nAuxpowChainId[ALGO_SHA256D]);
+  header.SetAuxpowVersion (true);
+  const uint256 hash = header.GetHash ();
+
+  CBlockIndex index(header);
+  index.phashBlock = &hash;
+
+  /* The block is not on disk, so without the stored auxpow the header
+     cannot be reconstructed.  */
+  BOOST_CHECK (!index.GetBlockHeader (params).auxpow);
+
+  BOOST_CHECK (pblocktree->WriteAuxpows ({std::make_pair (hash, &auxpow)}));
+  CAuxPow stored;
+  BOOST_CHECK (pblocktree->ReadAuxpow (hash, stored));
+  BOOST_CHECK (stored.GetHash () == auxpow.GetHash ());
+
+  /* The second lookup is served from the cache.  */
+  for (unsigned i = 0; i < 2; ++i)
+    {
+      const CBlockHeader res = index.GetBlockHeader (params);
+      BOOST_CHECK (res.GetHash () == hash);
+      BOOST_REQUIRE (res.auxpow);
+      BOOST_CHECK (res.auxpow->GetHash () == auxpow.GetHash ());
+    }
+}
+
+/* ************************************************************************** */
+
+/**
+ * Construct a chain of headers on top of the given block.
+ * @param prev The block to build on.
+ * @param num Number of headers to construct.
+ * @param badIndex Index of a header with invalid PoW, or -1 for none.
+ * @return The constructed headers.
+ */
+static std::vector<CBlockHeader>
+buildHeaders (const CBlockIndex& prev, const unsigned num, const int badIndex)
+{
+  const Consensus::Params& params = Params ().GetConsensus ();
+
+  std::vector<CBlockHeader> headers;
+  uint256 hashPrev = prev.GetBlockHash ();
+  for (unsigned i = 0; i < num; ++i)
+    {
+      CBlockHeader header;
+      header.SetBaseVersion (4, params.nAuxpowChainId[ALGO_SHA256D]);
+      header.hashPrevBlock = hashPrev;
+      header.nTime = prev.nTime + 1 + i;
+      header.nBits = prev.nBits;
+      mineBlock (header, static_cast<int> (i) != badIndex);
+
+      headers.push_back (header);
+      hashPrev = header.GetHash ();
+    }
+
+  return headers;
+}
+
+BOOST_FIXTURE_TEST_CASE (header_batch_pow, TestChain100Setup)
+{
+  const CBlockIndex* tip;
+  {
+    LOCK (cs_main);
+    tip = chainActive.Tip ();
+  }
+
+  /* The batch is accepted up to the header with invalid PoW, which is
+     rejected even though its PoW was checked before taking cs_main.  */
+  CValidationState state;
+  const CBlockIndex* pindex = nullptr;
+  CBlockHeader firstInvalid;
+  std::vector<CBlockHeader> headers = buildHeaders (*tip, 20, 12);
+  BOOST_CHECK (!ProcessNewBlockHeaders (headers, state, Params (),
+                                        &pindex, &firstInvalid));
+  BOOST_CHECK_EQUAL (state.GetRejectReason (), "high-hash");
+  BOOST_CHECK (firstInvalid.GetHash () == headers[12].GetHash ());
+  BOOST_REQUIRE (pindex != nullptr);
+  BOOST_CHECK (pindex->GetBlockHash () == headers[11].GetHash ());
+
+  /* A valid batch that partly overlaps the known headers.  */
+  state = CValidationState ();
+  headers = buildHeaders (*tip, 20, -1);
+  BOOST_CHECK (ProcessNewBlockHeaders (headers, state, Params (), &pindex));
+  BOOST_CHECK (state.IsValid ());
+  BOOST_CHECK (pindex->GetBlockHash () == headers.back ().GetHash ());
+  BOOST_CHECK_EQUAL (pindex->nHeight, tip->nHeight + 20);
+}
+
+/* ************************************************************************** */
+
+BOOST_FIXTURE_TEST_CASE (auxpow_index_flush, TestChain100Setup)
+{
+  const Consensus::Params& params = Params ().GetConsensus ();
+  const CBlockIndex* tip;
+  {
+    LOCK (cs_main);
+    tip = chainActive.Tip ();
+  }
+
+  /* Construct a merge-mined header on top of the tip.  */
+  CBlockHeader block;
+  block.SetBaseVersion (4, params.nAuxpowChainId[ALGO_SHA256D]);
+  block.hashPrevBlock = tip->GetBlockHash ();
+  block.nTime = tip->nTime + 1;
+  block.nBits = tip->nBits;
+  block.SetAuxpowVersion (true);
+
+  CAuxpowBuilder builder(5, 42);
+  const unsigned height = 3;
+  const int nonce = 7;
+  const int index
+    = CAuxPow::getExpectedIndex (nonce, block.GetChainId (), height);
+  const valtype auxRoot
+    = builder.buildAuxpowChain (block.GetHash (), height, index);
+  const valtype data
+    = CAuxpowBuilder::buildCoinbaseData (true, auxRoot, height, nonce);
+  builder.setCoinbase (CScript () << data);
+  mineBlock (builder.parentBlock, true, block.nBits);
+  block.SetAuxpow (new CAuxPow (builder.get ()));
+  const uint256 hash = block.GetHash ();
+
+  CValidationState state;
+  const CBlockIndex* pindex = nullptr;
+  BOOST_REQUIRE (ProcessNewBlockHeaders ({block}, state, Params (), &pindex));
+  BOOST_REQUIRE (pindex != nullptr && pindex->GetBlockHash () == hash);
+
+  /* The auxpow is available right away, but only written to disk together
+     with the block index.  */
+  CAuxPow stored;
+  BOOST_REQUIRE (LookupIndexedAuxpow (hash));
+  BOOST_CHECK (!pblocktree->ReadAuxpow (hash, stored));
+  FlushStateToDisk ();
+  BOOST_CHECK (pblocktree->ReadAuxpow (hash, stored));
+  BOOST_CHECK (stored.GetHash () == block.auxpow->GetHash ());
+
+  const CBlockHeader res = pindex->GetBlockHeader (params);
+  BOOST_CHECK (res.GetHash () == hash);
+  BOOST_REQUIRE (res.auxpow);
+  BOOST_CHECK (res.auxpow->GetHash () == block.auxpow->GetHash ());
+
+  /* The entry is erased when the block is marked invalid.  */
+  {
+    LOCK (cs_main);
+    CBlockIndex* pindexMut = LookupBlockIndex (hash);
+    BOOST_REQUIRE (InvalidateBlock (state, Params (), pindexMut));
+  }
+  FlushStateToDisk ();
+  BOOST_CHECK (!pblocktree->ReadAuxpow (hash, stored));
+  BOOST_CHECK (!LookupIndexedAuxpow (hash));
+}
+
+/* ************************************************************************** */
+
 BOOST_AUTO_TEST_SUITE_END ()
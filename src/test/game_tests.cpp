@@ -0,0 +1,1146 @@
+// Copyright (C) 2018 Crypto Realities Ltd
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <arith_uint256.h>
+#include <chainparams.h>
+#include <core_io.h>
+#include <consensus/validation.h>
+#include <game/common.h>
+#include <game/db.h>
+#include <game/delta.h>
+#include <game/jsonwriter.h>
+#include <game/map.h>
+#include <game/move.h>
+#include <game/movecreator.h>
+#include <game/state.h>
+#include <game/tiles.h>
+#include <hash.h>
+#include <key_io.h>
+#include <miner.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/interpreter.h>
+#include <script/names.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <utilstrencodings.h>
+#include <validation.h>
+#include <version.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* No space between BOOST_FIXTURE_TEST_SUITE and '(', so that extraction of
+   the test-suite name works with grep as done in the Makefile.  */
+BOOST_FIXTURE_TEST_SUITE(game_tests, BasicTestingSetup)
+
+namespace
+{
+
+/**
+ * Return the serialised form of some object as string, so that we can
+ * easily compare game states for equality.
+ */
+template<typename T>
+  std::string
+  Serialised (const T& obj)
+{
+  CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+  ss << obj;
+  return ss.str ();
+}
+
+/**
+ * Construct a player state with one character at the given position.
+ */
+PlayerState
+MakePlayer (unsigned char color, const Coord& pos)
+{
+  PlayerState res;
+  res.color = color;
+  res.value = 100 * COIN;
+  res.lockedCoins = 100 * COIN;
+  res.characters[0].coord = pos;
+  res.characters[0].from = pos;
+  res.next_character_index = 1;
+
+  return res;
+}
+
+/**
+ * Construct a name output with the given move.  The address is empty
+ * by default, which is fine for the game engine but not standard.
+ */
+CTxOut
+MoveOutput (const std::string& name, const std::string& value,
+            const CAmount locked, const bool firstUpdate,
+            const CScript& addr = CScript ())
+{
+  const valtype vchName(name.begin (), name.end ());
+  const valtype vchValue(value.begin (), value.end ());
+
+  CScript script;
+  if (firstUpdate)
+    script = CNameScript::buildNameRegister (addr, vchName, vchValue);
+  else
+    script = CNameScript::buildNameUpdate (addr, vchName, vchValue);
+
+  return CTxOut (locked, script);
+}
+
+/**
+ * The original implementation of RandomGenerator based on generic 256-bit
+ * arithmetic.  It defines the consensus behaviour, and the optimised
+ * implementation is checked against it.
+ */
+class LegacyRandomGenerator
+{
+
+private:
+
+  uint256 state0;
+  arith_uint256 state;
+
+public:
+
+  explicit LegacyRandomGenerator (const uint256& hashBlock)
+    : state0(SerializeHash (hashBlock, SER_GETHASH, 0))
+  {
+    state = UintToArith256 (state0);
+  }
+
+  int
+  GetIntRnd (int modulo)
+  {
+    static const arith_uint256 minState
+      = arith_uint256 ().SetCompact (0x097FFFFFu);
+
+    if (state < minState)
+      {
+        valtype data(state0.begin (), state0.end ());
+        while (data.back () == 0)
+          data.pop_back ();
+        if (data.back () & 128)
+          data.push_back (0);
+
+        state0 = SerializeHash (data, SER_GETHASH, 0);
+        state = UintToArith256 (state0);
+      }
+
+    arith_uint256 res = state;
+    state /= modulo;
+    res -= state * modulo;
+
+    return res.GetLow64 ();
+  }
+
+};
+
+/**
+ * Parse the move with both the move parser and the UniValue-based one,
+ * and check that they agree.  Returns whether the move was accepted.
+ */
+bool
+ParseBothWays (const std::string& json)
+{
+  Move fast, reference;
+  const bool okFast = fast.Parse ("domob", json);
+  const bool okReference = reference.ParseWithUniValue ("domob", json);
+
+  BOOST_CHECK_MESSAGE (okFast == okReference, "parsers disagree on " + json);
+  if (okFast && okReference)
+    BOOST_CHECK_MESSAGE (fast == reference, "moves differ for " + json);
+
+  return okFast;
+}
+
+} // anonymous namespace
+
+/* ************************************************************************** */
+
+BOOST_AUTO_TEST_CASE (player_id)
+{
+  const PlayerID a("domob");
+  const PlayerID b(std::string ("dom") + "ob");
+  const PlayerID c("Domob");
+  BOOST_CHECK (a == b);
+  BOOST_CHECK (&a.str () == &b.str ());
+  BOOST_CHECK (a != c);
+  BOOST_CHECK (PlayerID ().empty () && PlayerID () == PlayerID (""));
+
+  /* Ordering is the one of the strings.  */
+  BOOST_CHECK (c < a && !(a < c) && !(a < b));
+  BOOST_CHECK (PlayerID ("a b") < PlayerID ("a_b"));
+
+  /* Serialisation is the same as for strings.  */
+  BOOST_CHECK (Serialised (a) == Serialised (std::string ("domob")));
+  CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+  ss << std::string ("domob");
+  PlayerID read;
+  ss >> read;
+  BOOST_CHECK (read == a);
+
+  /* Names are removed from the table when no longer referenced, and
+     Lookup does not add them.  */
+  const size_t numBefore = PlayerID::NumInterned ();
+  PlayerID found;
+  BOOST_CHECK (!PlayerID::Lookup ("unknown player", found));
+  BOOST_CHECK (found.empty ());
+  BOOST_CHECK_EQUAL (PlayerID::NumInterned (), numBefore);
+  {
+    const PlayerID tmp("unknown player");
+    BOOST_CHECK_EQUAL (PlayerID::NumInterned (), numBefore + 1);
+    BOOST_CHECK (PlayerID::Lookup ("unknown player", found));
+    BOOST_CHECK (found == tmp);
+  }
+  BOOST_CHECK (!found.empty ());
+  found = PlayerID ();
+  BOOST_CHECK_EQUAL (PlayerID::NumInterned (), numBefore);
+  BOOST_CHECK (PlayerID::Lookup ("domob", found) && found == a);
+}
+
+BOOST_AUTO_TEST_CASE (copy_on_write)
+{
+  const CowPtr<PlayerState> a(MakePlayer (1, Coord (10, 20)));
+  CowPtr<PlayerState> b = a;
+  BOOST_CHECK (a.SharesWith (b));
+
+  b.Modify ().value = 42;
+  BOOST_CHECK (!a.SharesWith (b));
+  BOOST_CHECK_EQUAL (a->value, 100 * COIN);
+  BOOST_CHECK_EQUAL (b->value, 42);
+
+  /* A second modification of the now unique instance does not copy.  */
+  const PlayerState* ptr = &*b;
+  b.Modify ().color = 2;
+  BOOST_CHECK_EQUAL (ptr, &*b);
+
+  BOOST_CHECK (Serialised (a) == Serialised (*a));
+}
+
+BOOST_AUTO_TEST_CASE (flat_containers)
+{
+  /* The compact containers must serialise exactly as the standard
+     containers that were used before.  */
+  std::vector<Coord> wpVector;
+  WaypointVector wp;
+  for (int i = 0; i < 5; ++i)
+    {
+      BOOST_CHECK (Serialised (wp) == Serialised (wpVector));
+      wpVector.push_back (Coord (i, 2 * i));
+      wp.push_back (Coord (i, 2 * i));
+    }
+
+  std::map<int, CharacterState> charMap;
+  CharacterMap chars;
+  BOOST_CHECK (Serialised (chars) == Serialised (charMap));
+  for (const int i : {3, 0, 5, 1})
+    {
+      CharacterState ch;
+      ch.coord = Coord (i, i);
+      ch.waypoints = wp;
+      charMap[i] = ch;
+      BOOST_CHECK (chars.insert (std::make_pair (i, ch)).second);
+    }
+  BOOST_CHECK (!chars.insert (std::make_pair (3, CharacterState ())).second);
+  BOOST_CHECK (Serialised (chars) == Serialised (charMap));
+
+  CharacterMap::const_iterator ci = chars.begin ();
+  for (const auto& entry : charMap)
+    {
+      BOOST_CHECK_EQUAL (ci->first, entry.first);
+      ++ci;
+    }
+
+  BOOST_CHECK_EQUAL (chars.erase (0), 1);
+  BOOST_CHECK_EQUAL (chars.erase (0), 0);
+  charMap.erase (0);
+  chars[2].coord = Coord (2, 2);
+  charMap[2].coord = Coord (2, 2);
+  BOOST_CHECK (chars.count (2) == 1 && chars.find (4) == chars.end ());
+  BOOST_CHECK (Serialised (chars) == Serialised (charMap));
+
+  CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+  ss << charMap;
+  CharacterMap readChars;
+  ss >> readChars;
+  BOOST_CHECK (Serialised (readChars) == Serialised (charMap));
+}
+
+BOOST_AUTO_TEST_CASE (state_delta)
+{
+  GameState from(Params ().GetConsensus ());
+  from.players.insert (std::make_pair ("domob",
+                       CowPtr<PlayerState> (MakePlayer (0, Coord (1, 2)))));
+  from.players.insert (std::make_pair ("killed",
+                       CowPtr<PlayerState> (MakePlayer (1, Coord (3, 4)))));
+  from.players.insert (std::make_pair ("unchanged",
+                       CowPtr<PlayerState> (MakePlayer (2, Coord (5, 6)))));
+  from.loot[Coord (7, 8)] = LootInfo (COIN, 10);
+  from.loot[Coord (9, 10)] = LootInfo (COIN, 10);
+  from.hearts.insert (Coord (11, 12));
+  from.nHeight = 10;
+  from.hashBlock = uint256S ("01");
+  from.RecomputeCoinTotals ();
+
+  GameState to = from;
+  to.players.erase ("killed");
+  to.players["domob"].Modify ().characters[0].coord = Coord (2, 2);
+  to.players.insert (std::make_pair ("spawned",
+                     CowPtr<PlayerState> (MakePlayer (3, Coord (0, 0)))));
+  to.loot.erase (Coord (7, 8));
+  to.loot[Coord (9, 10)].nAmount += COIN;
+  to.loot[Coord (13, 14)] = LootInfo (COIN, 11);
+  to.hearts.erase (Coord (11, 12));
+  to.hearts.insert (Coord (15, 16));
+  to.crownHolder = CharacterID ("domob", 0);
+  to.gameFund = 42;
+  to.nHeight = 11;
+  to.hashBlock = uint256S ("02");
+
+  const GameStateDelta delta(from, to);
+  BOOST_CHECK (delta.GetPrevHash () == from.hashBlock);
+  BOOST_CHECK (delta.GetHash () == to.hashBlock);
+
+  /* Round-trip the delta through serialisation as done by the game DB.  */
+  CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+  ss << delta;
+  GameStateDelta readDelta;
+  ss >> readDelta;
+
+  GameState reconstructed = from;
+  readDelta.Apply (reconstructed);
+  BOOST_CHECK (Serialised (reconstructed) == Serialised (to));
+  BOOST_CHECK (reconstructed.coinTotals == reconstructed.ScanCoinTotals ());
+
+  /* Players that were not changed should still be shared.  */
+  BOOST_CHECK (reconstructed.players.find ("unchanged")->second.SharesWith (
+                  from.players.find ("unchanged")->second));
+
+  /* The inverted delta leads back to the old state.  */
+  const GameStateDelta undo = readDelta.Invert (from);
+  BOOST_CHECK (undo.GetPrevHash () == to.hashBlock);
+  BOOST_CHECK (undo.GetHash () == from.hashBlock);
+  GameState reverted = reconstructed;
+  undo.Apply (reverted);
+  BOOST_CHECK (Serialised (reverted) == Serialised (from));
+  BOOST_CHECK (reverted.coinTotals == from.coinTotals);
+}
+
+BOOST_AUTO_TEST_CASE (coin_totals)
+{
+  /* Find two horizontally adjacent walkable tiles away from the spawn
+     areas, and a third one farther away.  */
+  Coord pos(-1, -1);
+  for (int y = 50; y < MAP_HEIGHT - 50 && pos.x == -1; ++y)
+    for (int x = 50; x < MAP_WIDTH - 50 && pos.x == -1; ++x)
+      if (IsWalkable (x, y) && IsWalkable (x + 1, y) && IsWalkable (x + 20, y))
+        pos = Coord (x, y);
+  BOOST_REQUIRE (pos.x != -1);
+  const Coord neighbour(pos.x + 1, pos.y);
+  const Coord far(pos.x + 20, pos.y);
+
+  GameState state(Params ().GetConsensus ());
+  state.nHeight = 10;
+  state.hashBlock = uint256S ("01");
+  state.players.insert (std::make_pair ("attacker",
+                        CowPtr<PlayerState> (MakePlayer (0, pos))));
+  state.players.insert (std::make_pair ("victim",
+                        CowPtr<PlayerState> (MakePlayer (1, neighbour))));
+  state.players.insert (std::make_pair ("collector",
+                        CowPtr<PlayerState> (MakePlayer (2, far))));
+  state.players["victim"].Modify ().characters[0].loot.nAmount = 3 * COIN;
+  state.AddLoot (far, 5 * COIN);
+  state.RecomputeCoinTotals ();
+  BOOST_CHECK_EQUAL (state.GetCoinsOnMap (), 308 * COIN);
+
+  Move destruct;
+  destruct.player = "attacker";
+  destruct.newLocked = 100 * COIN;
+  destruct.destruct.insert (0);
+
+  StepData step(state);
+  step.vMoves.push_back (destruct);
+  step.nTreasureAmount = 9 * COIN;
+  step.newHash = uint256S ("02");
+
+  fCheckGameCoins = true;
+
+  GameState out(Params ().GetConsensus ());
+  StepResult res;
+  BOOST_REQUIRE (PerformStep (state, step, out, res));
+  BOOST_CHECK (out.players.count ("victim") == 0);
+  BOOST_CHECK (out.coinTotals == out.ScanCoinTotals ());
+  BOOST_CHECK (out.players.find ("collector")->second->characters.find (0)
+                  ->second.loot.nAmount > 0);
+
+  /* Corrupt the running totals.  This is detected with the debug check.  */
+  state.coinTotals.lootOnMap += COIN;
+  BOOST_CHECK (!PerformStep (state, step, out, res));
+
+  /* Without it, the totals are verified when they are due for the periodic
+     scan or were never verified at all.  A mismatch is not an error; the
+     totals are replaced by the scan instead.  */
+  fCheckGameCoins = false;
+  BOOST_CHECK (!state.NeedsCoinTotalsScan ());
+  state.nCoinTotalsScanned = state.nHeight - COIN_TOTALS_SCAN_INTERVAL;
+  BOOST_CHECK (state.NeedsCoinTotalsScan ());
+  BOOST_REQUIRE (PerformStep (state, step, out, res));
+  BOOST_CHECK (out.coinTotals == out.ScanCoinTotals ());
+  state.nCoinTotalsScanned = -1;
+  BOOST_REQUIRE (PerformStep (state, step, out, res));
+  BOOST_CHECK (out.coinTotals == out.ScanCoinTotals ());
+
+  /* With correct totals, the scan marks the new state as verified.  */
+  state.RecomputeCoinTotals ();
+  state.nCoinTotalsScanned = -1;
+  BOOST_REQUIRE (PerformStep (state, step, out, res));
+  BOOST_CHECK_EQUAL (out.nCoinTotalsScanned, out.nHeight);
+  BOOST_CHECK (!out.NeedsCoinTotalsScan ());
+}
+
+BOOST_AUTO_TEST_CASE (memory_usage)
+{
+  GameState state(Params ().GetConsensus ());
+  const size_t empty = RecursiveDynamicUsage (state);
+  BOOST_CHECK_EQUAL (empty, RecursiveDynamicUsage (state, false));
+
+  state.players.insert (std::make_pair ("domob",
+                        CowPtr<PlayerState> (MakePlayer (0, Coord (1, 2)))));
+  state.AddLoot (Coord (5, 5), COIN);
+  const size_t withPlayers = RecursiveDynamicUsage (state);
+  const size_t withoutPlayers = RecursiveDynamicUsage (state, false);
+  BOOST_CHECK (withoutPlayers > empty);
+  BOOST_CHECK (withPlayers > withoutPlayers);
+
+  /* Longer paths and messages use more memory.  */
+  PlayerState& pl = state.players["domob"].Modify ();
+  for (int i = 0; i < 10; ++i)
+    pl.characters[0].waypoints.push_back (Coord (i, i));
+  pl.message = std::string (1000, 'x');
+  const size_t bigPlayer = RecursiveDynamicUsage (pl);
+  BOOST_CHECK (bigPlayer >= 1000 + 10 * sizeof (Coord));
+  BOOST_CHECK_EQUAL (RecursiveDynamicUsage (state),
+                     withoutPlayers + state.players["domob"].DynamicUsage ()
+                       + bigPlayer);
+}
+
+BOOST_AUTO_TEST_CASE (json_writer)
+{
+  const std::string special("a\"b\\c\n\t\x01\x7f\xc3\xa4/");
+
+  UniValue expected(UniValue::VOBJ);
+  expected.pushKV ("int", -42);
+  expected.pushKV ("big", static_cast<int64_t> (1) << 40);
+  expected.pushKV ("bool", false);
+  expected.pushKV (special, special);
+  UniValue arr(UniValue::VARR);
+  arr.push_back (ValueFromAmount (0));
+  arr.push_back (ValueFromAmount (123456789));
+  arr.push_back (ValueFromAmount (-5 * COIN - 1));
+  arr.push_back (UniValue (UniValue::VARR));
+  arr.push_back (UniValue (UniValue::VOBJ));
+  expected.pushKV ("arr", arr);
+
+  std::string json;
+  JsonWriter writer(json);
+  writer.BeginObject ();
+  writer.Key ("int");
+  writer.Int (-42);
+  writer.Key ("big");
+  writer.Int (static_cast<int64_t> (1) << 40);
+  writer.Key ("bool");
+  writer.Bool (false);
+  writer.Key (special);
+  writer.String (special);
+  writer.Key ("arr");
+  writer.BeginArray ();
+  writer.Amount (0);
+  writer.Amount (123456789);
+  writer.Amount (-5 * COIN - 1);
+  writer.BeginArray ();
+  writer.EndArray ();
+  writer.BeginObject ();
+  writer.EndObject ();
+  writer.EndArray ();
+  BOOST_CHECK (!writer.IsComplete ());
+  writer.EndObject ();
+  BOOST_CHECK (writer.IsComplete ());
+
+  BOOST_CHECK_EQUAL (json, expected.write ());
+}
+
+BOOST_AUTO_TEST_CASE (state_json)
+{
+  GameState state(Params ().GetConsensus ());
+  state.players.insert (std::make_pair ("domob",
+                        CowPtr<PlayerState> (MakePlayer (0, Coord (1, 2)))));
+  state.players.insert (std::make_pair ("other",
+                        CowPtr<PlayerState> (MakePlayer (1, Coord (3, 4)))));
+  PlayerState& pl = state.players["domob"].Modify ();
+  pl.message = "Hello \"world\"";
+  pl.message_block = 5;
+  pl.characters[1].coord = Coord (5, 6);
+  pl.characters[1].waypoints.push_back (Coord (10, 11));
+  pl.characters[1].waypoints.push_back (Coord (7, 8));
+  state.crownHolder = CharacterID ("domob", 1);
+  state.dead_players_chat["dead"].message = "Bye";
+  state.loot[Coord (7, 8)] = LootInfo (COIN, 10);
+  state.hearts.insert (Coord (11, 12));
+  state.gameFund = 42;
+  state.nHeight = 10;
+  state.hashBlock = uint256S ("01");
+
+  std::string json;
+  JsonWriter writer(json);
+  state.WriteJson (writer);
+  BOOST_REQUIRE (writer.IsComplete ());
+
+  UniValue val;
+  BOOST_REQUIRE (val.read (json));
+  const UniValue& players = find_value (val, "players");
+  BOOST_CHECK_EQUAL (players.getKeys ().size (), 3);
+  const UniValue& domob = find_value (players, "domob");
+  BOOST_CHECK_EQUAL (find_value (domob, "msg").get_str (), "Hello \"world\"");
+  const UniValue& ch = find_value (find_value (domob, "characters"), "1");
+  BOOST_CHECK_EQUAL (find_value (ch, "wp").write (), "[7,8,10,11]");
+  BOOST_CHECK (find_value (ch, "has_crown").get_bool ());
+  BOOST_CHECK_EQUAL (find_value (find_value (players, "dead"), "dead").get_int (), 1);
+  BOOST_CHECK_EQUAL (find_value (val, "loot")[0].write (),
+                     "{\"x\":7,\"y\":8,\"amount\":1.00000000,"
+                     "\"blockRange\":[10,10]}");
+  BOOST_CHECK_EQUAL (find_value (val, "banks").size (), state.banks.size ());
+  BOOST_CHECK_EQUAL (find_value (val, "gameFund").getValStr (), "0.00000042");
+  BOOST_CHECK_EQUAL (find_value (val, "hashBlock").get_str (),
+                     state.hashBlock.GetHex ());
+}
+
+BOOST_AUTO_TEST_CASE (move_parser)
+{
+  const uint160 hash(ParseHex ("42424242424242424242"
+                               "42424242424242424242"));
+  const std::string addr = EncodeDestination (CKeyID (hash));
+  const std::string p2sh = EncodeDestination (CScriptID (hash));
+
+  const std::vector<std::string> accepted = {
+    R"({})",
+    R"({"color":0})",
+    R"({"color":3,"msg":"hi","address":""})",
+    R"({"color":256})",
+    R"({"color":-255})",
+    R"( { "0" : { "wp" : [ 1 , 2 , 3 , 4 ] } } )",
+    R"({"0":{"wp":[]},"1":{},"2":{"destruct":false},"3":{"destruct":true}})",
+    R"({"0":{"wp":[0001,-0,00,2]}})",
+    R"({"2147483647":{"destruct":true}})",
+    R"({"msg":"a\'b\"c\\d\/eä𝄞\n\t"})",
+    R"({"msg":"\ud834Aäx\udd1e"})",
+    R"({"msg":"\udd1e\ud834"})",
+    "{\"msg\":\"raw\x01\xff\"}",
+    R"({"msg":"escaped key"})",
+    R"({"msg":"trailing"} garbage ] } "\)",
+    R"({"address":")" + addr + R"(","addressLock":")" + addr + R"("})",
+  };
+  for (const auto& json : accepted)
+    BOOST_CHECK_MESSAGE (ParseBothWays (json), "not accepted: " + json);
+
+  const std::vector<std::string> rejected = {
+    "",
+    "[]",
+    R"("msg")",
+    R"({"color":4})",
+    R"({"color":1,"0":{}})",
+    R"({"0":{},"color":1})",
+    R"({"color":1.0})",
+    R"({"color":1e0})",
+    R"({"color":"1"})",
+    R"({"color":2147483648})",
+    R"({"msg":"a","msg":"b"})",
+    R"({"msg":1})",
+    R"({"msg":null})",
+    R"({"foo":1})",
+    R"({"00":{}})",
+    R"({"-1":{}})",
+    R"({"+1":{}})",
+    R"({"2147483648":{}})",
+    R"({"0":{},"0":{}})",
+    R"({"0":[]})",
+    R"({"0":{"wp":[1]}})",
+    R"({"0":{"wp":[1,2,1,2]}})",
+    R"({"0":{"wp":[-1,2]}})",
+    R"({"0":{"wp":[1,2],"wp":[3,4]}})",
+    R"({"0":{"destruct":1}})",
+    R"({"0":{"foo":true}})",
+    R"({"0":{"wp":[1,2,]}})",
+    R"({"msg":"a",})",
+    R"({"msg":"\x"})",
+    R"({"msg":"\u12"})",
+    R"({"msg":"unterminated)",
+    R"({"0":{"wp":[1,2]})",
+    R"({"address":")" + p2sh + R"("})",
+    R"({"address":"invalid"})",
+  };
+  for (const auto& json : rejected)
+    BOOST_CHECK_MESSAGE (!ParseBothWays (json), "not rejected: " + json);
+
+  std::string longPath = R"({"0":{"wp":[)";
+  for (int i = 0; i < 101; ++i)
+    longPath += strprintf ("%s%d,%d", i > 0 ? "," : "", i, i);
+  BOOST_CHECK (!ParseBothWays (longPath + "]}}"));
+
+  /* Differential fuzzing:  Mutate the valid and invalid examples randomly
+     and check that both parsers still agree.  */
+  std::vector<std::string> corpus = accepted;
+  corpus.insert (corpus.end (), rejected.begin (), rejected.end ());
+  const std::string alphabet = "{}[]:,\"\\ -0123456789eE.tfnrusl\'/x\xff\x01";
+
+  FastRandomContext rng(true);
+  for (unsigned i = 0; i < 20000; ++i)
+    {
+      std::string json = corpus[rng.randrange (corpus.size ())];
+      const unsigned mutations = 1 + rng.randrange (4);
+      for (unsigned j = 0; j < mutations; ++j)
+        {
+          const size_t pos = rng.randrange (json.size () + 1);
+          const char c = alphabet[rng.randrange (alphabet.size ())];
+          switch (rng.randrange (4))
+            {
+            case 0:
+              json.insert (pos, 1, c);
+              break;
+            case 1:
+              if (pos < json.size ())
+                json.erase (pos, 1);
+              break;
+            case 2:
+              if (pos < json.size ())
+                json[pos] = c;
+              break;
+            case 3:
+              json.insert (pos, json.substr (rng.randrange (json.size () + 1),
+                                             rng.randrange (8)));
+              break;
+            }
+        }
+      ParseBothWays (json);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (parsed_moves)
+{
+  GameState state(Params ().GetConsensus ());
+  state.players.insert (std::make_pair ("domob",
+                        CowPtr<PlayerState> (MakePlayer (0, Coord (1, 2)))));
+  const CAmount locked = state.players["domob"]->lockedCoins;
+  const CAmount spawnLocked = GetNameCoinAmount (*state.param, 0);
+
+  CMutableTransaction mtx;
+  mtx.SetNamecoin ();
+  mtx.vout.push_back (CTxOut (COIN, CScript ()));
+  mtx.vout.push_back (MoveOutput ("domob", "{\"0\":{\"wp\":[2,2]}}",
+                                  locked, false));
+  mtx.vout.push_back (MoveOutput ("newbie", "{\"color\":1}",
+                                  spawnLocked, true));
+  const CTransaction tx(mtx);
+
+  std::vector<ParsedMove> moves;
+  StepData::ParseMoves (tx, moves);
+  BOOST_CHECK_EQUAL (moves.size (), 2);
+  BOOST_CHECK (moves[0].parsed && !moves[0].firstUpdate);
+  BOOST_CHECK_EQUAL (moves[0].move.player, "domob");
+  BOOST_CHECK (moves[1].parsed && moves[1].firstUpdate);
+  BOOST_CHECK (moves[1].move.IsSpawn ());
+
+  /* Adding the parsed moves must be equivalent to parsing on the fly.  */
+  CValidationState valid;
+  StepData direct(state);
+  BOOST_CHECK (direct.addTransaction (tx, nullptr, valid));
+  StepData parsed(state);
+  BOOST_CHECK (parsed.addParsedTransaction (tx, moves, nullptr, valid));
+  BOOST_CHECK_EQUAL (direct.vMoves.size (), 2);
+  BOOST_CHECK_EQUAL (parsed.vMoves.size (), 2);
+
+  /* A second move of the same player in the block is rejected.  */
+  BOOST_CHECK (!parsed.addParsedTransaction (tx, moves, nullptr, valid));
+
+  /* So are unparsable moves, even though ParseMoves itself succeeds.  */
+  CMutableTransaction mtxInvalid;
+  mtxInvalid.SetNamecoin ();
+  mtxInvalid.vout.push_back (MoveOutput ("other", "invalid", locked, false));
+  const CTransaction txInvalid(mtxInvalid);
+  StepData::ParseMoves (txInvalid, moves);
+  BOOST_CHECK_EQUAL (moves.size (), 1);
+  BOOST_CHECK (!moves[0].parsed);
+  StepData invalid(state);
+  BOOST_CHECK (!invalid.addParsedTransaction (txInvalid, moves, nullptr,
+                                              valid));
+}
+
+BOOST_AUTO_TEST_CASE (available_tiles)
+{
+  std::vector<Coord> tiles;
+  for (int x = 0; x < 20; ++x)
+    for (int y = 0; y < 20; ++y)
+      if ((x + y) % 3 != 0)
+        tiles.push_back (Coord (x, y));
+  std::sort (tiles.begin (), tiles.end ());
+
+  /* Compare against the straight-forward implementation of erasing
+     the selected tiles from a vector, which defines the consensus order.  */
+  for (int round = 0; round < 20; ++round)
+    {
+      RandomGenerator rng(ArithToUint256 (arith_uint256 (round + 1)));
+
+      std::set<Coord> excluded;
+      const int numExcluded = rng.GetIntRnd (0, 30);
+      while (excluded.size () < static_cast<unsigned> (numExcluded))
+        excluded.insert (tiles[rng.GetIntRnd (tiles.size ())]);
+
+      std::vector<Coord> expected;
+      for (const auto& c : tiles)
+        if (excluded.count (c) == 0)
+          expected.push_back (c);
+
+      AvailableTiles options(tiles);
+      for (const auto& c : excluded)
+        options.Exclude (c);
+      BOOST_CHECK_EQUAL (options.size (), expected.size ());
+
+      while (!expected.empty ())
+        {
+          const int ind = rng.GetIntRnd (expected.size ());
+          BOOST_CHECK (options.Take (ind) == expected[ind]);
+          expected.erase (expected.begin () + ind);
+          BOOST_CHECK_EQUAL (options.size (), expected.size ());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (tile_index)
+{
+  /* Compare iteration order and lookups with a multimap.  */
+  std::multimap<Coord, int> expected;
+  TileIndex<int> index;
+
+  RandomGenerator rng(uint256S ("01"));
+  for (int i = 0; i < 1000; ++i)
+    {
+      const Coord c(rng.GetIntRnd (10), rng.GetIntRnd (MAP_HEIGHT));
+      expected.insert (std::make_pair (c, i));
+      index.Add (c, i);
+    }
+  index.Finalise ();
+
+  typedef std::vector<std::pair<Coord, int>> EntryVector;
+  BOOST_CHECK (EntryVector (expected.begin (), expected.end ())
+                == EntryVector (index.begin (), index.end ()));
+
+  for (int x = -1; x <= 10; ++x)
+    for (int y = -1; y <= MAP_HEIGHT; ++y)
+      {
+        const Coord c(x, y);
+        const auto e = expected.equal_range (c);
+        const auto a = index.EqualRange (c);
+        BOOST_CHECK (EntryVector (e.first, e.second)
+                      == EntryVector (a.first, a.second));
+      }
+}
+
+BOOST_AUTO_TEST_CASE (random_generator)
+{
+  /* Every modulus up to a bound, each with a fresh generator so that
+     all of them see the full state.  */
+  for (int mod = 1; mod <= 10000; ++mod)
+    {
+      const uint256 seed = ArithToUint256 (arith_uint256 (mod));
+      RandomGenerator rnd(seed);
+      LegacyRandomGenerator legacy(seed);
+      for (int i = 0; i < 4; ++i)
+        BOOST_CHECK_EQUAL (rnd.GetIntRnd (mod), legacy.GetIntRnd (mod));
+    }
+
+  /* Long sequences of mixed (including large) moduli, which exhaust
+     the state many times.  */
+  const int bigModuli[] = {1, 2, 3, 502, 65535, 65536, 65537,
+                           1 << 30, std::numeric_limits<int>::max ()};
+  for (int round = 0; round < 20; ++round)
+    {
+      const uint256 seed = SerializeHash (round, SER_GETHASH, 0);
+      RandomGenerator rnd(seed);
+      LegacyRandomGenerator legacy(seed);
+      RandomGenerator modRnd(seed);
+      for (int i = 0; i < 2000; ++i)
+        {
+          int mod;
+          if (i % 3 == 0)
+            mod = bigModuli[i % (sizeof (bigModuli) / sizeof (int))];
+          else
+            mod = 1 + modRnd.GetIntRnd (1000000);
+
+          BOOST_CHECK_EQUAL (rnd.GetIntRnd (mod), legacy.GetIntRnd (mod));
+        }
+    }
+}
+
+namespace
+{
+
+/**
+ * Compute walking distances from start to all tiles by a straight-forward
+ * breadth-first search, as reference for the pathfinding code.
+ */
+std::vector<int>
+ReferenceDistances (const Coord& start)
+{
+  std::vector<int> dist(MAP_WIDTH * MAP_HEIGHT, -1);
+  std::deque<Coord> todo;
+  dist[start.y * MAP_WIDTH + start.x] = 0;
+  todo.push_back (start);
+  while (!todo.empty ())
+    {
+      const Coord c = todo.front ();
+      todo.pop_front ();
+      for (int dx = -1; dx <= 1; ++dx)
+        for (int dy = -1; dy <= 1; ++dy)
+          {
+            const Coord n(c.x + dx, c.y + dy);
+            if (!IsInsideMap (n.x, n.y) || !IsWalkable (n.x, n.y))
+              continue;
+            int& d = dist[n.y * MAP_WIDTH + n.x];
+            if (d == -1)
+              {
+                d = dist[c.y * MAP_WIDTH + c.x] + 1;
+                todo.push_back (n);
+              }
+          }
+    }
+
+  return dist;
+}
+
+std::vector<Coord>
+WalkableCoords ()
+{
+  std::vector<Coord> res;
+  for (int y = 0; y < MAP_HEIGHT; ++y)
+    for (int x = 0; x < MAP_WIDTH; ++x)
+      if (IsWalkable (x, y))
+        res.push_back (Coord (x, y));
+
+  return res;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE (find_path)
+{
+  const std::vector<Coord> walkable = WalkableCoords ();
+
+  RandomGenerator rng(uint256S ("01"));
+  for (int round = 0; round < 5; ++round)
+    {
+      const Coord start = walkable[rng.GetIntRnd (walkable.size ())];
+
+      const std::vector<int> dist = ReferenceDistances (start);
+
+      for (int i = 0; i < 20; ++i)
+        {
+          const Coord goal = walkable[rng.GetIntRnd (walkable.size ())];
+          const int expected = dist[goal.y * MAP_WIDTH + goal.x];
+          const std::vector<Coord> path = FindPath (start, goal);
+
+          if (expected == -1)
+            {
+              BOOST_CHECK (path.empty ());
+              continue;
+            }
+          BOOST_REQUIRE (!path.empty ());
+          BOOST_CHECK (path.front () == start);
+
+          /* Walk along the waypoints.  This must reach the goal with
+             the minimal number of steps.  */
+          CharacterState ch;
+          ch.coord = ch.from = start;
+          for (auto it = path.rbegin (); it != path.rend (); ++it)
+            ch.waypoints.push_back (*it);
+          int steps = 0;
+          while (!ch.waypoints.empty ())
+            {
+              const Coord old = ch.coord;
+              ch.MoveTowardsWaypoint ();
+              if (ch.coord != old)
+                ++steps;
+            }
+          BOOST_CHECK (ch.coord == goal);
+          BOOST_CHECK_EQUAL (steps, expected);
+        }
+    }
+
+  BOOST_CHECK (FindPath (walkable.front (), walkable.front ()).size () == 1);
+
+  Coord obstacle(-1, -1);
+  for (int x = 0; x < MAP_WIDTH && obstacle.x == -1; ++x)
+    if (!IsWalkable (x, 0))
+      obstacle = Coord (x, 0);
+  BOOST_REQUIRE (obstacle.x != -1);
+  BOOST_CHECK (FindPath (walkable.front (), obstacle).empty ());
+  BOOST_CHECK (FindPath (obstacle, walkable.front ()).empty ());
+  BOOST_CHECK (FindPath (walkable.front (), Coord (-1, 5)).empty ());
+}
+
+BOOST_AUTO_TEST_CASE (path_queries)
+{
+  const std::vector<Coord> walkable = WalkableCoords ();
+  RandomGenerator rng(uint256S ("02"));
+
+  std::vector<PathQuery> queries;
+  for (int i = 0; i < 20; ++i)
+    {
+      PathQuery q;
+      q.from = walkable[rng.GetIntRnd (walkable.size ())];
+      if (i % 4 == 0)
+        {
+          for (int j = 0; j < 50; ++j)
+            q.targets.push_back (walkable[rng.GetIntRnd (walkable.size ())]);
+          q.targets.push_back (q.from);
+          q.targets.push_back (q.targets.front ());
+          q.targets.push_back (Coord (-1, 0));
+        }
+      else
+        q.to = walkable[rng.GetIntRnd (walkable.size ())];
+      queries.push_back (q);
+    }
+
+  const std::vector<PathResult> results = ProcessPathQueries (queries);
+  BOOST_REQUIRE_EQUAL (results.size (), queries.size ());
+
+  for (unsigned i = 0; i < queries.size (); ++i)
+    {
+      const PathQuery& q = queries[i];
+      if (q.targets.empty ())
+        {
+          BOOST_CHECK (results[i].distances.empty ());
+          BOOST_CHECK (results[i].path == FindPath (q.from, q.to));
+          continue;
+        }
+
+      const std::vector<int> dist = ReferenceDistances (q.from);
+      BOOST_REQUIRE_EQUAL (results[i].distances.size (), q.targets.size ());
+      for (unsigned j = 0; j < q.targets.size (); ++j)
+        {
+          const Coord& t = q.targets[j];
+          int expected = -1;
+          if (IsInsideMap (t.x, t.y))
+            expected = dist[t.y * MAP_WIDTH + t.x];
+          BOOST_CHECK_EQUAL (results[i].distances[j], expected);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE (concurrent_replay, TestChain100Setup)
+{
+  std::vector<uint256> hashes;
+  {
+    LOCK (cs_main);
+    hashes.push_back (chainActive[60]->GetBlockHash ());
+    hashes.push_back (chainActive.Tip ()->GetBlockHash ());
+  }
+
+  /* A fresh database has none of the states, so that both queries replay
+     all blocks from the genesis block.  They run at the same time as each
+     other (and without cs_main), and must still compute the same states
+     as the main database did when connecting the blocks.  */
+  CGameDB db(1 << 20, DEFAULT_GAME_STATE_CACHE << 20,
+             DEFAULT_GAME_SNAPSHOT_INTERVAL, DEFAULT_GAME_DELTA_DEPTH,
+             true, false);
+
+  std::vector<GameStateRef> replayed(hashes.size ());
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < hashes.size (); ++i)
+    threads.emplace_back ([&db, &hashes, &replayed, i] ()
+      {
+        replayed[i] = db.getSnapshot (hashes[i]);
+      });
+  for (auto& t : threads)
+    t.join ();
+
+  for (unsigned i = 0; i < hashes.size (); ++i)
+    {
+      const GameStateRef expected = pgameDb->getSnapshot (hashes[i]);
+      BOOST_REQUIRE (expected && replayed[i]);
+      BOOST_CHECK (Serialised (*replayed[i]) == Serialised (*expected));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE (miner_step_cache, TestChain100Setup)
+{
+  const CChainParams& chainparams = Params ();
+  const CScript scriptPubKey
+    = CScript () << ToByteVector (coinbaseKey.GetPubKey ()) << OP_CHECKSIG;
+
+  /* Mature a second coinbase, so that we can afford a spawn.  */
+  CreateAndProcessBlock ({}, scriptPubKey);
+
+  const auto createTemplate = [&] ()
+    {
+      return BlockAssembler (chainparams).CreateNewBlock (ALGO_SHA256D,
+                                                          scriptPubKey);
+    };
+
+  /* The coinbase of a template has to pay what a fresh game step on its
+     parent and moves computes, no matter whether the miner reused its
+     cached step result or not.  */
+  const auto freshCoinbaseValue = [&] (const CBlockTemplate& tmpl)
+    {
+      LOCK (cs_main);
+      const CBlock& block = tmpl.block;
+      const GameStateRef prev = pgameDb->getSnapshot (block.hashPrevBlock);
+      BOOST_REQUIRE (prev);
+
+      StepData step(*prev);
+      CValidationState state;
+      for (const auto& tx : block.vtx)
+        BOOST_REQUIRE (step.addTransaction (*tx, pcoinsTip.get (), state));
+      GameState next(chainparams.GetConsensus ());
+      StepResult res;
+      BOOST_REQUIRE (PerformStep (*prev, step, next, res));
+
+      const int height = mapBlockIndex[block.hashPrevBlock]->nHeight + 1;
+      return -tmpl.vTxFees[0] + res.nTaxAmount
+              + GetBlockSubsidy (height, chainparams.GetConsensus ());
+    };
+
+  std::unique_ptr<CBlockTemplate> tmpl = createTemplate ();
+  const CAmount emptyValue = tmpl->block.vtx[0]->GetValueOut ();
+  BOOST_CHECK_EQUAL (emptyValue, freshCoinbaseValue (*tmpl));
+  tmpl = createTemplate ();
+  BOOST_CHECK_EQUAL (tmpl->block.vtx[0]->GetValueOut (), emptyValue);
+
+  /* Add a spawn move to the mempool.  */
+  CMutableTransaction mtx;
+  mtx.SetNamecoin ();
+  CAmount inValue = 0;
+  for (unsigned i = 0; i < 2; ++i)
+    {
+      mtx.vin.push_back (CTxIn (COutPoint (m_coinbase_txns[i]->GetHash (), 0)));
+      inValue += m_coinbase_txns[i]->vout[0].nValue;
+    }
+  const CAmount locked
+    = GetNameCoinAmount (chainparams.GetConsensus (), chainActive.Height () + 1);
+  mtx.vout.push_back (MoveOutput ("miner", "{\"color\":1}", locked, true,
+                                  scriptPubKey));
+  mtx.vout.push_back (CTxOut (inValue - locked - CENT, scriptPubKey));
+  for (unsigned i = 0; i < mtx.vin.size (); ++i)
+    {
+      const uint256 hash = SignatureHash (scriptPubKey, mtx, i, SIGHASH_ALL,
+                                          0, SigVersion::BASE);
+      std::vector<unsigned char> sig;
+      BOOST_REQUIRE (coinbaseKey.Sign (hash, sig));
+      sig.push_back (static_cast<unsigned char> (SIGHASH_ALL));
+      mtx.vin[i].scriptSig = CScript () << sig;
+    }
+  {
+    LOCK (cs_main);
+    CValidationState state;
+    BOOST_REQUIRE_MESSAGE (AcceptToMemoryPool (mempool, state,
+                                               MakeTransactionRef (mtx),
+                                               nullptr, nullptr, true, 0),
+                           "spawn rejected: " << state.GetRejectReason ());
+  }
+
+  /* The move changes the step, so the cached result must not be used
+     for the next template.  After that, it is reused again.  */
+  tmpl = createTemplate ();
+  BOOST_REQUIRE_EQUAL (tmpl->block.vtx.size (), 2);
+  const CAmount moveValue = tmpl->block.vtx[0]->GetValueOut ();
+  BOOST_CHECK (moveValue != emptyValue);
+  BOOST_CHECK_EQUAL (moveValue, freshCoinbaseValue (*tmpl));
+  tmpl = createTemplate ();
+  BOOST_CHECK_EQUAL (tmpl->block.vtx[0]->GetValueOut (), moveValue);
+  BOOST_CHECK_EQUAL (moveValue, freshCoinbaseValue (*tmpl));
+
+  /* Confirm the spawn.  The next template builds on a different parent,
+     whose state has to be loaded instead of the cached one.  */
+  const CBlock block = CreateAndProcessBlock ({mtx}, scriptPubKey);
+  BOOST_REQUIRE (chainActive.Tip ()->GetBlockHash () == block.GetHash ());
+  tmpl = createTemplate ();
+  BOOST_CHECK (tmpl->block.hashPrevBlock == block.GetHash ());
+  BOOST_CHECK_EQUAL (tmpl->block.vtx.size (), 1);
+  BOOST_CHECK_EQUAL (tmpl->block.vtx[0]->GetValueOut (),
+                     freshCoinbaseValue (*tmpl));
+  BOOST_CHECK_EQUAL (pgameDb->getSnapshot (block.GetHash ())
+                       ->players.count ("miner"), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE (published_tip, TestChain100Setup)
+{
+  const CChainParams& chainparams = Params ();
+  CBlockIndex* tip;
+  {
+    LOCK (cs_main);
+    tip = chainActive.Tip ();
+  }
+
+  /* Snapshots of the same block are shared rather than copied, and the
+     published tip is one of them.  */
+  const GameStateRef snapshot = pgameDb->getSnapshot (tip->GetBlockHash ());
+  BOOST_REQUIRE (snapshot);
+  BOOST_CHECK (pgameDb->getSnapshot (tip->GetBlockHash ()) == snapshot);
+  BOOST_CHECK (pgameDb->getTip () == snapshot);
+
+  /* The published tip follows disconnecting and reconnecting blocks.  */
+  CValidationState state;
+  {
+    LOCK (cs_main);
+    BOOST_REQUIRE (InvalidateBlock (state, chainparams, tip));
+  }
+  BOOST_REQUIRE (pgameDb->getTip ());
+  BOOST_CHECK (pgameDb->getTip ()->hashBlock == tip->pprev->GetBlockHash ());
+  {
+    LOCK (cs_main);
+    BOOST_REQUIRE (ResetBlockFailureFlags (tip));
+  }
+  BOOST_REQUIRE (ActivateBestChain (state, chainparams));
+  BOOST_REQUIRE (pgameDb->getTip ());
+  BOOST_CHECK (pgameDb->getTip ()->hashBlock == tip->GetBlockHash ());
+
+  /* A database that does not have the tip's state in memory clears the
+     published tip instead of computing it.  */
+  CGameDB db(1 << 20, DEFAULT_GAME_STATE_CACHE << 20,
+             DEFAULT_GAME_SNAPSHOT_INTERVAL, DEFAULT_GAME_DELTA_DEPTH,
+             true, false);
+  db.publishTip (tip->GetBlockHash ());
+  BOOST_CHECK (!db.getTip ());
+
+  const GameStateRef replayed = db.getSnapshot (tip->GetBlockHash ());
+  BOOST_REQUIRE (replayed);
+  db.publishTip (tip->GetBlockHash ());
+  BOOST_CHECK (db.getTip () == replayed);
+  BOOST_CHECK (db.getSnapshot (tip->GetBlockHash ()) == replayed);
+
+  db.publishTip (uint256 ());
+  BOOST_CHECK (!db.getTip ());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
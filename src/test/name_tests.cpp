@@ -21,6 +21,7 @@
 
 #include <list>
 #include <memory>
+#include <set>
 
 #include <stdint.h>
 
@@ -178,6 +179,12 @@ public:
     return new Iterator ();
   }
 
+  CNameIterator*
+  IterateNamesSnapshot () const
+  {
+    return new Iterator ();
+  }
+
 };
 
 /**
@@ -324,6 +331,8 @@ NameIterationTester::verify (const CCoinsView& view) const
     BOOST_CHECK (!iter->next (name, nameData));
   }
 
+  std::unique_ptr<CNameIterator> snapshot(view.IterateNamesSnapshot ());
+
   while (true)
     {
       EntryList got = getNamesFromView (view, start);
@@ -333,6 +342,10 @@ NameIterationTester::verify (const CCoinsView& view) const
       got = getNamesFromIterator (*iter);
       BOOST_CHECK (got == remaining);
 
+      snapshot->seek (start);
+      got = getNamesFromIterator (*snapshot);
+      BOOST_CHECK (got == remaining);
+
       if (remaining.empty ())
         break;
 
@@ -450,6 +463,105 @@ BOOST_AUTO_TEST_CASE (name_iteration)
 
 /* ************************************************************************** */
 
+BOOST_AUTO_TEST_CASE (name_regex_prefix)
+{
+  const auto prefix = [] (const std::string& regexp)
+    {
+      return ValtypeToString (GetRegexLiteralPrefix (regexp));
+    };
+
+  BOOST_CHECK_EQUAL (prefix (""), "");
+  BOOST_CHECK_EQUAL (prefix ("abc"), "");
+  BOOST_CHECK_EQUAL (prefix ("^"), "");
+  BOOST_CHECK_EQUAL (prefix ("^p/"), "p/");
+  BOOST_CHECK_EQUAL (prefix ("^p/.*"), "p/");
+  BOOST_CHECK_EQUAL (prefix ("^p/[a-z]+$"), "p/");
+  BOOST_CHECK_EQUAL (prefix ("^ab?c"), "a");
+  BOOST_CHECK_EQUAL (prefix ("^ab*"), "a");
+  BOOST_CHECK_EQUAL (prefix ("^ab{2}"), "a");
+  BOOST_CHECK_EQUAL (prefix ("^a\\.b"), "a.b");
+  BOOST_CHECK_EQUAL (prefix ("^a\\.?b"), "a");
+  BOOST_CHECK_EQUAL (prefix ("^a\\db"), "a");
+  BOOST_CHECK_EQUAL (prefix ("^a(b)"), "a");
+  BOOST_CHECK_EQUAL (prefix ("^ab|cd"), "");
+  BOOST_CHECK_EQUAL (prefix ("^a[|]"), "");
+}
+
+BOOST_AUTO_TEST_CASE (name_height_index)
+{
+  fNameHeightIndex = true;
+
+  CCoinsViewCache view(pcoinsdbview.get ());
+  const CScript addr = getTestAddress ();
+  const CScript updateScript
+      = CNameScript::buildNameUpdate (addr, ValtypeFromString ("x"),
+                                      ValtypeFromString ("y"));
+  const CNameScript nameOp(updateScript);
+
+  const auto setName = [&] (const std::string& name, unsigned height)
+    {
+      CNameData data;
+      data.fromScript (height, COutPoint (uint256 (), 0), nameOp);
+      view.SetName (ValtypeFromString (name), data, false);
+    };
+  const auto flush = [&] ()
+    {
+      uint256 dummyBlockHash;
+      *reinterpret_cast<unsigned*> (dummyBlockHash.begin ()) = 1;
+      view.SetBestBlock (dummyBlockHash);
+      BOOST_CHECK (view.Flush ());
+    };
+  const auto recent = [] (const CCoinsView& v, unsigned minHeight)
+    {
+      std::set<std::string> res;
+      std::unique_ptr<CNameIterator> iter(v.IterateRecentNames (minHeight));
+      valtype name;
+      CNameData data;
+      while (iter->next (name, data))
+        {
+          BOOST_CHECK (data.getHeight () >= minHeight);
+          BOOST_CHECK (res.insert (ValtypeToString (name)).second);
+        }
+      return res;
+    };
+  typedef std::set<std::string> Names;
+
+  setName ("a", 10);
+  setName ("b", 20);
+  setName ("c", 30);
+  flush ();
+  BOOST_CHECK (recent (view, 0) == Names ({"a", "b", "c"}));
+  BOOST_CHECK (recent (view, 20) == Names ({"b", "c"}));
+  BOOST_CHECK (recent (view, 31).empty ());
+
+  /* Unflushed changes move names in and out of the range.  */
+  setName ("a", 40);
+  setName ("c", 15);
+  view.DeleteName (ValtypeFromString ("b"));
+  setName ("d", 25);
+  BOOST_CHECK (recent (view, 20) == Names ({"a", "d"}));
+  BOOST_CHECK (recent (*pcoinsdbview, 20) == Names ({"b", "c"}));
+
+  /* The iterator is a snapshot and does not see later changes.  */
+  std::unique_ptr<CNameIterator> iter(view.IterateRecentNames (20));
+  flush ();
+  setName ("e", 50);
+  flush ();
+  Names snapshot;
+  valtype name;
+  CNameData data;
+  while (iter->next (name, data))
+    snapshot.insert (ValtypeToString (name));
+  BOOST_CHECK (snapshot == Names ({"a", "d"}));
+
+  BOOST_CHECK (recent (*pcoinsdbview, 20) == Names ({"a", "d", "e"}));
+  BOOST_CHECK (recent (*pcoinsdbview, 0) == Names ({"a", "c", "d", "e"}));
+
+  fNameHeightIndex = false;
+}
+
+/* ************************************************************************** */
+
 /**
  * Construct a dummy tx that provides the given script as input
  * for further tests in the given CCoinsView.  The txid is returned
@@ -713,7 +825,7 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   CCoinsViewCache view(&dummyView);
   CBlockUndo undo;
   CNameData data;
-  CNameHistory history;
+  std::vector<CNameData> history;
 
   const valtype rand(20, 'x');
   valtype toHash(rand);
@@ -734,7 +846,7 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   ApplyNameTransaction (mtx, 100, view, undo);
   BOOST_CHECK (!view.GetName (name, data));
   BOOST_CHECK (undo.vnameundo.empty ());
-  BOOST_CHECK (!view.GetNameHistory (name, history));
+  BOOST_CHECK (view.GetNameHistorySize (name) == 0);
 
   mtx.vout.clear ();
   mtx.vout.push_back (CTxOut (COIN, scrFirst));
@@ -743,7 +855,7 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   BOOST_CHECK (data.getHeight () == 200);
   BOOST_CHECK (data.getValue () == value1);
   BOOST_CHECK (data.getAddress () == addr);
-  BOOST_CHECK (!view.GetNameHistory (name, history));
+  BOOST_CHECK (view.GetNameHistorySize (name) == 0);
   BOOST_CHECK (undo.vnameundo.size () == 1);
   const CNameData firstData = data;
 
@@ -754,28 +866,107 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   BOOST_CHECK (data.getHeight () == 300);
   BOOST_CHECK (data.getValue () == value2);
   BOOST_CHECK (data.getAddress () == addr);
-  BOOST_CHECK (view.GetNameHistory (name, history));
-  BOOST_CHECK (history.getData ().size () == 1);
-  BOOST_CHECK (history.getData ().back () == firstData);
+  BOOST_CHECK (view.GetNameHistorySize (name) == 1);
+  BOOST_CHECK (view.GetNameHistory (name, 0, 1, history));
+  BOOST_CHECK (history.size () == 1);
+  BOOST_CHECK (history.back () == firstData);
+  BOOST_CHECK (view.GetNameHistory (name, 1, 5, history));
+  BOOST_CHECK (history.empty ());
   BOOST_CHECK (undo.vnameundo.size () == 2);
 
-  undo.vnameundo.back ().apply (view);
+  /* Undo the update in a child cache, so that it has to pop the entry
+     from its base view's history.  */
+  {
+    CCoinsViewCache child(&view);
+    undo.vnameundo.back ().apply (child);
+    BOOST_CHECK (child.GetName (name, data));
+    BOOST_CHECK (data.getHeight () == 200);
+    BOOST_CHECK (data.getValue () == value1);
+    BOOST_CHECK (data.getAddress () == addr);
+    BOOST_CHECK (child.GetNameHistorySize (name) == 0);
+    BOOST_CHECK (view.GetNameHistorySize (name) == 1);
+    BOOST_CHECK (child.Flush ());
+  }
   BOOST_CHECK (view.GetName (name, data));
   BOOST_CHECK (data.getHeight () == 200);
-  BOOST_CHECK (data.getValue () == value1);
-  BOOST_CHECK (data.getAddress () == addr);
-  BOOST_CHECK (!view.GetNameHistory (name, history) || history.empty ());
+  BOOST_CHECK (view.GetNameHistorySize (name) == 0);
   undo.vnameundo.pop_back ();
 
   undo.vnameundo.back ().apply (view);
   BOOST_CHECK (!view.GetName (name, data));
-  BOOST_CHECK (!view.GetNameHistory (name, history) || history.empty ());
+  BOOST_CHECK (view.GetNameHistorySize (name) == 0);
   undo.vnameundo.pop_back ();
   BOOST_CHECK (undo.vnameundo.empty ());
 }
 
 /* ************************************************************************** */
 
+BOOST_AUTO_TEST_CASE (name_history_database)
+{
+  fNameHistory = true;
+
+  const valtype name = ValtypeFromString ("database-history-name");
+  const CScript addr = getTestAddress ();
+  const CScript updateScript
+      = CNameScript::buildNameUpdate (addr, name, ValtypeFromString ("x"));
+  const CNameScript nameOp(updateScript);
+
+  std::vector<CNameData> datas(5);
+  for (unsigned i = 0; i < datas.size (); ++i)
+    datas[i].fromScript (100 + i, COutPoint (uint256 (), i), nameOp);
+
+  CCoinsViewCache& view = *pcoinsTip;
+  std::vector<CNameData> history;
+
+  /* Build up the history in two flushes, so that the second batch is
+     appended to the entries already in the database.  */
+  view.SetName (name, datas[0], false);
+  view.SetName (name, datas[1], false);
+  view.SetName (name, datas[2], false);
+  BOOST_CHECK (view.Flush ());
+  BOOST_CHECK (view.GetNameHistorySize (name) == 2);
+  view.SetName (name, datas[3], false);
+  view.SetName (name, datas[4], false);
+  BOOST_CHECK (view.Flush ());
+
+  BOOST_CHECK (view.GetNameHistorySize (name) == 4);
+  BOOST_CHECK (view.GetNameHistory (name, 0, 10, history));
+  BOOST_CHECK (history == std::vector<CNameData> (datas.begin (),
+                                                  datas.begin () + 4));
+  BOOST_CHECK (view.GetNameHistory (name, 1, 2, history));
+  BOOST_CHECK (history == std::vector<CNameData> (datas.begin () + 1,
+                                                  datas.begin () + 3));
+
+  /* Undo partially in a cache on top of the database.  */
+  view.SetName (name, datas[3], true);
+  view.SetName (name, datas[2], true);
+  BOOST_CHECK (view.GetNameHistorySize (name) == 2);
+  BOOST_CHECK (view.GetNameHistory (name, 0, 10, history));
+  BOOST_CHECK (history == std::vector<CNameData> (datas.begin (),
+                                                  datas.begin () + 2));
+  view.SetName (name, datas[4], false);
+  BOOST_CHECK (view.Flush ());
+
+  BOOST_CHECK (view.GetNameHistorySize (name) == 3);
+  BOOST_CHECK (view.GetNameHistory (name, 0, 10, history));
+  BOOST_CHECK (history.size () == 3);
+  BOOST_CHECK (history[0] == datas[0] && history[1] == datas[1]
+                && history[2] == datas[2]);
+
+  /* Undo everything.  */
+  view.SetName (name, datas[2], true);
+  view.SetName (name, datas[1], true);
+  view.SetName (name, datas[0], true);
+  BOOST_CHECK (view.Flush ());
+  BOOST_CHECK (view.GetNameHistorySize (name) == 0);
+  BOOST_CHECK (view.GetNameHistory (name, 0, 10, history));
+  BOOST_CHECK (history.empty ());
+  view.DeleteName (name);
+  BOOST_CHECK (view.Flush ());
+}
+
+/* ************************************************************************** */
+
 BOOST_AUTO_TEST_CASE (name_mempool)
 {
   LOCK(mempool.cs);
@@ -894,9 +1085,13 @@ BOOST_AUTO_TEST_CASE (name_mempool)
   BOOST_CHECK (mempool.updatesName (nameUpd));
   BOOST_CHECK (!mempool.checkNameOps (txUpd2));
 
-  /* Check getTxForName.  */
+  /* Check getTxForName and getPendingNameTx.  */
   BOOST_CHECK (mempool.getTxForName (nameReg) == txReg1.GetHash ());
   BOOST_CHECK (mempool.getTxForName (nameUpd) == txUpd1.GetHash ());
+  BOOST_CHECK (mempool.getPendingNameTx (nameReg)->GetHash ()
+                == txReg1.GetHash ());
+  BOOST_CHECK (mempool.getPendingNameTx (nameUpd)->GetHash ()
+                == txUpd1.GetHash ());
 
   /* Run mempool sanity check.  */
   CCoinsViewCache view(pcoinsTip.get());
@@ -926,6 +1121,8 @@ BOOST_AUTO_TEST_CASE (name_mempool)
   /* Check getTxForName with non-existent names.  */
   BOOST_CHECK (mempool.getTxForName (nameReg).IsNull ());
   BOOST_CHECK (mempool.getTxForName (nameUpd).IsNull ());
+  BOOST_CHECK (mempool.getPendingNameTx (nameReg) == nullptr);
+  BOOST_CHECK (mempool.getPendingNameTx (nameUpd) == nullptr);
 
   /* Check removing of conflicted name registrations.  */
 
@@ -962,6 +1159,52 @@ BOOST_AUTO_TEST_CASE (name_mempool)
   BOOST_CHECK (mempool.mapTx.empty ());
 }
 
+BOOST_AUTO_TEST_CASE (name_mempool_expiry)
+{
+  LOCK(mempool.cs);
+  mempool.clear ();
+
+  const CScript addr = getTestAddress ();
+  const CScript addr2 = (CScript (addr) << OP_RETURN);
+
+  const auto makeNameNew = [] (const CScript& a, const uint160& hash)
+    {
+      CMutableTransaction mtx;
+      mtx.SetNamecoin ();
+      mtx.vout.push_back (CTxOut (COIN, CNameScript::buildNameNew (a, hash)));
+      return CTransaction (mtx);
+    };
+
+  const uint160 hash1 = Hash160 (valtype (20, 'a'));
+  const uint160 hash2 = Hash160 (valtype (20, 'b'));
+  const CTransaction txNew1 = makeNameNew (addr, hash1);
+  const CTransaction txNew1p = makeNameNew (addr2, hash1);
+  const CTransaction txNew2 = makeNameNew (addr, hash2);
+  const CTransaction txNew2p = makeNameNew (addr2, hash2);
+
+  const LockPoints lp;
+  const CTxMemPoolEntry entryNew1(MakeTransactionRef (txNew1), 0, 1000, 100,
+                                  false, 1, lp);
+  const CTxMemPoolEntry entryNew2(MakeTransactionRef (txNew2), 0, 2000, 100,
+                                  false, 1, lp);
+  mempool.addUnchecked (txNew1.GetHash (), entryNew1);
+  mempool.addUnchecked (txNew2.GetHash (), entryNew2);
+
+  /* The hashes are remembered after the tx left the mempool.  */
+  mempool.removeRecursive (txNew2);
+  BOOST_CHECK (!mempool.checkNameOps (txNew1p));
+  BOOST_CHECK (!mempool.checkNameOps (txNew2p));
+
+  /* Expiring the first tx also forgets its name_new hash.  */
+  BOOST_CHECK (mempool.Expire (1500) == 1);
+  BOOST_CHECK (mempool.checkNameOps (txNew1p));
+  BOOST_CHECK (!mempool.checkNameOps (txNew2p));
+
+  /* Expiry of hashes is also done if there are no tx to expire.  */
+  BOOST_CHECK (mempool.Expire (2500) == 0);
+  BOOST_CHECK (mempool.checkNameOps (txNew2p));
+}
+
 /* ************************************************************************** */
 
 BOOST_AUTO_TEST_SUITE_END ()
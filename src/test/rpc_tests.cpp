@@ -336,4 +336,27 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_raw_json_result)
+{
+    // Calls from within the process get the game state as proper UniValue.
+    const UniValue state = CallRPC("game_getstate");
+    BOOST_CHECK(state.isObject());
+
+    // If a reply buffer is offered, the result is written into it instead.
+    JSONRPCRequest request;
+    request.strMethod = "game_getstate";
+    request.params = UniValue(UniValue::VARR);
+    request.id = 42;
+    std::string reply = JSONRPCRawReplyBegin();
+    request.rawResult = &reply;
+    BOOST_CHECK((*tableRPC["game_getstate"]->actor)(request).isNull());
+    JSONRPCRawReplyEnd(reply, request.id);
+
+    UniValue parsed;
+    BOOST_REQUIRE(parsed.read(reply));
+    BOOST_CHECK_EQUAL(find_value(parsed, "result").write(), state.write());
+    BOOST_CHECK(find_value(parsed, "error").isNull());
+    BOOST_CHECK_EQUAL(find_value(parsed, "id").get_int(), 42);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
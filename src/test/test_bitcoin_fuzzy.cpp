@@ -6,7 +6,9 @@
 #include <config/bitcoin-config.h>
 #endif
 
+#include <chainparams.h>
 #include <consensus/merkle.h>
+#include <game/move.h>
 #include <primitives/block.h>
 #include <script/script.h>
 #include <addrman.h>
@@ -49,6 +51,7 @@ enum TEST_ID {
     CTXOUTCOMPRESSOR_DESERIALIZE,
     BLOCKTRANSACTIONS_DESERIALIZE,
     BLOCKTRANSACTIONSREQUEST_DESERIALIZE,
+    MOVE_PARSE,
     TEST_ID_END
 };
 
@@ -269,6 +272,17 @@ int test_one_input(std::vector<uint8_t> buffer) {
 
             break;
         }
+        case MOVE_PARSE:
+        {
+            // The move parser must agree with the UniValue-based reference.
+            const std::string json(ds.begin(), ds.end());
+            Move fast, reference;
+            const bool okFast = fast.Parse("domob", json);
+            const bool okReference = reference.ParseWithUniValue("domob", json);
+            assert(okFast == okReference);
+            assert(!okFast || fast == reference);
+            break;
+        }
         default:
             return 0;
     }
@@ -278,6 +292,8 @@ int test_one_input(std::vector<uint8_t> buffer) {
 static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 void initialize() {
     globalVerifyHandle = std::unique_ptr<ECCVerifyHandle>(new ECCVerifyHandle());
+    // Needed for decoding addresses in moves.
+    SelectParams(CBaseChainParams::MAIN);
 }
 
 // This function is used by libFuzzer
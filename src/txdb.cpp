@@ -27,9 +27,14 @@ static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_AUXPOW = 'a';
 
 static const char DB_NAME = 'n';
+// Legacy format of the name history (all entries in a single record)
 static const char DB_NAME_HISTORY = 'h';
+static const char DB_NAME_HISTORY_SIZE = 's';
+static const char DB_NAME_HISTORY_ENTRY = 'e';
+static const char DB_NAME_HEIGHT = 'u';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
@@ -59,6 +64,84 @@ struct CoinEntry {
     }
 };
 
+/**
+ * Key of a single entry in a name's history.  The index is stored in
+ * big-endian byte order, so that the entries of each name are sorted by
+ * their index in the database.
+ */
+struct NameHistoryEntryKey {
+    char key;
+    valtype name;
+    uint32_t index;
+
+    NameHistoryEntryKey() : key(DB_NAME_HISTORY_ENTRY), name(), index(0) {}
+    NameHistoryEntryKey(const valtype& n, uint32_t i) : key(DB_NAME_HISTORY_ENTRY), name(n), index(i) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        s << name;
+        const uint32_t indexBE = htobe32(index);
+        s.write(reinterpret_cast<const char*>(&indexBE), sizeof(indexBE));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        s >> name;
+        uint32_t indexBE;
+        s.read(reinterpret_cast<char*>(&indexBE), sizeof(indexBE));
+        index = be32toh(indexBE);
+    }
+};
+
+/**
+ * Key of a name in the index by update height.  The height is stored in
+ * big-endian byte order, so that iteration is in order of the heights.
+ */
+struct NameHeightKey {
+    char key;
+    uint32_t height;
+    valtype name;
+
+    NameHeightKey() : key(DB_NAME_HEIGHT), height(0), name() {}
+    NameHeightKey(uint32_t h, const valtype& n) : key(DB_NAME_HEIGHT), height(h), name(n) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        const uint32_t heightBE = htobe32(height);
+        s.write(reinterpret_cast<const char*>(&heightBE), sizeof(heightBE));
+        s << name;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        uint32_t heightBE;
+        s.read(reinterpret_cast<char*>(&heightBE), sizeof(heightBE));
+        height = be32toh(heightBE);
+        s >> name;
+    }
+};
+
+/** Write the changes to a name's history into a database batch.  */
+void WriteNameHistory(CDBBatch& batch, const valtype& name, const CNameHistory& history)
+{
+    for (unsigned i = history.getKeptBase(); i < history.getBaseSize(); ++i)
+        batch.Erase(NameHistoryEntryKey(name, i));
+
+    const std::vector<CNameData>& pushed = history.getPushed();
+    for (unsigned i = 0; i < pushed.size(); ++i)
+        batch.Write(NameHistoryEntryKey(name, history.getKeptBase() + i), pushed[i]);
+
+    const auto sizeKey = std::make_pair(DB_NAME_HISTORY_SIZE, name);
+    if (history.empty())
+        batch.Erase(sizeKey);
+    else
+        batch.Write(sizeKey, static_cast<uint32_t>(history.size()));
+}
+
 }
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
@@ -92,9 +175,33 @@ bool CCoinsViewDB::GetName(const valtype &name, CNameData& data) const {
     return db.Read(std::make_pair(DB_NAME, name), data);
 }
 
-bool CCoinsViewDB::GetNameHistory(const valtype &name, CNameHistory& data) const {
+unsigned CCoinsViewDB::GetNameHistorySize(const valtype &name) const {
     assert (fNameHistory);
-    return db.Read(std::make_pair(DB_NAME_HISTORY, name), data);
+    uint32_t size;
+    if (!db.Read(std::make_pair(DB_NAME_HISTORY_SIZE, name), size))
+        return 0;
+    return size;
+}
+
+bool CCoinsViewDB::GetNameHistory(const valtype &name, unsigned start, unsigned count, std::vector<CNameData> &entries) const {
+    assert (fNameHistory);
+
+    entries.clear();
+    std::unique_ptr<CDBIterator> pcursor(const_cast<CDBWrapper&>(db).NewIterator());
+    for (pcursor->Seek(NameHistoryEntryKey(name, start)); pcursor->Valid() && entries.size() < count; pcursor->Next()) {
+        NameHistoryEntryKey key;
+        if (!pcursor->GetKey(key) || key.key != DB_NAME_HISTORY_ENTRY || key.name != name)
+            break;
+        if (key.index != start + entries.size())
+            return error("%s: name history entry %u missing", __func__, start + entries.size());
+
+        CNameData data;
+        if (!pcursor->GetValue(data))
+            return error("%s: failed to read name history entry", __func__);
+        entries.push_back(data);
+    }
+
+    return true;
 }
 
 class CDbNameIterator : public CNameIterator
@@ -155,6 +262,79 @@ CNameIterator* CCoinsViewDB::IterateNames() const {
     return new CDbNameIterator(db);
 }
 
+CNameIterator* CCoinsViewDB::IterateNamesSnapshot() const {
+    /* LevelDB iterators already read from an implicit snapshot.  */
+    return new CDbNameIterator(db);
+}
+
+/** Iterator over the names in the height index of the database.  */
+class CDbRecentNameIterator : public CNameIterator
+{
+
+private:
+
+    /* Iterator over the height index.  */
+    std::unique_ptr<CDBIterator> indexIter;
+    /* Iterator used to look up the names' data.  */
+    std::unique_ptr<CDBIterator> dataIter;
+
+    /* Minimum height of the names to return.  */
+    const unsigned minHeight;
+
+public:
+
+    /**
+     * Construct the iterator.  Both LevelDB iterators are created here,
+     * so that they see the same state of the database as long as it is
+     * not written to concurrently (which is ensured by cs_main).
+     */
+    CDbRecentNameIterator(const CDBWrapper& db, unsigned h);
+
+    /* Implement iterator methods.  */
+    void seek (const valtype& start);
+    bool next (valtype& name, CNameData& data);
+
+};
+
+CDbRecentNameIterator::CDbRecentNameIterator(const CDBWrapper& db, unsigned h)
+    : indexIter(const_cast<CDBWrapper*>(&db)->NewIterator()),
+      dataIter(const_cast<CDBWrapper*>(&db)->NewIterator()),
+      minHeight(h)
+{
+    seek(valtype());
+}
+
+void CDbRecentNameIterator::seek(const valtype& start) {
+    assert(start.empty());
+    indexIter->Seek(NameHeightKey(minHeight, valtype()));
+}
+
+bool CDbRecentNameIterator::next(valtype& name, CNameData& data) {
+    if (!indexIter->Valid())
+        return false;
+
+    NameHeightKey key;
+    if (!indexIter->GetKey(key) || key.key != DB_NAME_HEIGHT)
+        return false;
+    name = key.name;
+
+    const auto dataKey = std::make_pair(DB_NAME, name);
+    dataIter->Seek(dataKey);
+    std::pair<char, valtype> foundKey;
+    if (!dataIter->Valid() || !dataIter->GetKey(foundKey) || foundKey != dataKey)
+        return error("%s : indexed name %s is missing", __func__, ValtypeToString(name).c_str());
+    if (!dataIter->GetValue(data) || data.getHeight() != key.height)
+        return error("%s : invalid data for indexed name %s", __func__, ValtypeToString(name).c_str());
+
+    indexIter->Next();
+    return true;
+}
+
+CNameIterator* CCoinsViewDB::IterateRecentNames(unsigned minHeight) const {
+    assert(fNameHeightIndex);
+    return new CDbRecentNameIterator(db, minHeight);
+}
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) {
     CDBBatch batch(db);
     size_t count = 0;
@@ -206,7 +386,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, con
         }
     }
 
-    names.writeBatch(batch);
+    names.writeBatch(batch, *this);
 
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
@@ -300,7 +480,8 @@ void CCoinsViewDBCursor::Next()
     }
 }
 
-bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
+bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo,
+                                  const std::vector<std::pair<uint256, const CAuxPow*> >& auxpows, const std::vector<uint256>& auxpowsErased) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<int, const CBlockFileInfo*> >::const_iterator it=fileInfo.begin(); it != fileInfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_FILES, it->first), *it->second);
@@ -309,6 +490,12 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
+    for (const auto& entry : auxpows) {
+        batch.Write(std::make_pair(DB_AUXPOW, entry.first), *entry.second);
+    }
+    for (const uint256& hash : auxpowsErased) {
+        batch.Erase(std::make_pair(DB_AUXPOW, hash));
+    }
     return WriteBatch(batch, true);
 }
 
@@ -334,6 +521,10 @@ bool CCoinsViewDB::ValidateNameDB(CGameDB& gameDb) const
     std::set<valtype> namesTotal;
     std::set<valtype> namesInDB;
     std::set<valtype> namesWithHistory;
+    std::map<valtype, uint32_t> historySizes;
+    std::map<valtype, uint32_t> historyEntries;
+    std::map<valtype, unsigned> nameHeights;
+    std::map<valtype, unsigned> indexedHeights;
     std::map<valtype, CAmount> namesInUTXO;
 
     for (; pcursor->Valid(); pcursor->Next())
@@ -386,21 +577,57 @@ bool CCoinsViewDB::ValidateNameDB(CGameDB& gameDb) const
             assert(namesInDB.count(name) == 0);
             if (!data.isDead ())
                 namesInDB.insert(name);
+            nameHeights[name] = data.getHeight();
+            break;
+        }
+
+        case DB_NAME_HEIGHT:
+        {
+            NameHeightKey key;
+            if (!pcursor->GetKey(key) || key.key != DB_NAME_HEIGHT)
+                return error("%s : failed to read DB_NAME_HEIGHT key",
+                             __func__);
+            if (indexedHeights.count(key.name) > 0)
+                return error("%s : name %s is duplicated in the height index",
+                             __func__, ValtypeToString(key.name).c_str());
+            indexedHeights[key.name] = key.height;
             break;
         }
 
         case DB_NAME_HISTORY:
+            return error("%s : name history in legacy format", __func__);
+
+        case DB_NAME_HISTORY_SIZE:
         {
             std::pair<char, valtype> key;
-            if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY)
-                return error("%s : failed to read DB_NAME_HISTORY key",
+            if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY_SIZE)
+                return error("%s : failed to read DB_NAME_HISTORY_SIZE key",
                              __func__);
             const valtype& name = key.second;
 
-            if (namesWithHistory.count(name) > 0)
-                return error("%s : name %s has duplicate history",
+            uint32_t size;
+            if (!pcursor->GetValue(size) || size == 0)
+                return error("%s : invalid history size for name %s",
                              __func__, ValtypeToString(name).c_str());
+
             namesWithHistory.insert(name);
+            historySizes[name] = size;
+            break;
+        }
+
+        case DB_NAME_HISTORY_ENTRY:
+        {
+            NameHistoryEntryKey key;
+            if (!pcursor->GetKey(key) || key.key != DB_NAME_HISTORY_ENTRY)
+                return error("%s : failed to read DB_NAME_HISTORY_ENTRY key",
+                             __func__);
+
+            /* Entries are sorted by index, so they must be consecutive.  */
+            uint32_t& count = historyEntries[key.name];
+            if (key.index != count)
+                return error("%s : name %s has a gap in its history",
+                             __func__, ValtypeToString(key.name).c_str());
+            ++count;
             break;
         }
 
@@ -420,7 +647,7 @@ bool CCoinsViewDB::ValidateNameDB(CGameDB& gameDb) const
         if (namesInGame.count(cur) > 0)
             return error("%s : name %s is duplicate in the game state",
                          __func__, mi->first.c_str());
-        namesInGame.insert(std::make_pair(cur, mi->second.lockedCoins));
+        namesInGame.insert(std::make_pair(cur, mi->second->lockedCoins));
     }
 
     /* Now verify the collected data.  */
@@ -445,10 +672,22 @@ bool CCoinsViewDB::ValidateNameDB(CGameDB& gameDb) const
             if (namesTotal.count(name) == 0)
                 return error("%s : history entry for name '%s' not in main DB",
                              __func__, ValtypeToString(name).c_str());
-    } else if (!namesWithHistory.empty ())
+        if (historySizes != historyEntries)
+            return error("%s : name history sizes do not match the entries",
+                         __func__);
+    } else if (!namesWithHistory.empty () || !historyEntries.empty ())
         return error("%s : name_history entries in DB, but"
                      " -namehistory not set", __func__);
 
+    if (fNameHeightIndex)
+    {
+        if (indexedHeights != nameHeights)
+            return error("%s : name height index does not match the names",
+                         __func__);
+    } else if (!indexedHeights.empty ())
+        return error("%s : name height index in DB, but"
+                     " -nameheightindex not set", __func__);
+
     LogPrintf("Checked name database, %u living player names, %u total.\n",
               namesInDB.size(), namesTotal.size());
     LogPrintf("Names with history: %u\n", namesWithHistory.size());
@@ -457,7 +696,7 @@ bool CCoinsViewDB::ValidateNameDB(CGameDB& gameDb) const
 }
 
 void
-CNameCache::writeBatch (CDBBatch& batch) const
+CNameCache::writeBatch (CDBBatch& batch, const CCoinsView& view) const
 {
   for (EntryMap::const_iterator i = entries.begin ();
        i != entries.end (); ++i)
@@ -467,13 +706,30 @@ CNameCache::writeBatch (CDBBatch& batch) const
        i != deleted.end (); ++i)
     batch.Erase (std::make_pair (DB_NAME, *i));
 
+  if (fNameHeightIndex)
+    {
+      /* Move changed names in the height index.  Erasing the old key
+         before writing the new one works also if the height is
+         unchanged, since the batch is applied in order.  */
+      CNameData oldData;
+      for (EntryMap::const_iterator i = entries.begin ();
+           i != entries.end (); ++i)
+        {
+          if (view.GetName (i->first, oldData))
+            batch.Erase (NameHeightKey (oldData.getHeight (), i->first));
+          batch.Write (NameHeightKey (i->second.getHeight (), i->first), '1');
+        }
+
+      for (std::set<valtype>::const_iterator i = deleted.begin ();
+           i != deleted.end (); ++i)
+        if (view.GetName (*i, oldData))
+          batch.Erase (NameHeightKey (oldData.getHeight (), *i));
+    }
+
   assert (fNameHistory || history.empty ());
   for (std::map<valtype, CNameHistory>::const_iterator i = history.begin ();
        i != history.end (); ++i)
-    if (i->second.empty ())
-      batch.Erase (std::make_pair (DB_NAME_HISTORY, i->first));
-    else
-      batch.Write (std::make_pair (DB_NAME_HISTORY, i->first), i->second);
+    WriteNameHistory (batch, i->first, i->second);
 }
 
 bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
@@ -487,6 +743,18 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadAuxpow(const uint256 &hash, CAuxPow &auxpow) {
+    return Read(std::make_pair(DB_AUXPOW, hash), auxpow);
+}
+
+bool CBlockTreeDB::WriteAuxpows(const std::vector<std::pair<uint256, const CAuxPow*> >& auxpows) {
+    CDBBatch batch(*this);
+    for (const auto& entry : auxpows) {
+        batch.Write(std::make_pair(DB_AUXPOW, entry.first), *entry.second);
+    }
+    return WriteBatch(batch);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -610,7 +878,7 @@ bool CCoinsViewDB::Upgrade() {
     std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
     pcursor->Seek(std::make_pair(DB_COINS, uint256()));
     if (!pcursor->Valid()) {
-        return true;
+        return UpgradeNameHistory();
     }
 
     int64_t count = 0;
@@ -669,5 +937,49 @@ bool CCoinsViewDB::Upgrade() {
     db.CompactRange({DB_COINS, uint256()}, key);
     uiInterface.ShowProgress("", 100, false);
     LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    return !ShutdownRequested() && UpgradeNameHistory();
+}
+
+bool CCoinsViewDB::UpgradeNameHistory() {
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(std::make_pair(DB_NAME_HISTORY, valtype()));
+    std::pair<char, valtype> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_NAME_HISTORY) {
+        return true;
+    }
+
+    LogPrintf("Upgrading name history database...\n");
+    size_t batch_size = 1 << 24;
+    CDBBatch batch(db);
+    unsigned names = 0;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            break;
+        }
+        if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY) {
+            break;
+        }
+
+        /* The legacy format stores the full stack as a vector.  */
+        std::vector<CNameData> entries;
+        if (!pcursor->GetValue(entries)) {
+            return error("%s: cannot parse name history record", __func__);
+        }
+        CNameHistory history;
+        for (const auto& entry : entries) {
+            history.push(entry);
+        }
+        WriteNameHistory(batch, key.second, history);
+        batch.Erase(key);
+        ++names;
+
+        if (batch.SizeEstimate() > batch_size) {
+            db.WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+    db.WriteBatch(batch);
+    LogPrintf("Upgraded the history of %u names [%s].\n", names, ShutdownRequested() ? "CANCELLED" : "DONE");
     return !ShutdownRequested();
 }
@@ -94,8 +94,11 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool GetName(const valtype &name, CNameData &data) const override;
-    bool GetNameHistory(const valtype &name, CNameHistory &data) const override;
+    unsigned GetNameHistorySize(const valtype &name) const override;
+    bool GetNameHistory(const valtype &name, unsigned start, unsigned count, std::vector<CNameData> &entries) const override;
     CNameIterator* IterateNames() const override;
+    CNameIterator* IterateNamesSnapshot() const override;
+    CNameIterator* IterateRecentNames(unsigned minHeight) const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) override;
     CCoinsViewCursor *Cursor() const override;
     bool ValidateNameDB(CGameDB& gameDb) const;
@@ -103,6 +106,10 @@ public:
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+private:
+    //! Convert name histories stored as a single record per name to individual entries.
+    bool UpgradeNameHistory();
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -136,13 +143,16 @@ public:
     CBlockTreeDB(const CBlockTreeDB&) = delete;
     CBlockTreeDB& operator=(const CBlockTreeDB&) = delete;
 
-    bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
+    bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo,
+                        const std::vector<std::pair<uint256, const CAuxPow*> >& auxpows = {}, const std::vector<uint256>& auxpowsErased = {});
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
     bool ReadReindexing(bool &fReindexing);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
+    bool ReadAuxpow(const uint256 &hash, CAuxPow &auxpow);
+    bool WriteAuxpows(const std::vector<std::pair<uint256, const CAuxPow*> >& auxpows);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
@@ -703,6 +703,22 @@ public:
         return names.getTxForName(name);
     }
 
+    /**
+     * Return the pending transaction that registers or updates a name
+     * (i. e., the pending move of a player), or null if there is none.
+     */
+    inline CTransactionRef
+    getPendingNameTx (const valtype& name) const
+    {
+        AssertLockHeld(cs);
+        const uint256 txid = names.getTxForName(name);
+        if (txid.IsNull())
+            return nullptr;
+        const txiter mi = mapTx.find(txid);
+        assert(mi != mapTx.end());
+        return mi->GetSharedTx();
+    }
+
     /**
      * Check if a tx can be added to it according to name criteria.
      * (The non-name criteria are checked in main.cpp and not here, we
@@ -17,7 +17,9 @@
 #include <consensus/validation.h>
 #include <cuckoocache.h>
 #include <game/db.h>
+#include <game/delta.h>
 #include <game/move.h>
+#include <game/prefetch.h>
 #include <game/state.h>
 #include <game/tx.h>
 #include <hash.h>
@@ -152,7 +154,7 @@ public:
 
     bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock);
 
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex);
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW = true);
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock);
 
     // Block (dis)connection on a given view:
@@ -160,7 +162,9 @@ public:
     bool ConnectBlockWithGameTx(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
                     CCoinsViewCache& view,
                     std::vector<CTransactionRef>& vGameTx,
-                    const CChainParams& chainparams, bool fJustCheck = false);
+                    std::shared_ptr<const GameStateDelta>& gameDelta,
+                    const CChainParams& chainparams, bool fJustCheck = false,
+                    const StepResult* pgameStep = nullptr);
     bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
                     CCoinsViewCache& view,
                     const CChainParams& chainparams, bool fJustCheck = false);
@@ -212,6 +216,7 @@ int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fTxIndex = false;
+bool fAuxpowIndex = DEFAULT_AUXPOWINDEX;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -264,6 +269,14 @@ namespace {
 
     /** Dirty block file entries. */
     std::set<int> setDirtyFileInfo;
+
+    /** Protects mapDirtyAuxpow, which is also read without cs_main. */
+    CCriticalSection cs_auxpowIndex;
+
+    /** Auxpows of new headers that are not yet written to the block index
+     *  database.  They are written together with the (dirty) block index
+     *  entries of their headers. */
+    std::map<uint256, boost::shared_ptr<CAuxPow>> mapDirtyAuxpow;
 } // anon namespace
 
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator)
@@ -1882,6 +1895,80 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+namespace {
+
+/**
+ * Closure checking the proof-of-work (including the auxpow) of a single
+ * block header.  The result is recorded in a flag owned by the caller.
+ */
+class CHeaderPowCheck
+{
+private:
+    const CBlockHeader* header;
+    const Consensus::Params* params;
+    unsigned char* fValid;
+
+public:
+    CHeaderPowCheck() : header(nullptr), params(nullptr), fValid(nullptr) {}
+    CHeaderPowCheck(const CBlockHeader& headerIn, const Consensus::Params& paramsIn, unsigned char& fValidIn) :
+        header(&headerIn), params(&paramsIn), fValid(&fValidIn) { }
+
+    bool operator()()
+    {
+        *fValid = CheckProofOfWork(*header, *params);
+        return *fValid;
+    }
+
+    void swap(CHeaderPowCheck& check)
+    {
+        std::swap(header, check.header);
+        std::swap(params, check.params);
+        std::swap(fValid, check.fValid);
+    }
+};
+
+} // anonymous namespace
+
+static CCheckQueue<CHeaderPowCheck> headercheckqueue(16);
+
+void ThreadHeaderCheck() {
+    RenameThread("bitcoin-headerch");
+    headercheckqueue.Thread();
+}
+
+/**
+ * Check the proof-of-work of all headers that are not yet known, using
+ * the header check threads.  vValid[i] is set for each header whose check
+ * ran and succeeded.  Headers that fail (or whose check was skipped because
+ * another one failed first) are left unset, so that AcceptBlockHeader
+ * checks them again and reports the error.
+ */
+static void CheckHeadersProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& params, std::vector<unsigned char>& vValid)
+{
+    vValid.assign(headers.size(), 0);
+
+    std::vector<CHeaderPowCheck> vChecks;
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < headers.size(); ++i) {
+            if (!LookupBlockIndex(headers[i].GetHash()))
+                vChecks.emplace_back(headers[i], params, vValid[i]);
+        }
+    }
+
+    if (nScriptCheckThreads == 0 || vChecks.size() <= 1) {
+        for (CHeaderPowCheck& check : vChecks) {
+            if (!check())
+                break;
+        }
+        return;
+    }
+
+    CCheckQueueControl<CHeaderPowCheck> control(&headercheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1977,7 +2064,9 @@ static int64_t nBlocksTotal = 0;
 bool
 CChainState::ConnectBlockWithGameTx(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view,
                        std::vector<CTransactionRef>& vGameTx,
-                       const CChainParams& chainparams, bool fJustCheck)
+                       std::shared_ptr<const GameStateDelta>& gameDelta,
+                       const CChainParams& chainparams, bool fJustCheck,
+                       const StepResult* pgameStep)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -2166,18 +2255,26 @@ CChainState::ConnectBlockWithGameTx(const CBlock& block, CValidationState& state
        checks about validity of all moves.  Ignore this for the genesis
        block, since there is no "previous state" to fetch and advance.
        There are no game transactions for it, either.  In this case,
-       the default-constructed StepResult is fine.  */
+       the default-constructed StepResult is fine.  When just checking
+       a block for which the caller already performed the step (the
+       miner's templates), its result is used instead.  */
     const bool isGenesis = (block.GetHash() == chainparams.GetConsensus().hashGenesisBlock);
+    assert(!pgameStep || fJustCheck);
     StepResult stepResult;
-    if (!isGenesis)
+    GameStateRef prevGameState;
+    std::shared_ptr<GameState> newGameState;
+    if (pgameStep)
+      stepResult = *pgameStep;
+    else if (!isGenesis)
       {
-        GameState prevGameState(chainparams.GetConsensus ());
-        if (!pgameDb->get (*pindex->pprev->phashBlock, prevGameState))
+        prevGameState = pgameDb->getSnapshot (*pindex->pprev->phashBlock);
+        if (!prevGameState)
           return state.Error ("ConnectBlock: failed to read prev game state");
 
-        GameState newGameState(chainparams.GetConsensus ());
-        if (!PerformStep (block, prevGameState, &view, state,
-                          stepResult, newGameState))
+        newGameState
+          = std::make_shared<GameState> (chainparams.GetConsensus ());
+        if (!PerformStep (block, *prevGameState, &view, state,
+                          stepResult, *newGameState))
           return state.Invalid (error ("%s: game engine step failed",
                                        __func__));
 
@@ -2226,6 +2323,14 @@ CChainState::ConnectBlockWithGameTx(const CBlock& block, CValidationState& state
     if (!WriteTxIndexDataForBlock(block, state, pindex, vGameTx, isGenesis))
         return false;
 
+    // The delta is only needed for blocks that are actually connected, so
+    // it is not computed when just checking a block (e.g. a mined template).
+    if (!isGenesis) {
+        gameDelta = std::make_shared<const GameStateDelta>(*prevGameState, *newGameState);
+        pgameDb->storeDelta(*gameDelta);
+        pgameDb->expireOldDelta(*pindex);
+    }
+
     assert(pindex->phashBlock);
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -2245,10 +2350,66 @@ CChainState::ConnectBlock(const CBlock& block, CValidationState& state,
                           const CChainParams& chainparams, bool fJustCheck)
 {
   std::vector<CTransactionRef> vGameTx;
-  return ConnectBlockWithGameTx(block, state, pindex, view, vGameTx,
+  std::shared_ptr<const GameStateDelta> gameDelta;
+  return ConnectBlockWithGameTx(block, state, pindex, view, vGameTx, gameDelta,
                                 chainparams, fJustCheck);
 }
 
+/** Number of unwritten auxpows above which the block index is written. */
+static const size_t MAX_DIRTY_AUXPOWS = 10000;
+
+static bool AuxpowIndexWriteNeeded()
+{
+    LOCK(cs_auxpowIndex);
+    return mapDirtyAuxpow.size() > MAX_DIRTY_AUXPOWS;
+}
+
+/**
+ * Collect the auxpow index changes that go with writing the given block index
+ * entries:  The auxpows of new headers are written.  Entries of blocks that
+ * are invalid are erased.  Entries of pruned blocks are kept, since the index
+ * is the only place left to serve their headers from.
+ */
+static void CollectDirtyAuxpows(const std::vector<const CBlockIndex*>& vBlocks,
+                                std::vector<std::pair<uint256, boost::shared_ptr<CAuxPow>>>& vAuxpows,
+                                std::vector<uint256>& vErased)
+{
+    LOCK(cs_auxpowIndex);
+    for (const CBlockIndex* pindex : vBlocks) {
+        const uint256 hash = pindex->GetBlockHash();
+        if (pindex->nStatus & BLOCK_FAILED_MASK) {
+            if (pindex->IsAuxpow()) {
+                vErased.push_back(hash);
+                mapDirtyAuxpow.erase(hash);
+            }
+            continue;
+        }
+        const auto mi = mapDirtyAuxpow.find(hash);
+        if (mi != mapDirtyAuxpow.end()) {
+            vAuxpows.push_back(*mi);
+        }
+    }
+}
+
+boost::shared_ptr<CAuxPow> LookupIndexedAuxpow(const uint256& hash)
+{
+    {
+        LOCK(cs_auxpowIndex);
+        const auto mi = mapDirtyAuxpow.find(hash);
+        if (mi != mapDirtyAuxpow.end()) {
+            return mi->second;
+        }
+    }
+
+    // Entries are only removed from mapDirtyAuxpow after they are written,
+    // so if it is not found above, it is in the database (if anywhere).
+    boost::shared_ptr<CAuxPow> auxpow(new CAuxPow());
+    if (pblocktree && pblocktree->ReadAuxpow(hash, *auxpow)) {
+        return auxpow;
+    }
+    return boost::shared_ptr<CAuxPow>();
+}
+
 /**
  * Update the on-disk chain state.
  * The caches and indexes are flushed depending on the mode we're called with
@@ -2308,10 +2469,12 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
         bool fPeriodicWrite = mode == FlushStateMode::PERIODIC && nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
         // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
         bool fPeriodicFlush = mode == FlushStateMode::PERIODIC && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
+        // Many auxpows of new headers are waiting to be written with the block index.
+        bool fAuxpowWrite = mode != FlushStateMode::NONE && AuxpowIndexWriteNeeded();
         // Combine all conditions that result in a full cache flush.
         fDoFullFlush = (mode == FlushStateMode::ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
         // Write blocks and block index to disk.
-        if (fDoFullFlush || fPeriodicWrite) {
+        if (fDoFullFlush || fPeriodicWrite || fAuxpowWrite) {
             // Depend on nMinDiskSpace to ensure we can write block index
             if (!CheckDiskSpace(0, true))
                 return state.Error("out of disk space");
@@ -2331,9 +2494,25 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                     vBlocks.push_back(*it);
                     setDirtyBlockIndex.erase(it++);
                 }
-                if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks)) {
+                std::vector<std::pair<uint256, boost::shared_ptr<CAuxPow>>> vAuxpows;
+                std::vector<uint256> vAuxpowsErased;
+                CollectDirtyAuxpows(vBlocks, vAuxpows, vAuxpowsErased);
+                std::vector<std::pair<uint256, const CAuxPow*>> vAuxpowPtrs;
+                vAuxpowPtrs.reserve(vAuxpows.size());
+                for (const auto& entry : vAuxpows) {
+                    vAuxpowPtrs.emplace_back(entry.first, entry.second.get());
+                }
+                if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks, vAuxpowPtrs, vAuxpowsErased)) {
                     return AbortNode(state, "Failed to write to block index database");
                 }
+                // Only now that they are on disk, the auxpows can be
+                // dropped from memory.
+                {
+                    LOCK(cs_auxpowIndex);
+                    for (const auto& entry : vAuxpows) {
+                        mapDirtyAuxpow.erase(entry.first);
+                    }
+                }
             }
             // Finally remove any pruned files
             if (fFlushForPrune)
@@ -2394,6 +2573,9 @@ void static UpdateTip(const CBlockIndex *pindexNew, const CChainParams& chainPar
     // New best block
     mempool.AddTransactionsUpdated(1);
 
+    // Publish the new tip's game state for lock-free readers
+    pgameDb->publishTip(pindexNew->GetBlockHash());
+
     {
         WaitableLock lock(g_best_block_mutex);
         g_best_block = pindexNew->GetBlockHash();
@@ -2445,6 +2627,37 @@ void static UpdateTip(const CBlockIndex *pindexNew, const CChainParams& chainPar
 
 }
 
+/**
+ * Construct the game state delta that undoes the game step of the given
+ * block, i.e. leads from its game state back to that of its parent.  This
+ * inverts the block's stored delta against the parent state, or else
+ * compares the full states.  Returns null for the genesis block and if the
+ * states can not be read.
+ */
+static std::shared_ptr<const GameStateDelta>
+GetGameUndoDelta(const CBlockIndex& index)
+{
+    if (!index.pprev)
+        return nullptr;
+
+    const GameStateRef parent = pgameDb->getSnapshot(index.pprev->GetBlockHash());
+    if (!parent) {
+        error("%s: failed to read game state of %s", __func__, index.pprev->GetBlockHash().ToString());
+        return nullptr;
+    }
+
+    GameStateDelta delta;
+    if (pgameDb->getDelta(index.GetBlockHash(), delta))
+        return std::make_shared<const GameStateDelta>(delta.Invert(*parent));
+
+    const GameStateRef gameState = pgameDb->getSnapshot(index.GetBlockHash());
+    if (!gameState) {
+        error("%s: failed to read game state of %s", __func__, index.GetBlockHash().ToString());
+        return nullptr;
+    }
+    return std::make_shared<const GameStateDelta>(*gameState, *parent);
+}
+
 /** Disconnect chainActive's tip.
   * After calling, the mempool will be in an inconsistent state, with
   * transactions from disconnected blocks being added to disconnectpool.  You
@@ -2512,11 +2725,20 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
 
     chainActive.SetTip(pindexDelete->pprev);
 
+    // Construct the delta undoing the block's game step for the listeners
+    // before the block's delta is expired.  By the time they are notified,
+    // it may already be erased from the game DB.
+    const std::shared_ptr<const GameStateDelta> undoDelta
+        = GetGameUndoDelta(*pindexDelete);
+
+    // The game state delta of the block is no longer needed.
+    pgameDb->expireDelta(pindexDelete->GetBlockHash());
+
     UpdateTip(pindexDelete->pprev, chainparams);
     CheckNameDB (true);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
-    GetMainSignals().BlockDisconnected(pblock, pindexDelete, vGameTx,
+    GetMainSignals().BlockDisconnected(pblock, pindexDelete, vGameTx, undoDelta,
                                        nameConflicts.GetNameConflicts());
     return true;
 }
@@ -2531,6 +2753,7 @@ struct PerBlockConnectTrace {
     CBlockIndex* pindex = nullptr;
     std::shared_ptr<const CBlock> pblock;
     std::shared_ptr<std::vector<CTransactionRef>> vGameTx;
+    std::shared_ptr<const GameStateDelta> gameDelta;
     std::shared_ptr<std::vector<CTransactionRef>> conflictedTxs;
     std::shared_ptr<std::vector<CTransactionRef>> txNameConflicts;
     PerBlockConnectTrace() : vGameTx(std::make_shared<std::vector<CTransactionRef>>()),
@@ -2568,13 +2791,14 @@ public:
         pool.NotifyEntryRemoved.disconnect(boost::bind(&ConnectTrace::NotifyEntryRemoved, this, _1, _2));
     }
 
-    void BlockConnected(CBlockIndex* pindex, std::shared_ptr<const CBlock> pblock, std::shared_ptr<std::vector<CTransactionRef>> vGameTx) {
+    void BlockConnected(CBlockIndex* pindex, std::shared_ptr<const CBlock> pblock, std::shared_ptr<std::vector<CTransactionRef>> vGameTx, std::shared_ptr<const GameStateDelta> gameDelta) {
         assert(!blocksConnected.back().pindex);
         assert(pindex);
         assert(pblock);
         blocksConnected.back().pindex = pindex;
         blocksConnected.back().pblock = std::move(pblock);
         blocksConnected.back().vGameTx = std::move(vGameTx);
+        blocksConnected.back().gameDelta = std::move(gameDelta);
         blocksConnected.emplace_back();
     }
 
@@ -2630,13 +2854,14 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     }
     const CBlock& blockConnecting = *pthisBlock;
     auto vGameTx = std::make_shared<std::vector<CTransactionRef>>();
+    std::shared_ptr<const GameStateDelta> gameDelta;
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
     {
         CCoinsViewCache view(pcoinsTip.get());
-        bool rv = ConnectBlockWithGameTx(blockConnecting, state, pindexNew, view, *vGameTx, chainparams);
+        bool rv = ConnectBlockWithGameTx(blockConnecting, state, pindexNew, view, *vGameTx, gameDelta, chainparams);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -2669,7 +2894,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
 
-    connectTrace.BlockConnected(pindexNew, std::move(pthisBlock), std::move(vGameTx));
+    connectTrace.BlockConnected(pindexNew, std::move(pthisBlock), std::move(vGameTx), std::move(gameDelta));
     return true;
 }
 
@@ -2904,7 +3129,7 @@ bool CChainState::ActivateBestChain(CValidationState &state, const CChainParams&
 
             for (const PerBlockConnectTrace& trace : connectTrace.GetBlocksConnected()) {
                 assert(trace.pblock && trace.pindex);
-                GetMainSignals().BlockConnected(trace.pblock, trace.pindex, trace.vGameTx, trace.conflictedTxs, trace.txNameConflicts);
+                GetMainSignals().BlockConnected(trace.pblock, trace.pindex, trace.vGameTx, trace.gameDelta, trace.conflictedTxs, trace.txNameConflicts);
             }
 
             // Notify external listeners about the new tip.
@@ -3530,7 +3755,7 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3548,7 +3773,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), fCheckPOW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3577,9 +3802,18 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             }
         }
     }
-    if (pindex == nullptr)
+    if (pindex == nullptr) {
         pindex = AddToBlockIndex(block);
 
+        // Keep the auxpow, so that the header can be served without
+        // reading the block file.  It is written to disk together with
+        // the block index entry.
+        if (fAuxpowIndex && block.auxpow) {
+            LOCK(cs_auxpowIndex);
+            mapDirtyAuxpow.emplace(hash, block.auxpow);
+        }
+    }
+
     if (ppindex)
         *ppindex = pindex;
 
@@ -3592,11 +3826,21 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // The proof-of-work checks are expensive for scrypt and auxpow headers,
+    // but do not depend on the chain.  Do them in parallel and without
+    // holding cs_main for a whole batch.
+    std::vector<unsigned char> vPowValid;
+    if (headers.size() > 1)
+        CheckHeadersProofOfWork(headers, chainparams.GetConsensus(), vPowValid);
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); ++i) {
+            const CBlockHeader& header = headers[i];
+            const bool fCheckPOW = vPowValid.empty() || !vPowValid[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex, fCheckPOW)) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3606,6 +3850,14 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
         }
     }
     NotifyHeaderTip();
+
+    // Write the auxpows of new headers (together with the block index)
+    // once many of them have accumulated during headers sync.
+    if (AuxpowIndexWriteNeeded()) {
+        CValidationState stateFlush;
+        FlushStateToDisk(chainparams, stateFlush, FlushStateMode::IF_NEEDED);
+    }
+
     return true;
 }
 
@@ -3742,7 +3994,7 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
     return true;
 }
 
-bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW, bool fCheckMerkleRoot)
+bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW, bool fCheckMerkleRoot, const StepResult* pgameStep)
 {
     AssertLockHeld(cs_main);
     assert(pindexPrev && pindexPrev == chainActive.Tip());
@@ -3760,7 +4012,9 @@ bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams,
         return error("%s: Consensus::CheckBlock: %s", __func__, FormatStateMessage(state));
     if (!ContextualCheckBlock(block, state, chainparams.GetConsensus(), pindexPrev))
         return error("%s: Consensus::ContextualCheckBlock: %s", __func__, FormatStateMessage(state));
-    if (!g_chainstate.ConnectBlock(block, state, &indexDummy, viewNew, chainparams, true))
+    std::vector<CTransactionRef> vGameTx;
+    std::shared_ptr<const GameStateDelta> gameDelta;
+    if (!g_chainstate.ConnectBlockWithGameTx(block, state, &indexDummy, viewNew, vGameTx, gameDelta, chainparams, true, pgameStep))
         return false;
     assert(state.IsValid());
 
@@ -3791,6 +4045,9 @@ void PruneOneBlockFile(const int fileNumber)
     for (const auto& entry : mapBlockIndex) {
         CBlockIndex* pindex = entry.second;
         if (pindex->nFile == fileNumber) {
+            // Without the block, its game state delta is not kept either.
+            if (pgameDb && (pindex->nStatus & BLOCK_HAVE_DATA))
+                pgameDb->expireDelta(pindex->GetBlockHash());
             pindex->nStatus &= ~BLOCK_HAVE_DATA;
             pindex->nStatus &= ~BLOCK_HAVE_UNDO;
             pindex->nFile = 0;
@@ -4098,6 +4355,10 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("namehistory", fNameHistory);
     LogPrintf("LoadBlockIndexDB(): name history %s\n", fNameHistory ? "enabled" : "disabled");
 
+    // Check whether we have the name height index
+    pblocktree->ReadFlag("nameheightindex", fNameHeightIndex);
+    LogPrintf("LoadBlockIndexDB(): name height index %s\n", fNameHeightIndex ? "enabled" : "disabled");
+
     return true;
 }
 
@@ -4242,13 +4503,21 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
            needed.  I. e., those behind the last 2,000 block level that
            is stored nevertheless.  */
 
+        /* Read the blocks to reconnect on worker threads, so that we do
+           not have to wait for the disk while connecting them.  */
+        std::vector<BlockPrefetcher::Entry> toRead;
+        for (const CBlockIndex* p = chainActive.Next(pindex); p; p = chainActive.Next(p))
+            toRead.push_back(BlockPrefetcher::Entry(*p));
+        BlockPrefetcher prefetcher(chainparams.GetConsensus(), toRead, false);
+
         while (pindex != chainActive.Tip()) {
             boost::this_thread::interruption_point();
             uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50))), false);
             pindex = chainActive.Next(pindex);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            const std::unique_ptr<ParsedBlock> prefetched = prefetcher.Next();
+            if (!prefetched)
                 return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+            const CBlock& block = prefetched->block;
             if (!g_chainstate.ConnectBlock(block, state, pindex, coins, chainparams))
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
         }
@@ -4477,6 +4746,10 @@ void UnloadBlockIndex()
     nLastBlockFile = 0;
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
+    {
+        LOCK(cs_auxpowIndex);
+        mapDirtyAuxpow.clear();
+    }
     versionbitscache.Clear();
     for (int b = 0; b < VERSIONBITS_NUM_BITS; b++) {
         warningcache[b].clear();
@@ -4491,6 +4764,92 @@ void UnloadBlockIndex()
     g_chainstate.UnloadBlockIndex();
 }
 
+/**
+ * Bring the auxpow index in line with -auxpowindex.  If it was not kept
+ * before (e. g., for a data directory from before it existed), fill it in
+ * from the block files.
+ */
+static bool UpgradeAuxpowIndex(const CChainParams& chainparams)
+{
+    bool fIndexed = false;
+    pblocktree->ReadFlag("auxpowindex", fIndexed);
+    if (!fAuxpowIndex) {
+        if (fIndexed)
+            pblocktree->WriteFlag("auxpowindex", false);
+        return true;
+    }
+    if (fIndexed)
+        return true;
+
+    // Read the headers in the order they are stored on disk.
+    std::vector<const CBlockIndex*> vBlocks;
+    for (const auto& entry : mapBlockIndex) {
+        const CBlockIndex* pindex = entry.second;
+        if (pindex->IsAuxpow()
+                && (pindex->nStatus & BLOCK_HAVE_DATA)
+                && !(pindex->nStatus & BLOCK_FAILED_MASK)) {
+            vBlocks.push_back(pindex);
+        }
+    }
+    std::sort(vBlocks.begin(), vBlocks.end(), [](const CBlockIndex* a, const CBlockIndex* b) {
+        return std::make_pair(a->nFile, a->nDataPos) < std::make_pair(b->nFile, b->nDataPos);
+    });
+    LogPrintf("Building the auxpow index for %u blocks...\n", vBlocks.size());
+    LogPrintf("[0%%]..."); /* Continued */
+    uiInterface.ShowProgress(_("Building auxpow index..."), 0, false);
+
+    static const size_t BATCH_SIZE = 1000;
+    std::vector<CBlockHeader> vHeaders;
+    vHeaders.reserve(BATCH_SIZE);
+    auto writeBatch = [&vHeaders]() {
+        std::vector<std::pair<uint256, const CAuxPow*>> vAuxpows;
+        for (const CBlockHeader& header : vHeaders) {
+            vAuxpows.emplace_back(header.GetHash(), header.auxpow.get());
+        }
+        vHeaders.clear();
+        return pblocktree->WriteAuxpows(vAuxpows);
+    };
+    int reportDone = 0;
+    for (size_t i = 0; i < vBlocks.size(); ++i) {
+        const CBlockIndex* pindex = vBlocks[i];
+        if (i % BATCH_SIZE == 0) {
+            const int percentageDone = (int)(i * 100.0 / vBlocks.size() + 0.5);
+            uiInterface.ShowProgress(_("Building auxpow index..."), percentageDone, false);
+            if (reportDone < percentageDone/10) {
+                // report max. every 10% step
+                LogPrintf("[%d%%]...", percentageDone); /* Continued */
+                reportDone = percentageDone/10;
+            }
+        }
+
+        CBlockHeader header;
+        if (!ReadBlockHeaderFromDisk(header, pindex, chainparams.GetConsensus()) || !header.auxpow) {
+            LogPrintf("%s: failed to read header of block %s\n", __func__, pindex->GetBlockHash().ToString());
+            continue;
+        }
+        vHeaders.push_back(header);
+
+        if (vHeaders.size() == BATCH_SIZE) {
+            if (!writeBatch())
+                return error("%s: failed to write auxpow index", __func__);
+            // The flag is not yet set, so the next start continues.
+            if (ShutdownRequested()) {
+                uiInterface.ShowProgress("", 100, false);
+                LogPrintf("[CANCELLED].\n");
+                return true;
+            }
+        }
+    }
+    uiInterface.ShowProgress("", 100, false);
+    LogPrintf("[DONE].\n");
+    if (!writeBatch())
+        return error("%s: failed to write auxpow index", __func__);
+
+    pblocktree->WriteFlag("auxpowindex", true);
+    LogPrintf("Auxpow index complete\n");
+    return true;
+}
+
 bool LoadBlockIndex(const CChainParams& chainparams)
 {
     // Load block index from databases
@@ -4499,6 +4858,8 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         bool ret = LoadBlockIndexDB(chainparams);
         if (!ret) return false;
         needs_init = mapBlockIndex.empty();
+        if (!needs_init && !UpgradeAuxpowIndex(chainparams))
+            return false;
     }
 
     if (needs_init) {
@@ -4514,6 +4875,10 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         pblocktree->WriteFlag("txindex", fTxIndex);
         fNameHistory = gArgs.GetBoolArg("-namehistory", false);
         pblocktree->WriteFlag("namehistory", fNameHistory);
+        fNameHeightIndex = gArgs.GetBoolArg("-nameheightindex", false);
+        pblocktree->WriteFlag("nameheightindex", fNameHeightIndex);
+        // The auxpow index is filled in as headers are accepted
+        pblocktree->WriteFlag("auxpowindex", fAuxpowIndex);
     }
     return true;
 }
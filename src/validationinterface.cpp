@@ -22,8 +22,8 @@
 struct MainSignalsInstance {
     boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
     boost::signals2::signal<void (const CTransactionRef &)> TransactionAddedToMempool;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef>&, const std::vector<CTransactionRef>&, const std::vector<CTransactionRef>&)> BlockConnected;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *, const std::vector<CTransactionRef>&, const std::vector<CTransactionRef>&)> BlockDisconnected;
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef>&, const std::shared_ptr<const GameStateDelta>&, const std::vector<CTransactionRef>&, const std::vector<CTransactionRef>&)> BlockConnected;
+    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *, const std::vector<CTransactionRef>&, const std::shared_ptr<const GameStateDelta>&, const std::vector<CTransactionRef>&)> BlockDisconnected;
     boost::signals2::signal<void (const CTransactionRef &)> TransactionRemovedFromMempool;
     boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
     boost::signals2::signal<void (const uint256 &)> Inventory;
@@ -77,8 +77,8 @@ CMainSignals& GetMainSignals()
 void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.m_internals->UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.m_internals->TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
-    g_signals.m_internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3, _4, _5));
-    g_signals.m_internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2, _3, _4));
+    g_signals.m_internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3, _4, _5, _6));
+    g_signals.m_internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2, _3, _4, _5));
     g_signals.m_internals->TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1));
     g_signals.m_internals->SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.m_internals->Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
@@ -93,8 +93,8 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.m_internals->Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
     g_signals.m_internals->SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.m_internals->TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
-    g_signals.m_internals->BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3, _4, _5));
-    g_signals.m_internals->BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2, _3, _4));
+    g_signals.m_internals->BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3, _4, _5, _6));
+    g_signals.m_internals->BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2, _3, _4, _5));
     g_signals.m_internals->TransactionRemovedFromMempool.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1));
     g_signals.m_internals->UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.m_internals->NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
@@ -154,15 +154,15 @@ void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx) {
     });
 }
 
-void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>> &pvGameTx, const std::shared_ptr<const std::vector<CTransactionRef>>& pvtxConflicted, const std::shared_ptr<const std::vector<CTransactionRef>> &pvNameConflicts) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindex, pvGameTx, pvtxConflicted, pvNameConflicts, this] {
-        m_internals->BlockConnected(pblock, pindex, *pvGameTx, *pvtxConflicted, *pvNameConflicts);
+void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>> &pvGameTx, const std::shared_ptr<const GameStateDelta> &pgameDelta, const std::shared_ptr<const std::vector<CTransactionRef>>& pvtxConflicted, const std::shared_ptr<const std::vector<CTransactionRef>> &pvNameConflicts) {
+    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindex, pvGameTx, pgameDelta, pvtxConflicted, pvNameConflicts, this] {
+        m_internals->BlockConnected(pblock, pindex, *pvGameTx, pgameDelta, *pvtxConflicted, *pvNameConflicts);
     });
 }
 
-void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindexDelete, const std::shared_ptr<const std::vector<CTransactionRef>> &pvGameTx, const std::shared_ptr<const std::vector<CTransactionRef>> &pvNameConflicts) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindexDelete, pvGameTx, pvNameConflicts, this] {
-        m_internals->BlockDisconnected(pblock, pindexDelete, *pvGameTx, *pvNameConflicts);
+void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindexDelete, const std::shared_ptr<const std::vector<CTransactionRef>> &pvGameTx, const std::shared_ptr<const GameStateDelta> &pgameDelta, const std::shared_ptr<const std::vector<CTransactionRef>> &pvNameConflicts) {
+    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindexDelete, pvGameTx, pgameDelta, pvNameConflicts, this] {
+        m_internals->BlockDisconnected(pblock, pindexDelete, *pvGameTx, pgameDelta, *pvNameConflicts);
     });
 }
 
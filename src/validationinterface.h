@@ -19,6 +19,7 @@ class CConnman;
 class CReserveScript;
 class CValidationInterface;
 class CValidationState;
+class GameStateDelta;
 class uint256;
 class CScheduler;
 class CTxMemPool;
@@ -86,16 +87,19 @@ protected:
     /**
      * Notifies listeners of a block being connected.
      * Provides a vector of transactions evicted from the mempool as a result.
+     * gameDelta is the block's game state delta (null for the genesis block).
      *
      * Called on a background thread.
      */
-    virtual void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &vGameTx, const std::vector<CTransactionRef> &txnConflicted, const std::vector<CTransactionRef> &vNameConflicts) {}
+    virtual void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &vGameTx, const std::shared_ptr<const GameStateDelta> &gameDelta, const std::vector<CTransactionRef> &txnConflicted, const std::vector<CTransactionRef> &vNameConflicts) {}
     /**
      * Notifies listeners of a block being disconnected
+     * gameDelta undoes the block's game step, i.e. it leads from the block's
+     * game state back to that of its parent (null if it is not available).
      *
      * Called on a background thread.
      */
-    virtual void BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindexDelete, const std::vector<CTransactionRef> &vGameTx, const std::vector<CTransactionRef> &vNameConflicts) {}
+    virtual void BlockDisconnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindexDelete, const std::vector<CTransactionRef> &vGameTx, const std::shared_ptr<const GameStateDelta> &gameDelta, const std::vector<CTransactionRef> &vNameConflicts) {}
     /**
      * Notifies listeners of the new active block chain on-disk.
      *
@@ -155,8 +159,8 @@ public:
 
     void UpdatedBlockTip(const CBlockIndex *, const CBlockIndex *, bool fInitialDownload);
     void TransactionAddedToMempool(const CTransactionRef &);
-    void BlockConnected(const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>> &, const std::shared_ptr<const std::vector<CTransactionRef>> &, const std::shared_ptr<const std::vector<CTransactionRef>> &);
-    void BlockDisconnected(const std::shared_ptr<const CBlock> &, const CBlockIndex *, const std::shared_ptr<const std::vector<CTransactionRef>> &, const std::shared_ptr<const std::vector<CTransactionRef>> &);
+    void BlockConnected(const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>> &, const std::shared_ptr<const GameStateDelta> &, const std::shared_ptr<const std::vector<CTransactionRef>> &, const std::shared_ptr<const std::vector<CTransactionRef>> &);
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &, const CBlockIndex *, const std::shared_ptr<const std::vector<CTransactionRef>> &, const std::shared_ptr<const GameStateDelta> &, const std::shared_ptr<const std::vector<CTransactionRef>> &);
     void SetBestChain(const CBlockLocator &);
     void Inventory(const uint256 &);
     void Broadcast(int64_t nBestBlockTime, CConnman* connman);
@@ -545,7 +545,8 @@ name_update (const JSONRPCRequest& request)
     LOCK (mempool.cs);
     if (mempool.updatesName (name))
       throw JSONRPCError (RPC_TRANSACTION_ERROR,
-                          "there is already a pending update for this name");
+                          "there is already a pending update for this name: "
+                            + mempool.getTxForName (name).GetHex ());
   }
 
   CNameData oldData;
@@ -597,7 +598,7 @@ name_update (const JSONRPCRequest& request)
   if (mi == gameState.players.end ())
     throw JSONRPCError (RPC_INTERNAL_ERROR,
                         "failed to find player in game state");
-  CAmount amount = mi->second.lockedCoins;
+  CAmount amount = mi->second->lockedCoins;
   amount += GetRequiredGameFee (name, value);
 
   CCoinControl coinControl;
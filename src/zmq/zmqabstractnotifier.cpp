@@ -20,3 +20,13 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyBlockConnected(const CBlockIndex * /*pindex*/, const std::vector<CTransactionRef> &/*vGameTx*/, const std::shared_ptr<const GameStateDelta> &/*gameDelta*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBlockDisconnected(const CBlockIndex * /*pindex*/, const std::vector<CTransactionRef> &/*vGameTx*/, const std::shared_ptr<const GameStateDelta> &/*gameDelta*/)
+{
+    return true;
+}
@@ -9,6 +9,7 @@
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class GameStateDelta;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
@@ -34,6 +35,8 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyBlockConnected(const CBlockIndex *pindex, const std::vector<CTransactionRef> &vGameTx, const std::shared_ptr<const GameStateDelta> &gameDelta);
+    virtual bool NotifyBlockDisconnected(const CBlockIndex *pindex, const std::vector<CTransactionRef> &vGameTx, const std::shared_ptr<const GameStateDelta> &gameDelta);
 
 protected:
     void *psocket;
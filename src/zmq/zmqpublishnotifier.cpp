@@ -4,6 +4,9 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <game/db.h>
+#include <game/delta.h>
+#include <game/state.h>
 #include <streams.h>
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
@@ -16,6 +19,11 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_GAMEDELTA = "gamestatedelta";
+
+/* Event types at the start of gamestatedelta messages.  */
+static const unsigned char GAMEDELTA_CONNECTED = 0;
+static const unsigned char GAMEDELTA_DISCONNECTED = 1;
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -195,3 +203,81 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+/**
+ * Log that the game state delta of a block can not be published.  This
+ * returns true, since returning false from a notifier would shut it down
+ * for good.  Subscribers see the skipped message as a gap in the sequence
+ * numbers.
+ */
+static bool ReportMissingGameDelta(const uint256 &hash)
+{
+    LogPrintf("zmq: ERROR: Can't read game state delta for %s, not publishing it\n",
+              hash.GetHex());
+    return true;
+}
+
+bool CZMQPublishGameStateDeltaNotifier::Publish(bool fConnected, const GameStateDelta &delta, const std::vector<CTransactionRef> &vGameTx)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    ss << (fConnected ? GAMEDELTA_CONNECTED : GAMEDELTA_DISCONNECTED);
+    ss << delta << vGameTx;
+    return SendMessage(MSG_GAMEDELTA, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishGameStateDeltaNotifier::NotifyBlockConnected(const CBlockIndex *pindex, const std::vector<CTransactionRef> &vGameTx, const std::shared_ptr<const GameStateDelta> &gameDelta)
+{
+    /* The genesis block has no game step and thus no delta.  */
+    if (!pindex->pprev)
+        return true;
+
+    const uint256 hash = pindex->GetBlockHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish gamestatedelta %s\n", hash.GetHex());
+
+    /* ConnectBlock passes the delta it computed along with the signal.  The
+       lookups below are only fallbacks in case it is missing.  */
+    if (gameDelta)
+        return Publish(true, *gameDelta, vGameTx);
+
+    GameStateDelta delta;
+    if (!pgameDb->getDelta(hash, delta))
+    {
+        const GameStateRef before = pgameDb->getSnapshot(pindex->pprev->GetBlockHash());
+        const GameStateRef after = pgameDb->getSnapshot(hash);
+        if (!before || !after)
+            return ReportMissingGameDelta(hash);
+        delta = GameStateDelta(*before, *after);
+    }
+
+    return Publish(true, delta, vGameTx);
+}
+
+bool CZMQPublishGameStateDeltaNotifier::NotifyBlockDisconnected(const CBlockIndex *pindex, const std::vector<CTransactionRef> &vGameTx, const std::shared_ptr<const GameStateDelta> &gameDelta)
+{
+    if (!pindex->pprev)
+        return true;
+
+    const uint256 hash = pindex->GetBlockHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish gamestatedelta undo %s\n", hash.GetHex());
+
+    /* DisconnectTip passes the undo delta, computed while the block's delta
+       and states were still available.  Only if it is missing, try to
+       reconstruct it here:  By inverting the stored delta against the
+       parent state, or else from the full states.  */
+    if (gameDelta)
+        return Publish(false, *gameDelta, vGameTx);
+
+    const GameStateRef parent = pgameDb->getSnapshot(pindex->pprev->GetBlockHash());
+    if (!parent)
+        return ReportMissingGameDelta(hash);
+
+    GameStateDelta delta;
+    if (pgameDb->getDelta(hash, delta))
+        return Publish(false, delta.Invert(*parent), vGameTx);
+
+    const GameStateRef state = pgameDb->getSnapshot(hash);
+    if (!state)
+        return ReportMissingGameDelta(hash);
+
+    return Publish(false, GameStateDelta(*state, *parent), vGameTx);
+}
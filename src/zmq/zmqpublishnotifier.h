@@ -8,6 +8,7 @@
 #include <zmq/zmqabstractnotifier.h>
 
 class CBlockIndex;
+class GameStateDelta;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
@@ -52,4 +53,18 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+/**
+ * Publishes the game state delta of each connected block, and the delta
+ * that undoes the game step of each disconnected block.
+ */
+class CZMQPublishGameStateDeltaNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlockIndex *pindex, const std::vector<CTransactionRef> &vGameTx, const std::shared_ptr<const GameStateDelta> &gameDelta) override;
+    bool NotifyBlockDisconnected(const CBlockIndex *pindex, const std::vector<CTransactionRef> &vGameTx, const std::shared_ptr<const GameStateDelta> &gameDelta) override;
+
+private:
+    bool Publish(bool fConnected, const GameStateDelta &delta, const std::vector<CTransactionRef> &vGameTx);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
@@ -44,6 +44,13 @@ class GameBasicNamesTest (NameTestFramework):
     assert_equal (state['players'], {})
     assert_equal ([], self.nodes[0].name_list ())
 
+    # Only an absent block hash refers to the tip.  Malformed or unknown
+    # hashes are errors.
+    assert_raises_rpc_error (-8, 'blockhash must be hexadecimal',
+                             self.nodes[0].game_getstate, "abc")
+    assert_raises_rpc_error (-5, 'Block not found',
+                             self.nodes[0].game_getstate, "00" * 32)
+
     # Register the player and verify that it appears on the map.
     self.firstupdateName (0, testname, new, '{"color":0}')
     self.sync_with_mode ('both')
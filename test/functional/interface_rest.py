@@ -305,6 +305,86 @@ class RESTTest (BitcoinTestFramework):
         self.log.info("Test the /name URI")
         self.name_tests()
 
+        # Test game state handling.
+        self.log.info("Test the /game URIs")
+        self.game_tests()
+
+    def game_tests(self):
+        """
+        Run REST tests for the game state.
+        """
+
+        bb_hash = self.nodes[0].getbestblockhash()
+        query = '/game/state/' + bb_hash
+
+        resp = self.test_rest_request(query, ret_type=RetType.OBJ)
+        etag = resp.getheader('ETag')
+        assert 'immutable' in resp.getheader('Cache-Control')
+        data = json.loads(resp.read().decode('utf-8'), parse_float=Decimal)
+        assert_equal(data, self.nodes[0].game_getstate(bb_hash))
+
+        res = self.test_rest_request(query, req_type=ReqType.BIN,
+                                     ret_type=RetType.BYTES)
+        binState = self.nodes[0].game_getstate(bb_hash, "binary")
+        assert_equal(binascii.hexlify(res).decode('ascii'), binState)
+        res = self.test_rest_request(query, req_type=ReqType.HEX,
+                                     ret_type=RetType.BYTES)
+        assert_equal(res.decode('ascii'), binState + "\n")
+
+        # A matching If-None-Match yields "not modified".
+        conn = http.client.HTTPConnection(self.url.hostname, self.url.port)
+        conn.request('GET', '/rest' + query + '.json',
+                     headers={'If-None-Match': etag})
+        resp = conn.getresponse()
+        assert_equal(resp.status, http.client.NOT_MODIFIED)
+        assert_equal(resp.getheader('ETag'), etag)
+
+        self.test_rest_request('/game/state/' + '00' * 32,
+                               status=http.client.NOT_FOUND,
+                               ret_type=RetType.OBJ)
+
+        # There are no players yet, so any name is unknown.
+        self.test_rest_request('/game/player/domob',
+                               status=http.client.NOT_FOUND,
+                               ret_type=RetType.OBJ)
+
+        data = self.test_rest_request('/game/tile/0/0')
+        assert_equal(data['x'], 0)
+        assert_equal(data['y'], 0)
+        assert_equal(data['characters'], [])
+
+        # Spawn a player and query it.
+        self.nodes[0].name_register('restplayer', '{"color":0}')
+        self.nodes[0].generate(1)
+        bb_hash = self.nodes[0].getbestblockhash()
+        expected = self.nodes[0].game_getplayerstate('restplayer')
+
+        resp = self.test_rest_request('/game/player/restplayer',
+                                      ret_type=RetType.OBJ)
+        etag = resp.getheader('ETag')
+        assert_equal(etag, '"player/%s/restplayer.json"' % bb_hash)
+        assert_equal(resp.getheader('Cache-Control'), 'public, no-cache')
+        data = json.loads(resp.read().decode('utf-8'), parse_float=Decimal)
+        assert_equal(data, expected)
+
+        # The response is served from the cache the second time.
+        resp = self.test_rest_request('/game/player/restplayer',
+                                      ret_type=RetType.OBJ)
+        assert_equal(resp.getheader('ETag'), etag)
+        data = json.loads(resp.read().decode('utf-8'), parse_float=Decimal)
+        assert_equal(data, expected)
+
+        # The player's character is listed on its tile.
+        ch = expected['characters']['0']
+        data = self.test_rest_request('/game/tile/%d/%d' % (ch['x'], ch['y']))
+        assert_equal(data['characters'], [{'player': 'restplayer', 'index': 0}])
+        self.test_rest_request('/game/tile/-1/0',
+                               status=http.client.NOT_FOUND,
+                               ret_type=RetType.OBJ)
+        self.test_rest_request('/game/tile/0/0', req_type=ReqType.BIN,
+                               status=http.client.NOT_FOUND,
+                               ret_type=RetType.OBJ)
+
     def name_tests(self):
         """
         Run REST tests specific to names.
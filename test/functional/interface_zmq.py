@@ -71,7 +71,16 @@ class ZMQTest (BitcoinTestFramework):
         self.rawblock = ZMQSubscriber(socket, b"rawblock")
         self.rawtx = ZMQSubscriber(socket, b"rawtx")
 
-        self.extra_args = [["-zmqpub%s=%s" % (sub.topic.decode(), address) for sub in [self.hashblock, self.hashtx, self.rawblock, self.rawtx]], []]
+        # The game state deltas are published on their own socket, so that
+        # they do not interfere with the ordering of the other messages.
+        gameAddress = "tcp://127.0.0.1:28333"
+        gameSocket = self.zmq_context.socket(zmq.SUB)
+        gameSocket.set(zmq.RCVTIMEO, 60000)
+        gameSocket.connect(gameAddress)
+        self.gamestatedelta = ZMQSubscriber(gameSocket, b"gamestatedelta")
+
+        self.extra_args = [["-zmqpub%s=%s" % (sub.topic.decode(), address) for sub in [self.hashblock, self.hashtx, self.rawblock, self.rawtx]]
+                           + ["-zmqpubgamestatedelta=%s" % gameAddress], []]
         self.add_nodes(self.num_nodes, self.extra_args)
         self.start_nodes()
 
@@ -110,6 +119,16 @@ class ZMQTest (BitcoinTestFramework):
             block = self.rawblock.receive()
             assert_equal(genhashes[x], bytes_to_hex_str(hash256(block[:80])))
 
+        self.log.info("Check game state deltas")
+        prevhash = self.nodes[0].getblockhash(self.nodes[0].getblockcount() - num_blocks)
+        for x in range(num_blocks):
+            body = self.gamestatedelta.receive()
+            # Connected block, followed by the delta's previous block hash.
+            assert_equal(body[0], 0)
+            assert_equal(bytes_to_hex_str(body[1:33][::-1]), prevhash)
+            prevhash = genhashes[x]
+        lastdelta = body
+
         self.log.info("Wait for tx from second node")
         payment_txid = self.nodes[1].sendtoaddress(self.nodes[0].getnewaddress(), 1.0)
         self.sync_all()
@@ -122,5 +141,17 @@ class ZMQTest (BitcoinTestFramework):
         hex = self.rawtx.receive()
         assert_equal(payment_txid, bytes_to_hex_str(hash256(hex)))
 
+        self.log.info("Check game state deltas of a reorg")
+        self.nodes[0].invalidateblock(genhashes[-1])
+        body = self.gamestatedelta.receive()
+        # The undo delta is based on the disconnected block's state.
+        assert_equal(body[0], 1)
+        assert_equal(bytes_to_hex_str(body[1:33][::-1]), genhashes[-1])
+
+        self.nodes[0].reconsiderblock(genhashes[-1])
+        assert_equal(self.nodes[0].getbestblockhash(), genhashes[-1])
+        # Reconnecting the block publishes the same delta as before.
+        assert_equal(self.gamestatedelta.receive(), lastdelta)
+
 if __name__ == '__main__':
     ZMQTest().main()